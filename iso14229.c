@@ -14,6 +14,7 @@ enum UDSClientRequestState {
     kRequestStateAwaitSendComplete,
     kRequestStateAwaitResponse,
     kRequestStateProcessResponse,
+    kRequestStateCollect, // gathering responses to a broadcast
 };
 
 UDSErr_t UDSClientInit(UDSClient_t *client) {
@@ -22,6 +23,7 @@ UDSErr_t UDSClientInit(UDSClient_t *client) {
     }
     memset(client, 0, sizeof(*client));
     client->state = kRequestStateIdle;
+    client->timer_fd = -1;
 
     client->p2_ms = UDS_CLIENT_DEFAULT_P2_MS;
     client->p2_star_ms = UDS_CLIENT_DEFAULT_P2_STAR_MS;
@@ -34,6 +36,60 @@ UDSErr_t UDSClientInit(UDSClient_t *client) {
     return UDS_OK;
 }
 
+#if UDS_SYS == UDS_SYS_UNIX && defined(__linux__)
+#include <errno.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+/**
+ * @brief arm the timerfd, if open, for the current client deadline
+ */
+static void ClientArmTimerFd(UDSClient_t *client) {
+    if (client->timer_fd < 0) {
+        return;
+    }
+    struct itimerspec its = {0};
+    uint32_t deadline = 0;
+    if (UDSClientGetDeadline(client, &deadline)) {
+        // UDSTimeAfter() is strict, so the deadline is only due 1 ms after it is reached
+        int32_t remaining = (int32_t)(deadline - UDSMillis()) + 1;
+        if (remaining <= 0) {
+            its.it_value.tv_nsec = 1; // already due, an all-zero it_value would disarm
+        } else {
+            its.it_value.tv_sec = remaining / 1000;
+            its.it_value.tv_nsec = (long)(remaining % 1000) * 1000000L;
+        }
+    }
+    if (timerfd_settime(client->timer_fd, 0, &its, NULL) < 0) {
+        UDS_LOGE(__FILE__, "timerfd_settime: %s", strerror(errno));
+    }
+}
+
+int UDSClientTimerFd(UDSClient_t *client) {
+    if (NULL == client) {
+        return -1;
+    }
+    if (client->timer_fd < 0) {
+        client->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        if (client->timer_fd < 0) {
+            UDS_LOGE(__FILE__, "timerfd_create: %s", strerror(errno));
+            return -1;
+        }
+        ClientArmTimerFd(client);
+    }
+    return client->timer_fd;
+}
+
+void UDSClientCloseTimerFd(UDSClient_t *client) {
+    if (client && client->timer_fd >= 0) {
+        close(client->timer_fd);
+        client->timer_fd = -1;
+    }
+}
+#else
+static void ClientArmTimerFd(UDSClient_t *client) { (void)client; }
+#endif
+
 static const char *ClientStateName(enum UDSClientRequestState state) {
     switch (state) {
     case kRequestStateIdle:
@@ -46,6 +102,8 @@ static const char *ClientStateName(enum UDSClientRequestState state) {
         return "AwaitResponse";
     case kRequestStateProcessResponse:
         return "ProcessResponse";
+    case kRequestStateCollect:
+        return "Collect";
     default:
         return "Unknown";
     }
@@ -60,6 +118,10 @@ static void changeState(UDSClient_t *client, enum UDSClientRequestState state) {
 
         switch (state) {
         case kRequestStateIdle:
+            if (client->broadcast) {
+                UDSTpSetCollect(client->tp, false);
+                client->broadcast = NULL;
+            }
             client->fn(client, UDS_EVT_Idle, NULL);
             break;
         default:
@@ -160,6 +222,56 @@ static UDSErr_t HandleServerResponse(UDSClient_t *client) {
     return UDS_OK;
 }
 
+/**
+ * @brief Record a response to a broadcast in the result table
+ */
+static void CollectResponse(UDSClient_t *client, const UDSSDU_t *info) {
+    UDSBroadcast_t *bc = client->broadcast;
+    const uint8_t *resp = client->recv_buf;
+    uint16_t len = client->recv_size;
+    uint8_t sid = client->send_buf[0];
+    UDSErr_t err = UDS_OK;
+
+    if (0x7F == resp[0]) {
+        if (len < 3 || resp[1] != sid) {
+            return;
+        }
+        if (UDS_NRC_RequestCorrectlyReceived_ResponsePending == resp[2]) {
+            // keep collecting until this responder's final answer is due
+            uint32_t p2_star = UDSMillis() + client->p2_star_ms;
+            if (UDSTimeAfter(p2_star, client->p2_timer)) {
+                client->p2_timer = p2_star;
+            }
+            return;
+        }
+        err = resp[2];
+    } else if (UDS_RESPONSE_SID_OF(sid) != resp[0]) {
+        return; // not a response to this request
+    }
+
+    UDSBroadcastResp_t *entry = (UDSBroadcastResp_t *)UDSBroadcastFind(bc, info->A_SA);
+    if (NULL == entry) {
+        if (bc->num_resp >= bc->max_resp) {
+            bc->dropped++;
+            return;
+        }
+        entry = &bc->resp[bc->num_resp++];
+        entry->sa = info->A_SA;
+    }
+    if (len > bc->buf_size - bc->buf_used) {
+        entry->err = UDS_ERR_BUFSIZ;
+        entry->data = NULL;
+        entry->len = 0;
+        bc->dropped++;
+        return;
+    }
+    memcpy(bc->buf + bc->buf_used, resp, len);
+    entry->err = err;
+    entry->data = bc->buf + bc->buf_used;
+    entry->len = len;
+    bc->buf_used += len;
+}
+
 /**
  * @brief execute the client request state machine
  * @param client
@@ -200,23 +312,30 @@ static UDSErr_t PollLowLevel(UDSClient_t *client) {
         break;
     }
     case kRequestStateAwaitSendComplete: {
-        if (client->_options_copy & UDS_FUNCTIONAL) {
+        if ((client->_options_copy & UDS_FUNCTIONAL) && NULL == client->broadcast) {
             // "The Functional addressing is applied only to single frame transmission"
             // Specification of Diagnostic Communication (Diagnostic on CAN - Network Layer)
             changeState(client, kRequestStateIdle);
         }
         if (tp_status & UDS_TP_SEND_IN_PROGRESS) {
-            ; // await send complete
-        } else {
-            client->fn(client, UDS_EVT_SendComplete, NULL);
-            if (client->_options_copy & UDS_SUPPRESS_POS_RESP) {
-                changeState(client, kRequestStateIdle);
-            } else {
-                changeState(client, kRequestStateAwaitResponse);
-                client->p2_timer = UDSMillis() + client->p2_ms;
-            }
+            break; // await send complete
         }
-        break;
+        client->fn(client, UDS_EVT_SendComplete, NULL);
+        if (client->broadcast) {
+            changeState(client, kRequestStateCollect);
+            client->p2_timer = UDSMillis() + client->p2_ms;
+            break;
+        }
+        if (client->_options_copy & UDS_SUPPRESS_POS_RESP) {
+            changeState(client, kRequestStateIdle);
+            break;
+        }
+        changeState(client, kRequestStateAwaitResponse);
+        client->p2_timer = UDSMillis() + client->p2_ms;
+        // A single-frame response may already have been read from the socket by the
+        // UDSTpPoll() above. Check for it now: the socket will not become readable again, so
+        // waiting on it would delay the response until P2 expires.
+        // fall through
     }
     case kRequestStateAwaitResponse: {
         UDSSDU_t info = {0};
@@ -253,6 +372,28 @@ static UDSErr_t PollLowLevel(UDSClient_t *client) {
         }
         break;
     }
+    case kRequestStateCollect: {
+        for (;;) {
+            UDSSDU_t info = {0};
+            ssize_t len = UDSTpPeek(client->tp, &client->recv_buf, &info);
+            if (len < 0) {
+                err = UDS_ERR_TPORT;
+                break;
+            } else if (0 == len) {
+                break;
+            }
+            client->recv_size = len;
+            CollectResponse(client, &info);
+            UDSTpAckRecv(client->tp);
+        }
+        if (UDS_OK == err && UDSTimeAfter(UDSMillis(), client->p2_timer) &&
+            !(tp_status & UDS_TP_RECV_IN_PROGRESS)) {
+            client->recv_size = 0;
+            client->fn(client, UDS_EVT_ResponseReceived, client->broadcast);
+            changeState(client, kRequestStateIdle);
+        }
+        break;
+    }
 
     default:
         UDS_ASSERT(0);
@@ -268,8 +409,17 @@ static UDSErr_t SendRequest(UDSClient_t *client) {
         client->send_buf[1] |= 0x80;
     }
 
+    if (client->keepalive_ms) {
+        // the request refreshes the session just like a TesterPresent would
+        client->keepalive_timer = UDSMillis() + client->keepalive_ms;
+    }
     changeState(client, kRequestStateSending);
     UDSErr_t err = PollLowLevel(client); // poll once to begin sending immediately
+    if (err) {
+        // the request never left: report it here rather than later through UDS_EVT_Err
+        changeState(client, kRequestStateIdle);
+    }
+    ClientArmTimerFd(client);
     return err;
 }
 
@@ -277,7 +427,7 @@ static UDSErr_t PreRequestCheck(UDSClient_t *client) {
     if (NULL == client) {
         return UDS_ERR_INVALID_ARG;
     }
-    if (kRequestStateIdle != client->state) {
+    if (kRequestStateIdle != client->state || client->queue_current) {
         return UDS_ERR_BUSY;
     }
 
@@ -308,6 +458,53 @@ UDSErr_t UDSSendBytes(UDSClient_t *client, const uint8_t *data, uint16_t size) {
     return SendRequest(client);
 }
 
+UDSErr_t UDSBroadcastInit(UDSBroadcast_t *bc, UDSBroadcastResp_t *resp, uint16_t max_resp,
+                          uint8_t *buf, size_t buf_size) {
+    if (NULL == bc || NULL == resp || NULL == buf) {
+        return UDS_ERR_INVALID_ARG;
+    }
+    memset(bc, 0, sizeof(*bc));
+    bc->resp = resp;
+    bc->max_resp = max_resp;
+    bc->buf = buf;
+    bc->buf_size = buf_size;
+    return UDS_OK;
+}
+
+UDSErr_t UDSSendBroadcast(UDSClient_t *client, UDSBroadcast_t *bc, const uint8_t *data,
+                          uint16_t size) {
+    if (NULL == bc || NULL == data || 0 == size) {
+        return UDS_ERR_INVALID_ARG;
+    }
+    UDSErr_t err = PreRequestCheck(client);
+    if (err) {
+        return err;
+    }
+    if (size > client->send_buf_size) {
+        return UDS_ERR_BUFSIZ;
+    }
+    memmove(client->send_buf, data, size);
+    client->send_size = size;
+    bc->num_resp = 0;
+    bc->buf_used = 0;
+    bc->dropped = 0;
+
+    // start collecting before sending so that no early response is missed
+    UDSTpSetCollect(client->tp, true);
+    client->broadcast = bc;
+    client->options = (client->options | UDS_FUNCTIONAL) & ~UDS_SUPPRESS_POS_RESP;
+    return SendRequest(client);
+}
+
+const UDSBroadcastResp_t *UDSBroadcastFind(const UDSBroadcast_t *bc, uint32_t sa) {
+    for (uint16_t i = 0; i < bc->num_resp; i++) {
+        if (bc->resp[i].sa == sa) {
+            return &bc->resp[i];
+        }
+    }
+    return NULL;
+}
+
 UDSErr_t UDSSendECUReset(UDSClient_t *client, UDSECUReset_t type) {
     UDSErr_t err = PreRequestCheck(client);
     if (err) {
@@ -343,6 +540,55 @@ UDSErr_t UDSSendCommCtrl(UDSClient_t *client, enum UDSCommunicationControlType c
     return SendRequest(client);
 }
 
+UDSErr_t UDSClientSetKeepAlive(UDSClient_t *client, uint32_t s3_ms, bool functional) {
+    if (NULL == client) {
+        return UDS_ERR_INVALID_ARG;
+    }
+    client->keepalive_ms = s3_ms / 2;
+    client->keepalive_functional = functional;
+    client->keepalive_timer = UDSMillis() + client->keepalive_ms;
+    ClientArmTimerFd(client);
+    return UDS_OK;
+}
+
+/**
+ * @brief send a suppressed TesterPresent if the keep-alive interval has passed without a request
+ */
+static void ClientKeepAlive(UDSClient_t *client) {
+    if (0 == client->keepalive_ms || NULL == client->tp) {
+        return;
+    }
+    if (!client->keepalive_functional && kRequestStateIdle == client->state) {
+        // a server that cannot suppress the response to 3E 80 answers with an NRC; nothing
+        // else is expected while idle, so drop it before it is taken for the next response
+        uint8_t *buf = NULL;
+        UDSSDU_t info = {0};
+        if (UDSTpPeek(client->tp, &buf, &info) >= 3 && 0x7F == buf[0] &&
+            kSID_TESTER_PRESENT == buf[1]) {
+            UDSTpAckRecv(client->tp);
+        }
+    }
+    if (!UDSTimeAfter(UDSMillis(), client->keepalive_timer)) {
+        return;
+    }
+    // the next tick is due one interval from now whether or not this one is sent
+    client->keepalive_timer = UDSMillis() + client->keepalive_ms;
+    if (!client->keepalive_functional && kRequestStateIdle != client->state) {
+        return; // the physical link is in use and the request in flight refreshed the session
+    }
+    static const uint8_t req[] = {kSID_TESTER_PRESENT, 0x80};
+    UDSSDU_t info = {
+        .A_Mtype = UDS_A_MTYPE_DIAG,
+        .A_TA_Type =
+            client->keepalive_functional ? UDS_A_TA_TYPE_FUNCTIONAL : UDS_A_TA_TYPE_PHYSICAL,
+    };
+    if (UDSTpSend(client->tp, req, sizeof(req), &info) == sizeof(req)) {
+        client->keepalive_sent++;
+    } else {
+        UDS_LOGW(__FILE__, "keep-alive TesterPresent not sent");
+    }
+}
+
 UDSErr_t UDSSendTesterPresent(UDSClient_t *client) {
     UDSErr_t err = PreRequestCheck(client);
     if (err) {
@@ -802,6 +1048,312 @@ UDSErr_t UDSUnpackRequestDownloadResponse(const UDSClient_t *client,
     return UDS_OK;
 }
 
+#if UDS_SYS == UDS_SYS_UNIX
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+enum {
+    kDownloadIdle = 0,
+    kDownloadRequest,  // RequestDownload in flight
+    kDownloadTransfer, // TransferData in flight
+    kDownloadExit,     // RequestTransferExit in flight
+};
+
+/**
+ * @brief map the image when fd is a regular file that holds all of it, otherwise leave
+ * dl->map NULL and read with fread()
+ */
+static void DownloadMap(UDSDownload_t *dl) {
+#if UDS_SYS == UDS_SYS_UNIX
+    struct stat st;
+    int fildes = fileno(dl->fd);
+    if (fildes < 0 || fstat(fildes, &st) < 0 || !S_ISREG(st.st_mode) ||
+        (uint64_t)st.st_size < (uint64_t)dl->file_start + dl->progress.total) {
+        return;
+    }
+    long page = sysconf(_SC_PAGESIZE);
+    if (page <= 0) {
+        return;
+    }
+    off_t base = dl->file_start & ~((off_t)page - 1);
+    size_t len = (size_t)(dl->file_start - base) + dl->progress.total;
+    void *map = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fildes, base);
+    if (MAP_FAILED == map) {
+        return;
+    }
+    madvise(map, len, MADV_SEQUENTIAL);
+    dl->map = map;
+    dl->map_len = len;
+    dl->map_skip = (size_t)(dl->file_start - base);
+#else
+    (void)dl;
+#endif
+}
+
+static void DownloadUnmap(UDSDownload_t *dl) {
+#if UDS_SYS == UDS_SYS_UNIX
+    if (dl->map) {
+        munmap((void *)dl->map, dl->map_len);
+    }
+#endif
+    dl->map = NULL;
+}
+
+/**
+ * @brief copy the next block into the send buffer behind the SID and blockSequenceCounter.
+ * The send buffer is free again once the previous block has been sent, so this runs while
+ * awaiting its response.
+ */
+static UDSErr_t DownloadStage(UDSClient_t *client) {
+    UDSDownload_t *dl = &client->download;
+    size_t n = dl->progress.total - dl->offset;
+    if (n > dl->progress.block_len) {
+        n = dl->progress.block_len;
+    }
+    if (0 == n) {
+        return UDS_OK;
+    }
+    uint8_t *dst = &client->send_buf[UDS_0X36_REQ_BASE_LEN];
+    if (dl->map) {
+        const uint8_t *src = dl->map + dl->map_skip + dl->offset;
+        memcpy(dst, src, n);
+#if UDS_SYS == UDS_SYS_UNIX
+        // fault in the block after this one while the bus is busy
+        size_t ahead = dl->map_skip + dl->offset + n;
+        if (ahead < dl->map_len) {
+            long page = sysconf(_SC_PAGESIZE);
+            size_t start = ahead & ~((size_t)page - 1);
+            size_t len = ahead - start + dl->progress.block_len;
+            if (start + len > dl->map_len) {
+                len = dl->map_len - start;
+            }
+            madvise((void *)(dl->map + start), len, MADV_WILLNEED);
+        }
+#endif
+    } else if (fread(dst, 1, n, dl->fd) != n) {
+        UDS_LOGI(__FILE__, "download: image ends after %zu bytes", dl->offset);
+        return UDS_FAIL;
+    }
+    dl->offset += n;
+    dl->staged = (uint16_t)n;
+    dl->staged_buf = client->send_buf;
+    return UDS_OK;
+}
+
+static UDSErr_t DownloadSendBlock(UDSClient_t *client) {
+    UDSDownload_t *dl = &client->download;
+    UDSErr_t err = PreRequestCheck(client);
+    if (err) {
+        return err;
+    }
+    if (0 == dl->staged) {
+        err = DownloadStage(client);
+        if (err) {
+            return err;
+        }
+    } else if (dl->staged_buf != client->send_buf) {
+        // the transport handed out a different buffer, the staged block is still in the old one
+        memmove(&client->send_buf[UDS_0X36_REQ_BASE_LEN],
+                &dl->staged_buf[UDS_0X36_REQ_BASE_LEN], dl->staged);
+    }
+    client->send_buf[0] = kSID_TRANSFER_DATA;
+    client->send_buf[1] = dl->bsc;
+    client->send_size = UDS_0X36_REQ_BASE_LEN + dl->staged;
+    dl->inflight = dl->staged;
+    dl->staged = 0;
+    return SendRequest(client);
+}
+
+static void DownloadUpdateStats(UDSDownload_t *dl) {
+    dl->progress.elapsed_ms = UDSMillis() - dl->t_start;
+    dl->progress.bytes_per_s =
+        dl->progress.elapsed_ms
+            ? (uint32_t)((uint64_t)dl->progress.sent * 1000 / dl->progress.elapsed_ms)
+            : 0;
+}
+
+static void DownloadFinish(UDSClient_t *client, UDSErr_t err) {
+    UDSDownload_t *dl = &client->download;
+    if (kRequestStateIdle != client->state) {
+        changeState(client, kRequestStateIdle);
+    }
+    if (dl->map) {
+        // leave the FILE where fread() would have left it
+        fseek(dl->fd, dl->file_start + (long)dl->offset, SEEK_SET);
+        DownloadUnmap(dl);
+    }
+    dl->step = kDownloadIdle;
+    dl->staged = 0;
+    dl->progress.err = err;
+    DownloadUpdateStats(dl);
+    client->fn(client, UDS_EVT_DownloadComplete, &dl->progress);
+}
+
+/**
+ * @brief advance the download. Called on every poll: stages the next block while the current
+ * one awaits its response, and sends the next request once the client returns to idle.
+ */
+static void DownloadPoll(UDSClient_t *client, UDSErr_t err) {
+    UDSDownload_t *dl = &client->download;
+    if (kDownloadIdle == dl->step) {
+        return;
+    }
+    if (kRequestStateIdle != client->state) {
+        if (kDownloadTransfer == dl->step && kRequestStateAwaitResponse == client->state &&
+            0 == dl->staged && dl->offset < dl->progress.total) {
+            UDSErr_t stage_err = DownloadStage(client);
+            if (stage_err) {
+                DownloadFinish(client, stage_err);
+            }
+        }
+        return;
+    }
+    // the request in flight has completed
+    if (UDS_OK != err) {
+        DownloadFinish(client, err);
+        return;
+    }
+
+    switch (dl->step) {
+    case kDownloadRequest: {
+        struct RequestDownloadResponse resp;
+        err = UDSUnpackRequestDownloadResponse(client, &resp);
+        if (err) {
+            break;
+        }
+        // maxNumberOfBlockLength includes the SID and blockSequenceCounter
+        size_t max = resp.maxNumberOfBlockLength;
+        if (max > client->send_buf_size) {
+            max = client->send_buf_size;
+        }
+        if (max <= UDS_0X36_REQ_BASE_LEN) {
+            err = UDS_ERR_RESP_TOO_SHORT;
+            break;
+        }
+        dl->progress.block_len = (uint16_t)(max - UDS_0X36_REQ_BASE_LEN);
+        dl->step = kDownloadTransfer;
+        err = DownloadSendBlock(client);
+        break;
+    }
+    case kDownloadTransfer:
+        // a stale or duplicated 0x76 must not advance the transfer
+        if (client->recv_size < 2) {
+            err = UDS_ERR_RESP_TOO_SHORT;
+            break;
+        }
+        if (client->recv_buf[1] != dl->bsc) {
+            err = UDS_ERR_BSC_MISMATCH;
+            break;
+        }
+        dl->progress.sent += dl->inflight;
+        dl->progress.blocks++;
+        dl->inflight = 0;
+        dl->bsc++; // wraps from 0xFF to 0x00
+        DownloadUpdateStats(dl);
+        client->fn(client, UDS_EVT_DownloadProgress, &dl->progress);
+        if (dl->progress.sent < dl->progress.total) {
+            err = DownloadSendBlock(client);
+        } else {
+            dl->step = kDownloadExit;
+            err = UDSSendRequestTransferExit(client);
+        }
+        break;
+    case kDownloadExit:
+        DownloadFinish(client, UDS_OK);
+        return;
+    default:
+        UDS_ASSERT(0);
+    }
+    if (err) {
+        DownloadFinish(client, err);
+    }
+}
+
+UDSErr_t UDSConfigDownload(UDSClient_t *client, uint8_t dataFormatIdentifier,
+                           uint8_t addressAndLengthFormatIdentifier, size_t memoryAddress,
+                           size_t memorySize, FILE *fd) {
+    if (NULL == client || NULL == fd || 0 == memorySize) {
+        return UDS_ERR_INVALID_ARG;
+    }
+    if (NULL == client->fn) {
+        return UDS_ERR_MISUSE;
+    }
+    UDSDownload_t *dl = &client->download;
+    if (kDownloadIdle != dl->step) {
+        return UDS_ERR_BUSY;
+    }
+    memset(dl, 0, sizeof(*dl));
+    dl->fd = fd;
+    dl->file_start = ftell(fd);
+    dl->bsc = 1;
+    dl->progress.total = memorySize;
+    if (dl->file_start >= 0) {
+        DownloadMap(dl);
+    }
+    dl->t_start = UDSMillis();
+
+    UDSErr_t err = UDSSendRequestDownload(client, dataFormatIdentifier,
+                                          addressAndLengthFormatIdentifier, memoryAddress,
+                                          memorySize);
+    if (err) {
+        if (kRequestStateIdle != client->state) {
+            changeState(client, kRequestStateIdle);
+        }
+        DownloadUnmap(dl);
+        return err;
+    }
+    dl->step = kDownloadRequest;
+    return UDS_OK;
+}
+
+void UDSDownloadAbort(UDSClient_t *client) {
+    if (NULL == client || kDownloadIdle == client->download.step) {
+        return;
+    }
+    DownloadFinish(client, UDS_FAIL);
+}
+
+static void CompleteQueued(UDSClient_t *client, UDSErr_t err) {
+    UDSClientReq_t *req = client->queue_current;
+    client->queue_current = NULL;
+    if (req->cb) {
+        req->cb(client, req, err);
+    }
+}
+
+/**
+ * @brief start queued requests until one is in flight or the queue is empty
+ */
+static void StartQueued(UDSClient_t *client) {
+    while (NULL == client->queue_current && client->queue_head &&
+           kRequestStateIdle == client->state) {
+        UDSClientReq_t *req = client->queue_head;
+        client->queue_head = req->next;
+        if (NULL == client->queue_head) {
+            client->queue_tail = NULL;
+        }
+        req->next = NULL;
+
+        UDSErr_t err = PreRequestCheck(client);
+        client->queue_current = req;
+        if (UDS_OK == err && req->len > client->send_buf_size) {
+            err = UDS_ERR_BUFSIZ;
+        }
+        if (UDS_OK == err) {
+            memmove(client->send_buf, req->data, req->len);
+            client->send_size = req->len;
+            client->options = req->options;
+            err = SendRequest(client);
+        }
+        if (UDS_OK != err) {
+            changeState(client, kRequestStateIdle);
+            CompleteQueued(client, err);
+        }
+    }
+}
+
 UDSErr_t UDSClientPoll(UDSClient_t *client) {
     if (NULL == client->fn) {
         return UDS_ERR_MISUSE;
@@ -817,10 +1369,187 @@ UDSErr_t UDSClientPoll(UDSClient_t *client) {
         changeState(client, kRequestStateIdle);
         break;
     }
+    DownloadPoll(client, err);
+    if (client->queue_current && kRequestStateIdle == client->state) {
+        CompleteQueued(client, err);
+    }
+    // send the next queued request right away instead of on the next poll
+    StartQueued(client);
+    ClientKeepAlive(client);
     client->fn(client, UDS_EVT_Poll, NULL);
+    ClientArmTimerFd(client);
     return err;
 }
 
+UDSErr_t UDSClientEnqueue(UDSClient_t *client, UDSClientReq_t *req) {
+    if (NULL == client || NULL == req || NULL == req->data || 0 == req->len) {
+        return UDS_ERR_INVALID_ARG;
+    }
+    if (NULL == client->fn) {
+        return UDS_ERR_MISUSE;
+    }
+    req->next = NULL;
+    if (client->queue_tail) {
+        client->queue_tail->next = req;
+    } else {
+        client->queue_head = req;
+    }
+    client->queue_tail = req;
+    StartQueued(client);
+    return UDS_OK;
+}
+
+size_t UDSClientPending(const UDSClient_t *client) {
+    size_t n = client->queue_current ? 1 : 0;
+    for (const UDSClientReq_t *req = client->queue_head; req; req = req->next) {
+        n++;
+    }
+    return n;
+}
+
+bool UDSClientGetDeadline(const UDSClient_t *client, uint32_t *deadline) {
+    if (NULL == client || NULL == deadline) {
+        return false;
+    }
+    bool has_deadline = false;
+    uint32_t t = 0;
+    bool tp_deadline = client->tp && UDSTpGetDeadline(client->tp, &t);
+    if (tp_deadline) {
+        UDSDeadlineMin(&has_deadline, deadline, t);
+    }
+    switch (client->state) {
+    case kRequestStateSending:
+        // the send is attempted on the next poll
+        UDSDeadlineMin(&has_deadline, deadline, UDSMillis() - 1);
+        break;
+    case kRequestStateAwaitSendComplete:
+        // transports that complete sends asynchronously report when to poll next, the others
+        // advance on the next poll
+        if (!tp_deadline) {
+            UDSDeadlineMin(&has_deadline, deadline, UDSMillis() - 1);
+        }
+        break;
+    case kRequestStateAwaitResponse:
+    case kRequestStateCollect:
+        UDSDeadlineMin(&has_deadline, deadline, client->p2_timer);
+        break;
+    default:
+        break;
+    }
+    if (client->keepalive_ms) {
+        UDSDeadlineMin(&has_deadline, deadline, client->keepalive_timer);
+    }
+    return has_deadline;
+}
+
+#if UDS_SYS == UDS_SYS_UNIX
+UDSErr_t UDSClientWait(UDSClient_t *client, int timeout_ms) {
+    if (NULL == client || NULL == client->tp) {
+        return UDS_ERR_MISUSE;
+    }
+    uint32_t deadline = 0;
+    bool has_deadline = UDSClientGetDeadline(client, &deadline);
+    return UDSTpWait(client->tp, has_deadline, deadline, timeout_ms);
+}
+#endif
+
+UDSErr_t UDSClientGroupInit(UDSClientGroup_t *group) {
+    if (NULL == group) {
+        return UDS_ERR_INVALID_ARG;
+    }
+    memset(group, 0, sizeof(*group));
+    return UDS_OK;
+}
+
+int UDSClientGroupAdd(UDSClientGroup_t *group, UDSClient_t *client) {
+    if (NULL == group || NULL == client || group->num_clients >= UDS_CLIENT_GROUP_MAX) {
+        return -1;
+    }
+    group->clients[group->num_clients] = client;
+    return group->num_clients++;
+}
+
+UDSErr_t UDSClientGroupEnqueue(UDSClientGroup_t *group, int ecu, UDSClientReq_t *req) {
+    if (NULL == group || ecu < 0 || ecu >= group->num_clients) {
+        return UDS_ERR_INVALID_ARG;
+    }
+    return UDSClientEnqueue(group->clients[ecu], req);
+}
+
+UDSErr_t UDSClientGroupPoll(UDSClientGroup_t *group) {
+    UDSErr_t ret = UDS_OK;
+    for (int i = 0; i < group->num_clients; i++) {
+        UDSErr_t err = UDSClientPoll(group->clients[i]);
+        if (UDS_OK == ret && UDS_OK != err &&
+            UDS_NRC_RequestCorrectlyReceived_ResponsePending != err) {
+            ret = err;
+        }
+    }
+    return ret;
+}
+
+size_t UDSClientGroupPending(const UDSClientGroup_t *group) {
+    size_t n = 0;
+    for (int i = 0; i < group->num_clients; i++) {
+        n += UDSClientPending(group->clients[i]);
+    }
+    return n;
+}
+
+#if UDS_SYS == UDS_SYS_UNIX
+#include <errno.h>
+#include <poll.h>
+
+#define UDS_CLIENT_GROUP_FDS_PER_TP 4
+
+UDSErr_t UDSClientGroupWait(UDSClientGroup_t *group, int timeout_ms) {
+    if (NULL == group) {
+        return UDS_ERR_MISUSE;
+    }
+    struct pollfd pfds[UDS_CLIENT_GROUP_MAX * UDS_CLIENT_GROUP_FDS_PER_TP];
+    int nfds = 0;
+    bool has_deadline = false;
+    uint32_t deadline = 0;
+
+    for (int i = 0; i < group->num_clients; i++) {
+        UDSClient_t *client = group->clients[i];
+        uint32_t t;
+        if (NULL == client->tp) {
+            continue;
+        }
+        if (UDSClientGetDeadline(client, &t)) {
+            UDSDeadlineMin(&has_deadline, &deadline, t);
+        }
+        int fds[UDS_CLIENT_GROUP_FDS_PER_TP];
+        int n = UDSTpGetFds(client->tp, fds, UDS_CLIENT_GROUP_FDS_PER_TP);
+        for (int j = 0; j < n; j++) {
+            pfds[nfds].fd = fds[j];
+            pfds[nfds].events = POLLIN;
+            pfds[nfds].revents = 0;
+            nfds++;
+        }
+    }
+    if (has_deadline) {
+        // UDSTimeAfter() is strict, so the deadline is only due 1 ms after it is reached
+        int32_t remaining = (int32_t)(deadline - UDSMillis()) + 1;
+        if (remaining < 0) {
+            remaining = 0;
+        }
+        if (timeout_ms < 0 || remaining < timeout_ms) {
+            timeout_ms = remaining;
+        }
+    }
+    if (0 == nfds && timeout_ms < 0) {
+        return UDS_OK; // nothing to wait on
+    }
+    if (poll(pfds, nfds, timeout_ms) < 0 && EINTR != errno) {
+        UDS_LOGE(__FILE__, "poll: %s", strerror(errno));
+        return UDS_ERR_TPORT;
+    }
+    return UDS_OK;
+}
+#endif
+
 UDSErr_t UDSUnpackRDBIResponse(UDSClient_t *client, UDSRDBIVar_t *vars, uint16_t numVars) {
     uint16_t offset = UDS_0X22_RESP_BASE_LEN;
     if (client == NULL || vars == NULL) {
@@ -844,7 +1573,169 @@ UDSErr_t UDSUnpackRDBIResponse(UDSClient_t *client, UDSRDBIVar_t *vars, uint16_t
         } else {
             return UDS_ERR_INVALID_ARG;
         }
-        offset += sizeof(uint16_t) + vars[i].len;
+        offset += sizeof(uint16_t) + vars[i].len;
+    }
+    return UDS_OK;
+}
+
+UDSErr_t UDSRDBIPlanCompile(UDSRDBIPlan_t *plan, UDSRDBIPlanVar_t *vars, uint16_t num_vars,
+                            UDSRDBIPlanChunk_t *chunks, uint16_t max_chunks, uint8_t *req_buf,
+                            size_t req_buf_size, uint16_t mtu) {
+    if (NULL == plan || NULL == vars || 0 == num_vars || NULL == chunks || NULL == req_buf) {
+        return UDS_ERR_INVALID_ARG;
+    }
+    if (0 == mtu) {
+        mtu = UDS_TP_MTU;
+    }
+    memset(plan, 0, sizeof(*plan));
+    plan->vars = vars;
+    plan->num_vars = num_vars;
+    plan->chunks = chunks;
+    plan->max_chunks = max_chunks;
+    plan->req_buf = req_buf;
+    plan->req_buf_size = req_buf_size;
+
+    for (uint16_t i = 0; i < num_vars; i++) {
+        const UDSRDBIPlanVar_t *v = &vars[i];
+        if (NULL == v->data || 0 == v->len) {
+            return UDS_ERR_INVALID_ARG;
+        }
+        switch (v->type) {
+        case UDS_RDBI_BYTES:
+            break;
+        case UDS_RDBI_U8:
+            if (v->len != 1) {
+                return UDS_ERR_INVALID_ARG;
+            }
+            break;
+        case UDS_RDBI_U16:
+            if (v->len != 2) {
+                return UDS_ERR_INVALID_ARG;
+            }
+            break;
+        case UDS_RDBI_U32:
+            if (v->len != 4) {
+                return UDS_ERR_INVALID_ARG;
+            }
+            break;
+        default:
+            return UDS_ERR_INVALID_ARG;
+        }
+        if (UDS_0X22_RESP_BASE_LEN + sizeof(uint16_t) + v->len > mtu) {
+            return UDS_ERR_BUFSIZ;
+        }
+    }
+
+    // greedy split: a request holds as many DIDs as fit into both the request and the response
+    size_t req_used = 0;
+    UDSRDBIPlanChunk_t *chunk = NULL;
+    size_t req_len = 0;
+    for (uint16_t i = 0; i < num_vars; i++) {
+        UDSRDBIPlanVar_t *v = &vars[i];
+        size_t record = sizeof(uint16_t) + v->len;
+        if (NULL == chunk || req_len + sizeof(uint16_t) > mtu ||
+            (size_t)chunk->resp_len + record > mtu) {
+            if (plan->num_chunks == max_chunks || req_used + 1 > req_buf_size) {
+                return UDS_ERR_BUFSIZ;
+            }
+            chunk = &chunks[plan->num_chunks++];
+            memset(chunk, 0, sizeof(*chunk));
+            chunk->plan = plan;
+            chunk->first_var = i;
+            chunk->resp_len = UDS_0X22_RESP_BASE_LEN;
+            chunk->req.data = &req_buf[req_used];
+            req_buf[req_used++] = kSID_READ_DATA_BY_IDENTIFIER;
+            req_len = 1;
+        }
+        if (req_used + sizeof(uint16_t) > req_buf_size) {
+            return UDS_ERR_BUFSIZ;
+        }
+        req_buf[req_used++] = v->did >> 8;
+        req_buf[req_used++] = v->did & 0xFF;
+        req_len += sizeof(uint16_t);
+        chunk->req.len = req_len;
+        chunk->num_vars++;
+        v->offset = chunk->resp_len + sizeof(uint16_t);
+        chunk->resp_len += record;
+    }
+    return UDS_OK;
+}
+
+static UDSErr_t RDBIPlanDecode(const UDSClient_t *client, const UDSRDBIPlanChunk_t *chunk) {
+    const UDSRDBIPlanVar_t *vars = &chunk->plan->vars[chunk->first_var];
+    const uint8_t *buf = client->recv_buf;
+    if (client->recv_size < chunk->resp_len) {
+        return UDS_ERR_RESP_TOO_SHORT;
+    }
+    if (client->recv_size > chunk->resp_len) {
+        UDS_LOGW(__FILE__, "RDBI plan: response is %u bytes, expected %u", client->recv_size,
+                 chunk->resp_len);
+        return UDS_FAIL;
+    }
+    // check the whole layout before touching any variable
+    for (uint16_t i = 0; i < chunk->num_vars; i++) {
+        const uint8_t *did = &buf[vars[i].offset - sizeof(uint16_t)];
+        if (did[0] != (vars[i].did >> 8) || did[1] != (vars[i].did & 0xFF)) {
+            return UDS_ERR_DID_MISMATCH;
+        }
+    }
+    for (uint16_t i = 0; i < chunk->num_vars; i++) {
+        const UDSRDBIPlanVar_t *v = &vars[i];
+        const uint8_t *src = &buf[v->offset];
+        switch (v->type) {
+        case UDS_RDBI_U8:
+            *(uint8_t *)v->data = src[0];
+            break;
+        case UDS_RDBI_U16:
+            *(uint16_t *)v->data = (uint16_t)((src[0] << 8) | src[1]);
+            break;
+        case UDS_RDBI_U32:
+            *(uint32_t *)v->data = ((uint32_t)src[0] << 24) | ((uint32_t)src[1] << 16) |
+                                   ((uint32_t)src[2] << 8) | src[3];
+            break;
+        default:
+            memcpy(v->data, src, v->len);
+            break;
+        }
+    }
+    return UDS_OK;
+}
+
+static void RDBIPlanChunkDone(UDSClient_t *client, UDSClientReq_t *req, UDSErr_t err) {
+    UDSRDBIPlanChunk_t *chunk = (UDSRDBIPlanChunk_t *)req;
+    UDSRDBIPlan_t *plan = chunk->plan;
+    if (UDS_OK == err) {
+        err = RDBIPlanDecode(client, chunk);
+    }
+    if (UDS_OK == plan->err) {
+        plan->err = err;
+    }
+    if (0 == --plan->pending && plan->cb) {
+        plan->cb(client, plan, plan->err);
+    }
+}
+
+UDSErr_t UDSRDBIPlanRead(UDSClient_t *client, UDSRDBIPlan_t *plan) {
+    if (NULL == client || NULL == plan || 0 == plan->num_chunks) {
+        return UDS_ERR_INVALID_ARG;
+    }
+    if (plan->pending) {
+        return UDS_ERR_BUSY;
+    }
+    plan->err = UDS_OK;
+    plan->pending = plan->num_chunks;
+    for (uint16_t i = 0; i < plan->num_chunks; i++) {
+        UDSRDBIPlanChunk_t *chunk = &plan->chunks[i];
+        chunk->req.options = client->defaultOptions;
+        chunk->req.cb = RDBIPlanChunkDone;
+        chunk->req.cb_data = plan;
+        UDSErr_t err = UDSClientEnqueue(client, &chunk->req);
+        if (err) {
+            // requests already queued complete normally and account for themselves
+            plan->pending -= plan->num_chunks - i;
+            plan->err = err;
+            return err;
+        }
     }
     return UDS_OK;
 }
@@ -869,6 +1760,7 @@ static inline uint8_t NegativeResponse(UDSReq_t *r, uint8_t response_code) {
 static inline void NoResponse(UDSReq_t *r) { r->send_len = 0; }
 
 static uint8_t EmitEvent(UDSServer_t *srv, UDSEvent_t evt, void *data) {
+    UDS_TRACE1(server_event, (int)evt);
     if (srv->fn) {
         return srv->fn(srv, evt, data);
     } else {
@@ -1707,8 +2599,8 @@ static uint8_t evaluateServiceResponse(UDSServer_t *srv, UDSReq_t *r) {
         /* test if positive response is required and if responseCode is positive 0x00 */
         if ((suppressPosRspMsgIndicationBit) && (response == UDS_PositiveResponse) &&
             (
-                // TODO: *not yet a NRC 0x78 response sent*
-                true)) {
+                // *not yet a NRC 0x78 response sent*
+                !srv->RCRRP)) {
             suppressResponse = true;
         } else {
             suppressResponse = false;
@@ -1771,8 +2663,8 @@ static uint8_t evaluateServiceResponse(UDSServer_t *srv, UDSReq_t *r) {
          (UDS_NRC_SubFunctionNotSupportedInActiveSession == response) ||
          (UDS_NRC_RequestOutOfRange == response)) &&
         (
-            // TODO: *not yet a NRC 0x78 response sent*
-            true)) {
+            // *not yet a NRC 0x78 response sent*
+            !srv->RCRRP)) {
         suppressResponse = true; /* Suppress negative response message */
         NoResponse(r);
     } else {
@@ -1843,6 +2735,7 @@ void UDSServerPoll(UDSServer_t *srv) {
         if (UDSTimeAfter(UDSMillis(), srv->p2_timer)) {
             ssize_t ret = 0;
             if (r->send_len) {
+                UDS_TRACE3(server_response, r->send_buf[0], r->send_len, (int)srv->RCRRP);
                 ret = UDSTpSend(srv->tp, r->send_buf, r->send_len, NULL);
             }
 
@@ -1884,7 +2777,9 @@ void UDSServerPoll(UDSServer_t *srv) {
                 UDS_LOGI(__FILE__, "bad tport\n");
                 return;
             }
+            UDS_TRACE2(server_request, r->recv_buf[0], r->recv_len);
             uint8_t response = evaluateServiceResponse(srv, r);
+            UDS_TRACE2(server_handled, r->recv_buf[0], response);
             srv->requestInProgress = true;
             if (UDS_NRC_RequestCorrectlyReceived_ResponsePending == response) {
                 srv->RCRRP = true;
@@ -1893,11 +2788,378 @@ void UDSServerPoll(UDSServer_t *srv) {
     }
 }
 
+#if UDS_SYS == UDS_SYS_UNIX
+UDSErr_t UDSServerWait(UDSServer_t *srv, int timeout_ms) {
+    if (NULL == srv || NULL == srv->tp) {
+        return UDS_ERR_MISUSE;
+    }
+    bool has_deadline = false;
+    uint32_t deadline = 0;
+
+    if (kDefaultSession != srv->sessionType) {
+        UDSDeadlineMin(&has_deadline, &deadline, srv->s3_session_timeout_timer);
+    }
+    if (srv->ecuResetScheduled) {
+        UDSDeadlineMin(&has_deadline, &deadline, srv->ecuResetTimer);
+    }
+    if (srv->requestInProgress) {
+        UDSDeadlineMin(&has_deadline, &deadline, srv->p2_timer);
+        if (srv->RCRRP) {
+            // the service handler is re-evaluated on every poll while 0x78 is pending. Check back
+            // within p2 rather than sleeping for the full 0.3 * p2* between 0x78 responses.
+            UDSDeadlineMin(&has_deadline, &deadline, UDSMillis() + srv->p2_ms);
+        }
+    }
+    return UDSTpWait(srv->tp, has_deadline, deadline, timeout_ms);
+}
+#endif
+
+#if UDS_SYS == UDS_SYS_UNIX
+static void *JobWorker(void *arg) {
+    UDSJobEngine_t *engine = arg;
+    pthread_mutex_lock(&engine->lock);
+    for (;;) {
+        while (!engine->stop && NULL == engine->queue_head) {
+            pthread_cond_wait(&engine->cond, &engine->lock);
+        }
+        if (engine->stop) {
+            break;
+        }
+        UDSJob_t *job = engine->queue_head;
+        engine->queue_head = job->next;
+        if (NULL == engine->queue_head) {
+            engine->queue_tail = NULL;
+        }
+        __atomic_store_n(&job->state, UDS_JOB_RUNNING, __ATOMIC_RELEASE);
+        pthread_mutex_unlock(&engine->lock);
+
+        uint8_t nrc = job->routine->fn(job);
+
+        pthread_mutex_lock(&engine->lock);
+        job->nrc = nrc;
+        job->next = engine->done_head;
+        engine->done_head = job;
+    }
+    pthread_mutex_unlock(&engine->lock);
+    return NULL;
+}
+
+UDSErr_t UDSJobEngineInit(UDSJobEngine_t *engine, UDSJobRoutine_t *routines,
+                          uint16_t num_routines, int num_workers) {
+    if (NULL == engine || (NULL == routines && num_routines) || num_workers <= 0 ||
+        num_workers > UDS_JOB_MAX_WORKERS) {
+        return UDS_ERR_INVALID_ARG;
+    }
+    memset(engine, 0, sizeof(*engine));
+    engine->routines = routines;
+    engine->num_routines = num_routines;
+    for (uint16_t i = 0; i < num_routines; i++) {
+        if (NULL == routines[i].fn) {
+            return UDS_ERR_INVALID_ARG;
+        }
+        memset(&routines[i].job, 0, sizeof(routines[i].job));
+        routines[i].job.routine = &routines[i];
+    }
+    pthread_mutex_init(&engine->lock, NULL);
+    pthread_cond_init(&engine->cond, NULL);
+    for (int i = 0; i < num_workers; i++) {
+        if (pthread_create(&engine->workers[i], NULL, JobWorker, engine) != 0) {
+            UDS_LOGE(__FILE__, "pthread_create failed");
+            UDSJobEngineDeinit(engine);
+            return UDS_FAIL;
+        }
+        engine->num_workers++;
+    }
+    return UDS_OK;
+}
+
+void UDSJobEngineDeinit(UDSJobEngine_t *engine) {
+    if (NULL == engine) {
+        return;
+    }
+    pthread_mutex_lock(&engine->lock);
+    engine->stop = true;
+    for (uint16_t i = 0; i < engine->num_routines; i++) {
+        __atomic_store_n(&engine->routines[i].job.cancel, 1, __ATOMIC_RELAXED);
+    }
+    pthread_cond_broadcast(&engine->cond);
+    pthread_mutex_unlock(&engine->lock);
+    for (int i = 0; i < engine->num_workers; i++) {
+        pthread_join(engine->workers[i], NULL);
+    }
+    engine->num_workers = 0;
+    pthread_cond_destroy(&engine->cond);
+    pthread_mutex_destroy(&engine->lock);
+}
+
+int UDSJobEnginePoll(UDSJobEngine_t *engine) {
+    pthread_mutex_lock(&engine->lock);
+    UDSJob_t *done = engine->done_head;
+    engine->done_head = NULL;
+    pthread_mutex_unlock(&engine->lock);
+    int n = 0;
+    while (done) {
+        UDSJob_t *job = done;
+        done = job->next;
+        job->next = NULL;
+        __atomic_store_n(&job->state, UDS_JOB_DONE, __ATOMIC_RELEASE);
+        n++;
+    }
+    return n;
+}
+
+bool UDSJobCancelled(const UDSJob_t *job) {
+    return __atomic_load_n(&job->cancel, __ATOMIC_RELAXED);
+}
+
+static bool JobActive(const UDSJob_t *job) {
+    int state = __atomic_load_n(&job->state, __ATOMIC_ACQUIRE);
+    return UDS_JOB_QUEUED == state || UDS_JOB_RUNNING == state;
+}
+
+static void JobSubmit(UDSJobEngine_t *engine, UDSJob_t *job) {
+    pthread_mutex_lock(&engine->lock);
+    job->next = NULL;
+    __atomic_store_n(&job->state, UDS_JOB_QUEUED, __ATOMIC_RELEASE);
+    if (engine->queue_tail) {
+        engine->queue_tail->next = job;
+    } else {
+        engine->queue_head = job;
+    }
+    engine->queue_tail = job;
+    pthread_cond_signal(&engine->cond);
+    pthread_mutex_unlock(&engine->lock);
+}
+
+/**
+ * @brief answer a waiting request once the job is done, 0x78 until then
+ */
+static uint8_t JobResult(UDSServer_t *srv, UDSJob_t *job, UDSRoutineCtrlArgs_t *args) {
+    if (JobActive(job)) {
+        job->waiting = true;
+        return UDS_NRC_RequestCorrectlyReceived_ResponsePending;
+    }
+    job->waiting = false;
+    if (UDS_PositiveResponse != job->nrc) {
+        return job->nrc;
+    }
+    return args->copyStatusRecord(srv, job->status, job->status_len);
+}
+
+static UDSJobRoutine_t *JobRoutine(UDSJobEngine_t *engine, uint16_t rid) {
+    for (uint16_t i = 0; i < engine->num_routines; i++) {
+        if (engine->routines[i].rid == rid) {
+            return &engine->routines[i];
+        }
+    }
+    return NULL;
+}
+
+static void JobStart(UDSJobEngine_t *engine, UDSJob_t *job, const uint8_t *option,
+                     uint16_t option_len) {
+    memcpy(job->option, option, option_len);
+    job->option_len = option_len;
+    job->status_len = 0;
+    job->nrc = UDS_PositiveResponse;
+    __atomic_store_n(&job->cancel, 0, __ATOMIC_RELAXED);
+    JobSubmit(engine, job);
+}
+
+UDSErr_t UDSJobEngineStart(UDSJobEngine_t *engine, uint16_t rid, const uint8_t *option,
+                           uint16_t option_len, UDSJob_t **job) {
+    UDSJobEnginePoll(engine);
+    UDSJobRoutine_t *routine = JobRoutine(engine, rid);
+    if (NULL == routine || option_len > sizeof(routine->job.option)) {
+        return UDS_ERR_INVALID_ARG;
+    }
+    if (JobActive(&routine->job)) {
+        return UDS_ERR_BUSY;
+    }
+    JobStart(engine, &routine->job, option, option_len);
+    if (job) {
+        *job = &routine->job;
+    }
+    return UDS_OK;
+}
+
+uint8_t UDSJobEngineRoutineCtrl(UDSJobEngine_t *engine, UDSServer_t *srv,
+                                UDSRoutineCtrlArgs_t *args) {
+    UDSJobEnginePoll(engine);
+
+    UDSJobRoutine_t *routine = JobRoutine(engine, args->id);
+    if (NULL == routine) {
+        return UDS_NRC_RequestOutOfRange;
+    }
+    UDSJob_t *job = &routine->job;
+
+    // the server re-evaluates a request that was answered with 0x78 on every poll
+    if (srv->RCRRP && job->waiting) {
+        return JobResult(srv, job, args);
+    }
+    job->waiting = false;
+
+    switch (args->ctrlType) {
+    case kStartRoutine:
+        if (JobActive(job)) {
+            return UDS_NRC_ConditionsNotCorrect;
+        }
+        if (args->len > sizeof(job->option)) {
+            return UDS_NRC_IncorrectMessageLengthOrInvalidFormat;
+        }
+        JobStart(engine, job, args->optionRecord, args->len);
+        if (routine->wait) {
+            job->waiting = true;
+            return UDS_NRC_RequestCorrectlyReceived_ResponsePending;
+        }
+        return UDS_PositiveResponse;
+    case kStopRoutine:
+        if (!JobActive(job)) {
+            return UDS_NRC_RequestSequenceError;
+        }
+        __atomic_store_n(&job->cancel, 1, __ATOMIC_RELAXED);
+        return JobResult(srv, job, args);
+    case kRequestRoutineResults:
+        if (UDS_JOB_IDLE == __atomic_load_n(&job->state, __ATOMIC_ACQUIRE)) {
+            return UDS_NRC_RequestSequenceError;
+        }
+        return JobResult(srv, job, args);
+    default:
+        return UDS_NRC_RequestOutOfRange;
+    }
+}
+
+enum {
+    kCoWaitNone = 0,
+    kCoWaitTimer,
+    kCoWaitFd,
+    kCoWaitJob,
+};
+
+// makecontext() only passes int arguments; the coroutine being started is handed over here
+static __thread UDSCo_t *co_starting;
+
+static void CoEntry(void) {
+    UDSCo_t *co = co_starting;
+    co->result = co->fn(co, co->srv, co->evt, co->arg);
+    co->state = UDS_CO_IDLE;
+    // returning switches to uc_link, i.e. back into CoResume()
+}
+
+static uint8_t CoResume(UDSCo_t *co) {
+    co->state = UDS_CO_RUNNING;
+    swapcontext(&co->caller, &co->ctx);
+    if (UDS_CO_SUSPENDED == co->state) {
+        return UDS_NRC_RequestCorrectlyReceived_ResponsePending;
+    }
+    return co->result;
+}
+
+static void *CoSuspend(UDSCo_t *co, int wait) {
+    co->wait = wait;
+    co->state = UDS_CO_SUSPENDED;
+    swapcontext(&co->ctx, &co->caller);
+    return co->arg;
+}
+
+static bool CoReady(UDSCo_t *co) {
+    switch (co->wait) {
+    case kCoWaitTimer:
+        return UDSTimeAfter(UDSMillis(), co->deadline);
+    case kCoWaitFd: {
+        struct pollfd pfd = {.fd = co->fd, .events = co->events};
+        if (poll(&pfd, 1, 0) > 0) {
+            co->revents = pfd.revents;
+            return true;
+        }
+        return co->has_deadline && UDSTimeAfter(UDSMillis(), co->deadline);
+    }
+    case kCoWaitJob:
+        UDSJobEnginePoll(co->engine);
+        return !JobActive(co->job);
+    default:
+        return true;
+    }
+}
+
+UDSErr_t UDSCoInit(UDSCo_t *co, void *stack, size_t stack_size) {
+    if (NULL == co || NULL == stack || stack_size < UDS_CO_STACK_MIN) {
+        return UDS_ERR_INVALID_ARG;
+    }
+    memset(co, 0, sizeof(*co));
+    co->stack = stack;
+    co->stack_size = stack_size;
+    co->fd = -1;
+    return UDS_OK;
+}
+
+uint8_t UDSCoDispatch(UDSCo_t *co, UDSServer_t *srv, UDSEvent_t evt, void *arg, UDSCoFn_t fn) {
+    if (UDS_CO_SUSPENDED == co->state) {
+        // the server re-evaluates a request that was answered with 0x78 on every poll
+        if (srv->RCRRP && evt == co->evt) {
+            co->arg = arg;
+            if (!CoReady(co)) {
+                return UDS_NRC_RequestCorrectlyReceived_ResponsePending;
+            }
+            return CoResume(co);
+        }
+        // the request was dropped (session change, timeout): abandon the suspended stack
+        UDS_LOGW(__FILE__, "coroutine for event %s abandoned", UDSEvtToStr(co->evt));
+        co->state = UDS_CO_IDLE;
+    }
+    if (UDS_CO_RUNNING == co->state) {
+        return UDS_NRC_BusyRepeatRequest; // reentered from the handler itself
+    }
+
+    co->fn = fn;
+    co->srv = srv;
+    co->evt = evt;
+    co->arg = arg;
+    co->wait = kCoWaitNone;
+    getcontext(&co->ctx);
+    co->ctx.uc_stack.ss_sp = co->stack;
+    co->ctx.uc_stack.ss_size = co->stack_size;
+    co->ctx.uc_link = &co->caller;
+    makecontext(&co->ctx, CoEntry, 0);
+    co_starting = co;
+    return CoResume(co);
+}
+
+void *UDSCoSleep(UDSCo_t *co, uint32_t ms) {
+    co->has_deadline = true;
+    co->deadline = UDSMillis() + ms;
+    return CoSuspend(co, kCoWaitTimer);
+}
+
+void *UDSCoWaitFd(UDSCo_t *co, int fd, short events, int timeout_ms) {
+    co->fd = fd;
+    co->events = events;
+    co->revents = 0;
+    co->has_deadline = timeout_ms >= 0;
+    co->deadline = UDSMillis() + (uint32_t)(timeout_ms < 0 ? 0 : timeout_ms);
+    void *arg = CoSuspend(co, kCoWaitFd);
+    co->fd = -1;
+    return arg;
+}
+
+void *UDSCoWaitJob(UDSCo_t *co, UDSJobEngine_t *engine, UDSJob_t *job) {
+    co->engine = engine;
+    co->job = job;
+    return CoSuspend(co, kCoWaitJob);
+}
+
+void *UDSCoYield(UDSCo_t *co) { return CoSuspend(co, kCoWaitNone); }
+#endif
+
 
 #ifdef UDS_LINES
 #line 1 "src/tp.c"
 #endif
 
+#if UDS_SYS == UDS_SYS_UNIX
+#include <errno.h>
+#include <poll.h>
+#endif
+
 
 /**
  * @brief
@@ -1963,6 +3225,70 @@ void UDSTpAckRecv(UDSTp_t *hdl) {
     hdl->ack_recv(hdl);
 }
 
+int UDSTpGetFds(UDSTp_t *hdl, int *fds, int max_fds) {
+    UDS_ASSERT(hdl);
+    if (NULL == hdl->get_fds) {
+        return 0;
+    }
+    return hdl->get_fds(hdl, fds, max_fds);
+}
+
+bool UDSTpGetDeadline(UDSTp_t *hdl, uint32_t *deadline) {
+    UDS_ASSERT(hdl);
+    if (NULL == hdl->get_deadline) {
+        return false;
+    }
+    return hdl->get_deadline(hdl, deadline);
+}
+
+int UDSTpSetCollect(UDSTp_t *hdl, bool on) {
+    UDS_ASSERT(hdl);
+    if (NULL == hdl->set_collect) {
+        return -1;
+    }
+    return hdl->set_collect(hdl, on);
+}
+
+#if UDS_SYS == UDS_SYS_UNIX
+#define UDS_TP_MAX_FDS 4
+
+UDSErr_t UDSTpWait(UDSTp_t *hdl, bool has_deadline, uint32_t deadline, int timeout_ms) {
+    UDS_ASSERT(hdl);
+    int fds[UDS_TP_MAX_FDS];
+    struct pollfd pfds[UDS_TP_MAX_FDS];
+    int nfds = UDSTpGetFds(hdl, fds, UDS_TP_MAX_FDS);
+    uint32_t tp_deadline = 0;
+
+    if (UDSTpGetDeadline(hdl, &tp_deadline)) {
+        UDSDeadlineMin(&has_deadline, &deadline, tp_deadline);
+    }
+    if (has_deadline) {
+        // UDSTimeAfter() is strict, so the deadline is only due 1 ms after it is reached
+        int32_t remaining = (int32_t)(deadline - UDSMillis()) + 1;
+        if (remaining < 0) {
+            remaining = 0;
+        }
+        if (timeout_ms < 0 || remaining < timeout_ms) {
+            timeout_ms = remaining;
+        }
+    }
+    if (0 == nfds && timeout_ms < 0) {
+        return UDS_OK; // nothing to wait on
+    }
+
+    for (int i = 0; i < nfds; i++) {
+        pfds[i].fd = fds[i];
+        pfds[i].events = POLLIN;
+        pfds[i].revents = 0;
+    }
+    if (poll(pfds, nfds, timeout_ms) < 0 && EINTR != errno) {
+        UDS_LOGE(__FILE__, "poll: %s", strerror(errno));
+        return UDS_ERR_TPORT;
+    }
+    return UDS_OK;
+}
+#endif
+
 
 #ifdef UDS_LINES
 #line 1 "src/util.c"
@@ -2056,6 +3382,8 @@ const char *UDSErrToStr(UDSErr_t err) {
         MAKE_CASE(UDS_ERR_BUFSIZ)
         MAKE_CASE(UDS_ERR_INVALID_ARG)
         MAKE_CASE(UDS_ERR_BUSY)
+        MAKE_CASE(UDS_ERR_MISUSE)
+        MAKE_CASE(UDS_ERR_BSC_MISMATCH)
     default:
         return "unknown";
     }
@@ -2090,6 +3418,8 @@ const char *UDSEvtToStr(UDSEvent_t evt) {
         MAKE_CASE(UDS_EVT_SendComplete)
         MAKE_CASE(UDS_EVT_ResponseReceived)
         MAKE_CASE(UDS_EVT_Idle)
+        MAKE_CASE(UDS_EVT_DownloadProgress)
+        MAKE_CASE(UDS_EVT_DownloadComplete)
 
     default:
         return "unknown";
@@ -2142,6 +3472,17 @@ static UDSTpStatus_t tp_poll(UDSTp_t *hdl) {
     return status;
 }
 
+static bool tp_get_deadline(UDSTp_t *hdl, uint32_t *deadline) {
+    UDS_ASSERT(hdl);
+    UDSISOTpC_t *impl = (UDSISOTpC_t *)hdl;
+    uint32_t timeout_us = 0;
+    if (!isotp_get_timeout_us(&impl->phys_link, &timeout_us)) {
+        return false;
+    }
+    *deadline = UDSMillis() + (timeout_us + 999) / 1000;
+    return true;
+}
+
 static int peek_link(IsoTpLink *link, uint8_t *buf, size_t bufsize, bool functional) {
     UDS_ASSERT(link);
     UDS_ASSERT(buf);
@@ -2276,6 +3617,9 @@ UDSErr_t UDSISOTpCInit(UDSISOTpC_t *tp, const UDSISOTpCConfig_t *cfg) {
     tp->hdl.peek = tp_peek;
     tp->hdl.ack_recv = tp_ack_recv;
     tp->hdl.get_send_buf = tp_get_send_buf;
+    tp->hdl.get_fds = NULL;
+    tp->hdl.get_deadline = tp_get_deadline;
+    tp->hdl.set_collect = NULL;
     tp->phys_sa = cfg->source_addr;
     tp->phys_ta = cfg->target_addr;
     tp->func_sa = cfg->source_addr_func;
@@ -2283,8 +3627,8 @@ UDSErr_t UDSISOTpCInit(UDSISOTpC_t *tp, const UDSISOTpCConfig_t *cfg) {
 
     isotp_init_link(&tp->phys_link, tp->phys_ta, tp->send_buf, sizeof(tp->send_buf), tp->recv_buf,
                     sizeof(tp->recv_buf));
-    isotp_init_link(&tp->func_link, tp->func_ta, tp->recv_buf, sizeof(tp->send_buf), tp->recv_buf,
-                    sizeof(tp->recv_buf));
+    isotp_init_link(&tp->func_link, tp->func_ta, tp->func_send_buf, sizeof(tp->func_send_buf),
+                    tp->recv_buf, sizeof(tp->recv_buf));
     return UDS_OK;
 }
 
@@ -2308,6 +3652,7 @@ UDSErr_t UDSISOTpCInit(UDSISOTpC_t *tp, const UDSISOTpCConfig_t *cfg) {
 #include <sys/ioctl.h>
 #include <unistd.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <stdarg.h>
 
 static int SetupSocketCAN(const char *ifname) {
@@ -2358,6 +3703,42 @@ int isotp_user_send_can(const uint32_t arbitration_id, const uint8_t *data, cons
     return ISOTP_RET_OK;
 }
 
+/**
+ * @brief Feed a frame from a responder to a functional request into its reassembly slot. A slot
+ * is claimed by the first single or first frame of a responder.
+ */
+static void ResponderRecv(UDSTpISOTpC_t *tp, const struct can_frame *frame) {
+    UDSTpISOTpCResponder_t *slot = NULL;
+    UDSTpISOTpCResponder_t *free_slot = NULL;
+    for (int i = 0; i < tp->num_responders; i++) {
+        UDSTpISOTpCResponder_t *r = &tp->responders[i];
+        if (r->in_use && r->rx_id == frame->can_id) {
+            slot = r;
+            break;
+        }
+        if (!r->in_use && NULL == free_slot) {
+            free_slot = r;
+        }
+    }
+    if (NULL == slot) {
+        uint8_t pci_type = frame->can_dlc ? frame->data[0] >> 4 : 0xF;
+        if (pci_type > 1) {
+            return; // not the start of a message
+        }
+        if (NULL == free_slot) {
+            UDS_LOGI(__FILE__, "no free responder slot for 0x%03x", frame->can_id);
+            return;
+        }
+        slot = free_slot;
+        isotp_init_link(&slot->link, frame->can_id - tp->responder_fc_offset, tp->send_buf,
+                        sizeof(tp->send_buf), slot->recv_buf, sizeof(slot->recv_buf));
+        slot->link.user_send_can_arg = &(tp->fd);
+        slot->rx_id = frame->can_id;
+        slot->in_use = true;
+    }
+    isotp_on_can_message(&slot->link, frame->data, frame->can_dlc);
+}
+
 static void SocketCANRecv(UDSTpISOTpC_t *tp) {
     UDS_ASSERT(tp);
     struct can_frame frame = {0};
@@ -2376,6 +3757,9 @@ static void SocketCANRecv(UDSTpISOTpC_t *tp) {
         } else {
             if (frame.can_id == tp->phys_sa) {
                 isotp_on_can_message(&tp->phys_link, frame.data, frame.can_dlc);
+            } else if (tp->collecting && frame.can_id >= tp->responder_first_id &&
+                       frame.can_id <= tp->responder_last_id) {
+                ResponderRecv(tp, &frame);
             } else if (frame.can_id == tp->func_sa) {
                 if (ISOTP_RECEIVE_STATUS_IDLE != tp->phys_link.receive_status) {
                     UDS_LOGI(__FILE__,
@@ -2398,12 +3782,57 @@ static UDSTpStatus_t isotp_c_socketcan_tp_poll(UDSTp_t *hdl) {
     if (impl->phys_link.send_status == ISOTP_SEND_STATUS_INPROGRESS) {
         status |= UDS_TP_SEND_IN_PROGRESS;
     }
+    if (impl->collecting) {
+        if (ISOTP_RECEIVE_STATUS_INPROGRESS == impl->phys_link.receive_status) {
+            status |= UDS_TP_RECV_IN_PROGRESS;
+        }
+        for (int i = 0; i < impl->num_responders; i++) {
+            UDSTpISOTpCResponder_t *r = &impl->responders[i];
+            if (!r->in_use) {
+                continue;
+            }
+            isotp_poll(&r->link);
+            if (ISOTP_RECEIVE_STATUS_INPROGRESS == r->link.receive_status) {
+                status |= UDS_TP_RECV_IN_PROGRESS;
+            }
+        }
+    }
     if (impl->phys_link.send_status == ISOTP_SEND_STATUS_ERROR) {
         status |= UDS_TP_ERR;
     }
     return status;
 }
 
+static int isotp_c_socketcan_tp_get_fds(UDSTp_t *hdl, int *fds, int max_fds) {
+    UDS_ASSERT(hdl);
+    UDSTpISOTpC_t *impl = (UDSTpISOTpC_t *)hdl;
+    if (max_fds < 1 || impl->fd < 0) {
+        return 0;
+    }
+    fds[0] = impl->fd;
+    return 1;
+}
+
+static bool isotp_c_socketcan_tp_get_deadline(UDSTp_t *hdl, uint32_t *deadline) {
+    UDS_ASSERT(hdl);
+    UDSTpISOTpC_t *impl = (UDSTpISOTpC_t *)hdl;
+    uint32_t timeout_us = 0;
+    bool pending = isotp_get_timeout_us(&impl->phys_link, &timeout_us);
+    for (int i = 0; impl->collecting && i < impl->num_responders; i++) {
+        uint32_t t;
+        if (impl->responders[i].in_use && isotp_get_timeout_us(&impl->responders[i].link, &t) &&
+            (!pending || t < timeout_us)) {
+            timeout_us = t;
+            pending = true;
+        }
+    }
+    if (!pending) {
+        return false;
+    }
+    *deadline = UDSMillis() + (timeout_us + 999) / 1000;
+    return true;
+}
+
 static int isotp_c_socketcan_tp_peek_link(IsoTpLink *link, uint8_t *buf, size_t bufsize,
                                           bool functional) {
     UDS_ASSERT(link);
@@ -2436,6 +3865,11 @@ static ssize_t isotp_c_socketcan_tp_peek(UDSTp_t *hdl, uint8_t **p_buf, UDSSDU_t
     UDSTpISOTpC_t *tp = (UDSTpISOTpC_t *)hdl;
     if (ISOTP_RECEIVE_STATUS_FULL == tp->phys_link.receive_status) { // recv not yet acked
         *p_buf = tp->recv_buf;
+        if (info) {
+            info->A_TA = tp->phys_sa;
+            info->A_SA = tp->phys_ta;
+            info->A_TA_Type = UDS_A_TA_TYPE_PHYSICAL;
+        }
         return tp->phys_link.receive_size;
     }
     int ret = -1;
@@ -2467,6 +3901,18 @@ static ssize_t isotp_c_socketcan_tp_peek(UDSTp_t *hdl, uint8_t **p_buf, UDSSDU_t
             goto done;
         }
     }
+    for (int i = 0; tp->collecting && i < tp->num_responders; i++) {
+        UDSTpISOTpCResponder_t *r = &tp->responders[i];
+        if (r->in_use && ISOTP_RECEIVE_STATUS_FULL == r->link.receive_status) {
+            ret = r->link.receive_size;
+            ta = r->rx_id;
+            sa = r->link.send_arbitration_id;
+            ta_type = UDS_A_TA_TYPE_PHYSICAL;
+            *p_buf = r->recv_buf;
+            tp->recv_responder = r;
+            goto done;
+        }
+    }
 done:
     if (ret > 0) {
         if (info) {
@@ -2528,9 +3974,42 @@ static void isotp_c_socketcan_tp_ack_recv(UDSTp_t *hdl) {
     UDS_ASSERT(hdl);
     UDSTpISOTpC_t *tp = (UDSTpISOTpC_t *)hdl;
     uint16_t out_size = 0;
+    if (tp->recv_responder) {
+        UDSTpISOTpCResponder_t *r = tp->recv_responder;
+        tp->recv_responder = NULL;
+        isotp_receive(&r->link, r->recv_buf, sizeof(r->recv_buf), &out_size);
+        return;
+    }
     isotp_receive(&tp->phys_link, tp->recv_buf, sizeof(tp->recv_buf), &out_size);
 }
 
+static int isotp_c_socketcan_tp_set_collect(UDSTp_t *hdl, bool on) {
+    UDS_ASSERT(hdl);
+    UDSTpISOTpC_t *tp = (UDSTpISOTpC_t *)hdl;
+    if (on) {
+        // responses still held from an earlier broadcast are stale
+        for (int i = 0; i < tp->num_responders; i++) {
+            tp->responders[i].in_use = false;
+        }
+        tp->recv_responder = NULL;
+    }
+    tp->collecting = on;
+    return 0;
+}
+
+void UDSTpISOTpCSetResponders(UDSTpISOTpC_t *tp, UDSTpISOTpCResponder_t *pool, int n,
+                              uint32_t first_id, uint32_t last_id, uint32_t fc_offset) {
+    UDS_ASSERT(tp);
+    tp->responders = pool;
+    tp->num_responders = pool ? n : 0;
+    tp->responder_first_id = first_id;
+    tp->responder_last_id = last_id;
+    tp->responder_fc_offset = fc_offset;
+    for (int i = 0; i < tp->num_responders; i++) {
+        pool[i].in_use = false;
+    }
+}
+
 static ssize_t isotp_c_socketcan_tp_get_send_buf(UDSTp_t *hdl, uint8_t **p_buf) {
     UDS_ASSERT(hdl);
     UDSTpISOTpC_t *tp = (UDSTpISOTpC_t *)hdl;
@@ -2543,20 +4022,41 @@ UDSErr_t UDSTpISOTpCInit(UDSTpISOTpC_t *tp, const char *ifname, uint32_t source_
                          uint32_t target_addr_func) {
     UDS_ASSERT(tp);
     UDS_ASSERT(ifname);
+    return UDSTpISOTpCInitFd(tp, SetupSocketCAN(ifname), source_addr, target_addr,
+                             source_addr_func, target_addr_func);
+}
+
+UDSErr_t UDSTpISOTpCInitFd(UDSTpISOTpC_t *tp, int fd, uint32_t source_addr, uint32_t target_addr,
+                           uint32_t source_addr_func, uint32_t target_addr_func) {
+    UDS_ASSERT(tp);
+    if (fd < 0) {
+        return UDS_ERR_TPORT;
+    }
+    int flags = fcntl(fd, F_GETFL);
+    if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+        return UDS_ERR_TPORT;
+    }
     tp->hdl.poll = isotp_c_socketcan_tp_poll;
     tp->hdl.send = isotp_c_socketcan_tp_send;
     tp->hdl.peek = isotp_c_socketcan_tp_peek;
     tp->hdl.ack_recv = isotp_c_socketcan_tp_ack_recv;
     tp->hdl.get_send_buf = isotp_c_socketcan_tp_get_send_buf;
+    tp->hdl.get_fds = isotp_c_socketcan_tp_get_fds;
+    tp->hdl.get_deadline = isotp_c_socketcan_tp_get_deadline;
+    tp->hdl.set_collect = isotp_c_socketcan_tp_set_collect;
     tp->phys_sa = source_addr;
     tp->phys_ta = target_addr;
     tp->func_sa = source_addr_func;
     tp->func_ta = target_addr;
-    tp->fd = SetupSocketCAN(ifname);
+    tp->fd = fd;
+    tp->responders = NULL;
+    tp->num_responders = 0;
+    tp->collecting = false;
+    tp->recv_responder = NULL;
 
     isotp_init_link(&tp->phys_link, target_addr, tp->send_buf, sizeof(tp->send_buf), tp->recv_buf,
                     sizeof(tp->recv_buf));
-    isotp_init_link(&tp->func_link, target_addr_func, tp->recv_buf, sizeof(tp->send_buf),
+    isotp_init_link(&tp->func_link, target_addr_func, tp->func_send_buf, sizeof(tp->func_send_buf),
                     tp->recv_buf, sizeof(tp->recv_buf));
 
     tp->phys_link.user_send_can_arg = &(tp->fd);
@@ -2607,7 +4107,7 @@ static UDSTpStatus_t isotp_sock_tp_poll(UDSTp_t *hdl) {
     pfds[1].events = POLLERR;
     pfds[1].revents = 0;
 
-    ret = poll(pfds, 2, 1);
+    ret = poll(pfds, 2, 0); // only collect pending errors, waiting is done by UDSTpWait()
     if (ret < 0) {
         perror("poll");
     } else if (ret == 0) {
@@ -2641,6 +4141,19 @@ static UDSTpStatus_t isotp_sock_tp_poll(UDSTp_t *hdl) {
     return status;
 }
 
+static int isotp_sock_tp_get_fds(UDSTp_t *hdl, int *fds, int max_fds) {
+    UDS_ASSERT(hdl);
+    UDSTpIsoTpSock_t *impl = (UDSTpIsoTpSock_t *)hdl;
+    int n = 0;
+    if (n < max_fds) {
+        fds[n++] = impl->phys_fd;
+    }
+    if (n < max_fds) {
+        fds[n++] = impl->func_fd;
+    }
+    return n;
+}
+
 static ssize_t tp_recv_once(int fd, uint8_t *buf, size_t size) {
     ssize_t ret = read(fd, buf, size);
     if (ret < 0) {
@@ -2803,6 +4316,7 @@ UDSErr_t UDSTpIsoTpSockInitServer(UDSTpIsoTpSock_t *tp, const char *ifname, uint
     tp->hdl.poll = isotp_sock_tp_poll;
     tp->hdl.ack_recv = isotp_sock_tp_ack_recv;
     tp->hdl.get_send_buf = isotp_sock_tp_get_send_buf;
+    tp->hdl.get_fds = isotp_sock_tp_get_fds;
     tp->phys_sa = source_addr;
     tp->phys_ta = target_addr;
     tp->func_sa = source_addr_func;
@@ -2831,6 +4345,7 @@ UDSErr_t UDSTpIsoTpSockInitClient(UDSTpIsoTpSock_t *tp, const char *ifname, uint
     tp->hdl.poll = isotp_sock_tp_poll;
     tp->hdl.ack_recv = isotp_sock_tp_ack_recv;
     tp->hdl.get_send_buf = isotp_sock_tp_get_send_buf;
+    tp->hdl.get_fds = isotp_sock_tp_get_fds;
     tp->func_ta = target_addr_func;
     tp->phys_ta = target_addr;
     tp->phys_sa = source_addr;
@@ -2990,6 +4505,21 @@ static UDSTpStatus_t mock_tp_poll(struct UDSTp *hdl) {
     return UDS_TP_IDLE;
 }
 
+// the mock network delivers a message once its scheduled_tx_time has passed
+static bool mock_tp_get_deadline(struct UDSTp *hdl, uint32_t *deadline) {
+    if (0 == MsgCount) {
+        return false;
+    }
+    uint32_t earliest = msgs[0].scheduled_tx_time;
+    for (unsigned i = 1; i < MsgCount; i++) {
+        if (UDSTimeAfter(earliest, msgs[i].scheduled_tx_time)) {
+            earliest = msgs[i].scheduled_tx_time;
+        }
+    }
+    *deadline = earliest;
+    return true;
+}
+
 static ssize_t mock_tp_get_send_buf(struct UDSTp *hdl, uint8_t **p_buf) {
     assert(hdl);
     assert(p_buf);
@@ -3016,6 +4546,9 @@ static void ISOTPMockAttach(ISOTPMock_t *tp, ISOTPMockArgs_t *args) {
     tp->hdl.poll = mock_tp_poll;
     tp->hdl.get_send_buf = mock_tp_get_send_buf;
     tp->hdl.ack_recv = mock_tp_ack_recv;
+    tp->hdl.get_fds = NULL;
+    tp->hdl.get_deadline = mock_tp_get_deadline;
+    tp->hdl.set_collect = NULL;
     tp->sa_func = args->sa_func;
     tp->sa_phys = args->sa_phys;
     tp->ta_func = args->ta_func;
@@ -3381,6 +4914,8 @@ int isotp_send_with_id(IsoTpLink *link, uint32_t id, const uint8_t payload[], ui
         return ISOTP_RET_INPROGRESS;
     }
 
+    UDS_TRACE2(isotp_send, id, size);
+
     /* copy into local buffer */
     link->send_size = size;
     link->send_offset = 0;
@@ -3415,6 +4950,7 @@ void isotp_on_can_message(IsoTpLink *link, const uint8_t *data, uint8_t len) {
     if (len < 2 || len > 8) {
         return;
     }
+    UDS_TRACE2(isotp_rx_frame, data[0] >> 4, len);
 
     memcpy(message.as.data_array.ptr, data, len);
     memset(message.as.data_array.ptr + len, 0, sizeof(message.as.data_array.ptr) - len);
@@ -3434,6 +4970,7 @@ void isotp_on_can_message(IsoTpLink *link, const uint8_t *data, uint8_t len) {
             if (ISOTP_RET_OK == ret) {
                 /* change status */
                 link->receive_status = ISOTP_RECEIVE_STATUS_FULL;
+                UDS_TRACE1(isotp_rx_complete, link->receive_size);
             }
             break;
         }
@@ -3497,6 +5034,7 @@ void isotp_on_can_message(IsoTpLink *link, const uint8_t *data, uint8_t len) {
                 /* receive finished */
                 if (link->receive_offset >= link->receive_size) {
                     link->receive_status = ISOTP_RECEIVE_STATUS_FULL;
+                    UDS_TRACE1(isotp_rx_complete, link->receive_size);
                 } else {
                     /* send fc when bs reaches limit */
                     if (0 == --link->receive_bs_count) {
@@ -3613,11 +5151,13 @@ void isotp_poll(IsoTpLink *link) {
                 /* check if send finish */
                 if (link->send_offset >= link->send_size) {
                     link->send_status = ISOTP_SEND_STATUS_IDLE;
+                    UDS_TRACE1(isotp_send_complete, link->send_size);
                 }
             } else if (ISOTP_RET_NOSPACE == ret) {
                 /* shim reported that it isn't able to send a frame at present, retry on next call */
             } else {
                 link->send_status = ISOTP_SEND_STATUS_ERROR;
+                UDS_TRACE1(isotp_send_error, ret);
             }
         }
 
@@ -3625,6 +5165,7 @@ void isotp_poll(IsoTpLink *link) {
         if (IsoTpTimeAfter(isotp_user_get_us(), link->send_timer_bs)) {
             link->send_protocol_result = ISOTP_PROTOCOL_RESULT_TIMEOUT_BS;
             link->send_status = ISOTP_SEND_STATUS_ERROR;
+            UDS_TRACE0(isotp_timeout_bs);
         }
     }
 
@@ -3635,10 +5176,43 @@ void isotp_poll(IsoTpLink *link) {
         if (IsoTpTimeAfter(isotp_user_get_us(), link->receive_timer_cr)) {
             link->receive_protocol_result = ISOTP_PROTOCOL_RESULT_TIMEOUT_CR;
             link->receive_status = ISOTP_RECEIVE_STATUS_IDLE;
+            UDS_TRACE0(isotp_timeout_cr);
         }
     }
 
     return;
 }
+
+int isotp_get_timeout_us(IsoTpLink *link, uint32_t *timeout_us) {
+    uint32_t now = isotp_user_get_us();
+    int32_t remain = 0;
+    int pending = 0;
+
+    if (ISOTP_SEND_STATUS_INPROGRESS == link->send_status) {
+        /* next consecutive frame is due once st_min has elapsed, unless waiting for FC */
+        if (ISOTP_INVALID_BS == link->send_bs_remain || link->send_bs_remain > 0) {
+            remain = 0 == link->send_st_min_us ? 0 : (int32_t)(link->send_timer_st - now);
+            pending = 1;
+        }
+        int32_t bs = (int32_t)(link->send_timer_bs - now);
+        if (!pending || bs < remain) {
+            remain = bs;
+        }
+        pending = 1;
+    }
+
+    if (ISOTP_RECEIVE_STATUS_INPROGRESS == link->receive_status) {
+        int32_t cr = (int32_t)(link->receive_timer_cr - now);
+        if (!pending || cr < remain) {
+            remain = cr;
+        }
+        pending = 1;
+    }
+
+    if (pending) {
+        *timeout_us = remain > 0 ? (uint32_t)remain : 0;
+    }
+    return pending;
+}
 #endif
 
@@ -119,7 +119,13 @@ typedef SSIZE_T ssize_t;
 #define UDS_CLIENT_DEFAULT_S3_MS (2000)
 #endif
 
-_Static_assert(UDS_CLIENT_DEFAULT_P2_STAR_MS > UDS_CLIENT_DEFAULT_P2_MS, "");
+#ifdef __cplusplus
+#define UDS_STATIC_ASSERT(cond, msg) static_assert(cond, msg)
+#else
+#define UDS_STATIC_ASSERT(cond, msg) _Static_assert(cond, msg)
+#endif
+
+UDS_STATIC_ASSERT(UDS_CLIENT_DEFAULT_P2_STAR_MS > UDS_CLIENT_DEFAULT_P2_MS, "");
 
 #ifndef UDS_SERVER_DEFAULT_POWER_DOWN_TIME_MS
 #define UDS_SERVER_DEFAULT_POWER_DOWN_TIME_MS (10)
@@ -140,10 +146,10 @@ _Static_assert(UDS_CLIENT_DEFAULT_P2_STAR_MS > UDS_CLIENT_DEFAULT_P2_MS, "");
 #define UDS_SERVER_DEFAULT_S3_MS (5100)
 #endif
 
-_Static_assert(0 < UDS_SERVER_DEFAULT_P2_MS &&
-                   UDS_SERVER_DEFAULT_P2_MS < UDS_SERVER_DEFAULT_P2_STAR_MS &&
-                   UDS_SERVER_DEFAULT_P2_STAR_MS < UDS_SERVER_DEFAULT_S3_MS,
-               "");
+UDS_STATIC_ASSERT(0 < UDS_SERVER_DEFAULT_P2_MS &&
+                      UDS_SERVER_DEFAULT_P2_MS < UDS_SERVER_DEFAULT_P2_STAR_MS &&
+                      UDS_SERVER_DEFAULT_P2_STAR_MS < UDS_SERVER_DEFAULT_S3_MS,
+                  "");
 
 // Amount of time to wait after boot before accepting 0x27 requests.
 #ifndef UDS_SERVER_0x27_BRUTE_FORCE_MITIGATION_BOOT_DELAY_MS
@@ -178,6 +184,7 @@ enum UDSTpStatusFlags {
     UDS_TP_SEND_IN_PROGRESS = 0x0001,
     UDS_TP_RECV_COMPLETE = 0x0002,
     UDS_TP_ERR = 0x0004,
+    UDS_TP_RECV_IN_PROGRESS = 0x0008, // a response to a functional request is being reassembled
 };
 
 typedef uint32_t UDSTpStatus_t;
@@ -260,6 +267,35 @@ typedef struct UDSTp {
      * @note: after ack_recv() is called and before new messages are received, peek must return 0.
      */
     void (*ack_recv)(struct UDSTp *hdl);
+
+    /**
+     * @brief Get the file descriptors that become readable when the transport has work to do
+     * (optional, may be NULL)
+     * @param hdl: pointer to transport handle
+     * @param fds: filled with up to max_fds file descriptors
+     * @return number of file descriptors written to fds
+     */
+    int (*get_fds)(struct UDSTp *hdl, int *fds, int max_fds);
+
+    /**
+     * @brief Get the time by which poll must be called again to service the transport's own
+     * timers such as N_Bs, N_Cr and STmin (optional, may be NULL)
+     * @param hdl: pointer to transport handle
+     * @param deadline: set to the deadline in UDSMillis() time if one is pending
+     * @return true if a deadline is pending
+     */
+    bool (*get_deadline)(struct UDSTp *hdl, uint32_t *deadline);
+
+    /**
+     * @brief Start or stop collecting responses to a functional request (optional, may be NULL)
+     * @param hdl: pointer to transport handle
+     * @param on: while true, peek also returns complete messages from responders other than the
+     * physical peer, with info->A_SA set to the responder's address. Multi-frame responses from
+     * different responders are reassembled in parallel and poll reports
+     * UDS_TP_RECV_IN_PROGRESS while any of them is incomplete.
+     * @return 0 on success, -1 if the transport cannot collect
+     */
+    int (*set_collect)(struct UDSTp *hdl, bool on);
 } UDSTp_t;
 
 ssize_t UDSTpGetSendBuf(UDSTp_t *hdl, uint8_t **buf);
@@ -269,6 +305,9 @@ ssize_t UDSTpPeek(struct UDSTp *hdl, uint8_t **buf, UDSSDU_t *info);
 const uint8_t *UDSTpGetRecvBuf(UDSTp_t *hdl, size_t *len);
 size_t UDSTpGetRecvLen(UDSTp_t *hdl);
 void UDSTpAckRecv(UDSTp_t *hdl);
+int UDSTpGetFds(UDSTp_t *hdl, int *fds, int max_fds);
+bool UDSTpGetDeadline(UDSTp_t *hdl, uint32_t *deadline);
+int UDSTpSetCollect(UDSTp_t *hdl, bool on);
 
 
 #pragma once
@@ -299,8 +338,10 @@ typedef enum UDSEvent {
     // Client Event
     UDS_EVT_Poll,             // NULL
     UDS_EVT_SendComplete,     //
-    UDS_EVT_ResponseReceived, //
+    UDS_EVT_ResponseReceived, // UDSBroadcast_t * after UDSSendBroadcast(), otherwise NULL
     UDS_EVT_Idle,             // NULL
+    UDS_EVT_DownloadProgress, // UDSDownloadProgress_t * after each TransferData block
+    UDS_EVT_DownloadComplete, // UDSDownloadProgress_t *, err is set
 
     UDS_EVT_MAX, // unused
 } UDSEvent_t;
@@ -396,6 +437,7 @@ typedef enum {
     UDS_ERR_INVALID_ARG,          // The function has been called with invalid arguments
     UDS_ERR_BUSY,                 // The client is busy and cannot process the request
     UDS_ERR_MISUSE,               // The library is used incorrectly
+    UDS_ERR_BSC_MISMATCH,         // The 0x76 blockSequenceCounter does not match the 0x36 request
 } UDSErr_t;
 
 enum UDSDiagnosticSessionType {
@@ -558,12 +600,32 @@ static inline bool UDSTimeAfter(uint32_t a, uint32_t b) {
     return ((int32_t)((int32_t)(b) - (int32_t)(a)) < 0);
 }
 
+/* sets `*deadline` to `t` if no deadline is set yet or `t` is earlier */
+static inline void UDSDeadlineMin(bool *has_deadline, uint32_t *deadline, uint32_t t) {
+    if (!*has_deadline || UDSTimeAfter(*deadline, t)) {
+        *deadline = t;
+    }
+    *has_deadline = true;
+}
+
 /**
  * @brief Get time in milliseconds
  * @return current time in milliseconds
  */
 uint32_t UDSMillis(void);
 
+#if UDS_SYS == UDS_SYS_UNIX
+/**
+ * @brief Sleep in poll() on the transport's file descriptors until one becomes readable, the
+ * earliest of `deadline` and the transport's own deadline passes, or timeout_ms elapses
+ * @param has_deadline: whether `deadline` is valid
+ * @param deadline: caller's deadline in UDSMillis() time
+ * @param timeout_ms: upper bound on the wait, -1 for none
+ * @return UDS_OK when woken, UDS_ERR_TPORT if poll() fails
+ */
+UDSErr_t UDSTpWait(UDSTp_t *hdl, bool has_deadline, uint32_t deadline, int timeout_ms);
+#endif
+
 bool UDSSecurityAccessLevelIsReserved(uint8_t securityLevel);
 
 const char *UDSErrToStr(UDSErr_t err);
@@ -673,6 +735,87 @@ void UDS_LogSDUInternal(UDS_LogLevel_t level, const char *tag, const uint8_t *bu
 
 #pragma once
 
+/**
+ * @brief USDT static tracepoints, provider "uds".
+ *
+ * A probe compiles to a single nop plus an entry in the ELF .note.stapsdt section, so it costs
+ * nothing until a tracer attaches to it:
+ *   perf probe -x ./uds_server sdt_uds:isotp_rx_frame
+ *   bpftrace -l 'usdt:./uds_server:uds:*'
+ *
+ * <sys/sdt.h> (systemtap-sdt-dev) is used when available. Otherwise on x86-64 and AArch64 with
+ * GCC/Clang an equivalent note is emitted directly. Define UDS_NO_USDT to remove all probes.
+ * Arguments must be integers.
+ */
+#if !defined(UDS_NO_USDT) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define UDS_USDT_SYS_SDT 1
+#endif
+#endif
+
+#if defined(UDS_USDT_SYS_SDT)
+#define UDS_TRACE0(name) STAP_PROBE(uds, name)
+#define UDS_TRACE1(name, a) STAP_PROBE1(uds, name, a)
+#define UDS_TRACE2(name, a, b) STAP_PROBE2(uds, name, a, b)
+#define UDS_TRACE3(name, a, b, c) STAP_PROBE3(uds, name, a, b, c)
+#define UDS_TRACE4(name, a, b, c, d) STAP_PROBE4(uds, name, a, b, c, d)
+#elif !defined(UDS_NO_USDT) && defined(__GNUC__) && (defined(__x86_64__) || defined(__aarch64__))
+// stapsdt note version 3: probe address, .stapsdt.base address, semaphore (none), provider,
+// name, and "size@operand" per argument (negative size for signed arguments; %n negates)
+#define UDS_SDT_NOTE(name, args)                                                                   \
+    "990: nop\n"                                                                                   \
+    ".pushsection .note.stapsdt,\"?\",\"note\"\n"                                                  \
+    ".balign 4\n"                                                                                  \
+    ".4byte 992f-991f, 994f-993f, 3\n"                                                             \
+    "991: .asciz \"stapsdt\"\n"                                                                    \
+    "992: .balign 4\n"                                                                             \
+    "993: .8byte 990b\n"                                                                           \
+    ".8byte _.stapsdt.base\n"                                                                      \
+    ".8byte 0\n"                                                                                   \
+    ".asciz \"uds\"\n"                                                                             \
+    ".asciz \"" #name "\"\n"                                                                       \
+    ".asciz \"" args "\"\n"                                                                        \
+    "994: .balign 4\n"                                                                             \
+    ".popsection\n"                                                                                \
+    ".ifndef _.stapsdt.base\n"                                                                     \
+    ".pushsection .stapsdt.base,\"aG\",\"progbits\",.stapsdt.base,comdat\n"                        \
+    ".weak _.stapsdt.base\n"                                                                       \
+    ".hidden _.stapsdt.base\n"                                                                     \
+    "_.stapsdt.base: .space 1\n"                                                                   \
+    ".size _.stapsdt.base, 1\n"                                                                    \
+    ".popsection\n"                                                                                \
+    ".endif\n"
+#define UDS_SDT_ARG(n, x)                                                                          \
+    [uds_sdt_s##n] "n"((((__typeof__(x))-1 < 1) ? 1 : -1) * (int)sizeof(x)), [uds_sdt_a##n] "nor"(x)
+#define UDS_SDT_FMT(n) "%n[uds_sdt_s" #n "]@%[uds_sdt_a" #n "]"
+#define UDS_TRACE0(name) __asm__ __volatile__(UDS_SDT_NOTE(name, "") : :)
+#define UDS_TRACE1(name, a) __asm__ __volatile__(UDS_SDT_NOTE(name, UDS_SDT_FMT(1)) : : UDS_SDT_ARG(1, a))
+#define UDS_TRACE2(name, a, b)                                                                     \
+    __asm__ __volatile__(UDS_SDT_NOTE(name, UDS_SDT_FMT(1) " " UDS_SDT_FMT(2))                     \
+                         :                                                                         \
+                         : UDS_SDT_ARG(1, a), UDS_SDT_ARG(2, b))
+#define UDS_TRACE3(name, a, b, c)                                                                  \
+    __asm__ __volatile__(UDS_SDT_NOTE(name, UDS_SDT_FMT(1) " " UDS_SDT_FMT(2) " " UDS_SDT_FMT(3))  \
+                         :                                                                         \
+                         : UDS_SDT_ARG(1, a), UDS_SDT_ARG(2, b), UDS_SDT_ARG(3, c))
+#define UDS_TRACE4(name, a, b, c, d)                                                               \
+    __asm__ __volatile__(UDS_SDT_NOTE(name, UDS_SDT_FMT(1) " " UDS_SDT_FMT(2) " " UDS_SDT_FMT(3)   \
+                                                " " UDS_SDT_FMT(4))                                \
+                         :                                                                         \
+                         : UDS_SDT_ARG(1, a), UDS_SDT_ARG(2, b), UDS_SDT_ARG(3, c),                \
+                           UDS_SDT_ARG(4, d))
+#else
+#define UDS_TRACE0(name) ((void)0)
+#define UDS_TRACE1(name, a) ((void)0)
+#define UDS_TRACE2(name, a, b) ((void)0)
+#define UDS_TRACE3(name, a, b, c) ((void)0)
+#define UDS_TRACE4(name, a, b, c, d) ((void)0)
+#endif
+
+
+#pragma once
+
 
 
 
@@ -684,6 +827,88 @@ enum UDSClientOptions {
     UDS_IGNORE_SRV_TIMINGS = 0x8, // 忽略服务器给的p2和p2_star
 };
 
+struct UDSClient;
+struct UDSClientReq;
+
+/**
+ * @brief Completion callback of a queued request
+ * @param err UDS_OK when the request completed (a positive response is in client->recv_buf /
+ * client->recv_size, valid until the callback returns), the NRC of a negative response, or a
+ * UDS_ERR_* code
+ * @note the callback may enqueue further requests, including `req` itself
+ */
+typedef void (*UDSClientReqCb_t)(struct UDSClient *client, struct UDSClientReq *req,
+                                 UDSErr_t err);
+
+/**
+ * @brief A request in the client queue. Owned by the caller and must stay valid, together with
+ * `data`, until its callback has run.
+ */
+typedef struct UDSClientReq {
+    const uint8_t *data; // request bytes, starting with the SID
+    uint16_t len;
+    uint8_t options;     // enum UDSClientOptions used for this request
+    UDSClientReqCb_t cb; // may be NULL
+    void *cb_data;       // user-specified callback data
+    struct UDSClientReq *next; // private
+} UDSClientReq_t;
+
+/**
+ * @brief One responder's answer to a functional request
+ */
+typedef struct {
+    uint32_t sa;         // responder address (the A_SA reported by the transport)
+    UDSErr_t err;        // UDS_OK for a positive response, otherwise the NRC
+    const uint8_t *data; // response, points into the UDSBroadcast_t buffer
+    uint16_t len;
+} UDSBroadcastResp_t;
+
+/**
+ * @brief Result table of UDSSendBroadcast(), keyed by responder address. The table and the data
+ * buffer are provided by the caller.
+ */
+typedef struct UDSBroadcast {
+    UDSBroadcastResp_t *resp;
+    uint16_t max_resp;
+    uint16_t num_resp;
+    uint8_t *buf;
+    size_t buf_size;
+    size_t buf_used;
+    uint16_t dropped; // responses that did not fit into the table or the buffer
+} UDSBroadcast_t;
+
+/**
+ * @brief Progress and throughput of a download started with UDSConfigDownload()
+ */
+typedef struct {
+    size_t sent;          // bytes acknowledged by the server
+    size_t total;         // memorySize
+    uint32_t blocks;      // TransferData requests acknowledged
+    uint16_t block_len;   // data bytes per TransferData request
+    uint32_t elapsed_ms;  // since RequestDownload was sent
+    uint32_t bytes_per_s; // sent / elapsed_ms
+    UDSErr_t err;         // why the download stopped, UDS_OK on success
+} UDSDownloadProgress_t;
+
+/**
+ * @brief State of UDSConfigDownload(), private
+ */
+typedef struct {
+    FILE *fd;
+    const uint8_t *map; // read-only mapping of the image, NULL when reading with fread()
+    size_t map_len;
+    size_t map_skip;    // offset of the image within the mapping (page alignment)
+    long file_start;    // file offset of the image
+    size_t offset;      // image bytes read so far, including the block in flight and staged
+    uint8_t *staged_buf; // send buffer holding the staged block
+    uint16_t staged;    // data bytes of the next block already in send_buf, 0 if none
+    uint16_t inflight;  // data bytes of the block on the bus
+    uint8_t bsc;        // next blockSequenceCounter
+    uint8_t step;
+    uint32_t t_start;
+    UDSDownloadProgress_t progress;
+} UDSDownload_t;
+
 typedef struct UDSClient {
     uint16_t p2_ms;      // p2 超时时间
     uint32_t p2_star_ms; // 0x78 p2* 超时时间
@@ -706,6 +931,21 @@ typedef struct UDSClient {
     // callback function
     int (*fn)(struct UDSClient *client, UDSEvent_t evt, void *ev_data);
     void *fn_data; // user-specified function data
+
+    // request queue, see UDSClientEnqueue()
+    UDSClientReq_t *queue_head;
+    UDSClientReq_t *queue_tail;
+    UDSClientReq_t *queue_current; // request in flight
+
+    UDSBroadcast_t *broadcast; // collecting responses, see UDSSendBroadcast()
+    UDSDownload_t download;    // see UDSConfigDownload()
+    int timer_fd;              // see UDSClientTimerFd(), -1 if not open
+
+    // TesterPresent keep-alive, see UDSClientSetKeepAlive()
+    uint32_t keepalive_ms;     // interval, 0 if disabled
+    uint32_t keepalive_timer;  // next TesterPresent unless a request is sent first
+    bool keepalive_functional; // send on the functional address
+    uint32_t keepalive_sent;   // TesterPresent requests sent by the keep-alive
 } UDSClient_t;
 
 struct SecurityAccessResponse {
@@ -732,9 +972,200 @@ typedef struct {
     void *(*UnpackFn)(void *dst, const void *src, size_t n);
 } UDSRDBIVar_t;
 
+/**
+ * @brief How a data record of a UDSRDBIPlan_t is stored into `data`
+ */
+typedef enum {
+    UDS_RDBI_BYTES = 0, // len bytes, as received
+    UDS_RDBI_U8,        // uint8_t
+    UDS_RDBI_U16,       // uint16_t, big-endian on the wire
+    UDS_RDBI_U32,       // uint32_t, big-endian on the wire
+} UDSRDBIType_t;
+
+typedef struct {
+    uint16_t did;
+    uint16_t len;   // data record length in bytes
+    uint8_t type;   // UDSRDBIType_t
+    void *data;     // destination
+    uint16_t offset; // private: position of the data record in the response
+} UDSRDBIPlanVar_t;
+
+/**
+ * @brief One ReadDataByIdentifier request of a plan, sized to fit the transport MTU
+ */
+typedef struct {
+    UDSClientReq_t req; // private, must be the first member
+    struct UDSRDBIPlan *plan;
+    uint16_t first_var;
+    uint16_t num_vars;
+    uint16_t resp_len; // expected positive response length
+} UDSRDBIPlanChunk_t;
+
+typedef void (*UDSRDBIPlanCb_t)(struct UDSClient *client, struct UDSRDBIPlan *plan, UDSErr_t err);
+
+/**
+ * @brief A DID set compiled into MTU-sized requests with a fixed response layout. See
+ * UDSRDBIPlanCompile(). All storage is provided by the caller.
+ */
+typedef struct UDSRDBIPlan {
+    UDSRDBIPlanVar_t *vars;
+    uint16_t num_vars;
+    UDSRDBIPlanChunk_t *chunks;
+    uint16_t max_chunks;
+    uint16_t num_chunks;
+    uint8_t *req_buf; // request bytes of all chunks
+    size_t req_buf_size;
+
+    UDSRDBIPlanCb_t cb; // called once all chunks of a read have completed, may be NULL
+    void *cb_data;      // user-specified callback data
+    uint16_t pending;   // chunks of the current read not yet completed
+    UDSErr_t err;       // first error of the current read
+} UDSRDBIPlan_t;
+
+/**
+ * @brief request buffer size that is always sufficient for a plan of n variables
+ */
+#define UDS_RDBI_PLAN_REQ_BUF_SIZE(n) (3 * (n))
+
 UDSErr_t UDSClientInit(UDSClient_t *client);
 UDSErr_t UDSClientPoll(UDSClient_t *client);
+#if UDS_SYS == UDS_SYS_UNIX
+/**
+ * @brief Block until the client has work to do: a frame arrives, the P2/P2* timer or an ISO-TP
+ * timer expires, or timeout_ms elapses. Call UDSClientPoll() after it returns.
+ * @param timeout_ms upper bound on the wait, -1 for none
+ * @return UDS_OK when woken, UDS_ERR_TPORT if poll() fails
+ */
+UDSErr_t UDSClientWait(UDSClient_t *client, int timeout_ms);
+#endif
+
+/**
+ * @brief Get the time by which UDSClientPoll() must be called again so that P2/P2* timeouts,
+ * ResponsePending extensions and transport timers are handled on time. Together with
+ * UDSTpGetFds() this lets an external event loop drive the client.
+ * @param deadline set to the deadline in UDSMillis() time if one is pending. It is due once
+ * UDSTimeAfter(UDSMillis(), deadline), i.e. 1 ms after it is reached, and may already be due.
+ * @return true if a deadline is pending
+ */
+bool UDSClientGetDeadline(const UDSClient_t *client, uint32_t *deadline);
+
+/**
+ * @brief Keep a non-default session alive with suppressed TesterPresent (3E 80) requests sent
+ * every s3_ms / 2 from UDSClientPoll(). The requests bypass the client state machine and the
+ * request queue. Every request sent by the client restarts the interval, so the keep-alive only
+ * goes out when the connection is otherwise quiet.
+ *
+ * Functional requests use their own link and send buffer and are sent even while a request is
+ * in flight, e.g. while the server answers 0x78 for a long routine. Physical requests are sent
+ * only while the client is idle; a tick that falls while a request is in flight is skipped.
+ *
+ * @param s3_ms the server's S3 timeout, 0 to stop the keep-alive
+ * @param functional send on the functional address instead of the physical one
+ */
+UDSErr_t UDSClientSetKeepAlive(UDSClient_t *client, uint32_t s3_ms, bool functional);
+
+#if UDS_SYS == UDS_SYS_UNIX && defined(__linux__)
+/**
+ * @brief Get a timerfd that becomes readable when the client deadline is due, see
+ * UDSClientGetDeadline(). It is opened on the first call and re-armed by every request and
+ * UDSClientPoll(); add it to an epoll or poll set next to the transport's fds and call
+ * UDSClientPoll() when either becomes readable. Reading the fd is not necessary.
+ * @return the fd, or -1 if timerfd_create() fails
+ */
+int UDSClientTimerFd(UDSClient_t *client);
+
+/**
+ * @brief Close the fd returned by UDSClientTimerFd()
+ */
+void UDSClientCloseTimerFd(UDSClient_t *client);
+#endif
+
+/**
+ * @brief Append a request to the client queue. Queued requests are sent one after another from
+ * UDSClientPoll(): the next one goes out in the same poll that completes the previous one, and
+ * `req->cb` reports each completion. The client's `fn` still receives the usual events.
+ * @return UDS_OK, or UDS_ERR_INVALID_ARG if `req` has no data
+ * @note don't mix with the UDSSend*() functions while the queue is not empty, they return
+ * UDS_ERR_BUSY
+ */
+UDSErr_t UDSClientEnqueue(UDSClient_t *client, UDSClientReq_t *req);
+
+/**
+ * @brief Number of queued requests, including the one in flight
+ */
+size_t UDSClientPending(const UDSClient_t *client);
+
+#ifndef UDS_CLIENT_GROUP_MAX
+#define UDS_CLIENT_GROUP_MAX 16
+#endif
+
+/**
+ * @brief Several clients, one per ECU, driven together. Each client has its own transport and
+ * queue, so requests to different ECUs are in flight at the same time.
+ */
+typedef struct {
+    UDSClient_t *clients[UDS_CLIENT_GROUP_MAX];
+    uint8_t num_clients;
+} UDSClientGroup_t;
+
+UDSErr_t UDSClientGroupInit(UDSClientGroup_t *group);
+
+/**
+ * @brief Add an initialized client with its transport to the group
+ * @return the ECU index used with UDSClientGroupEnqueue(), or -1 if the group is full
+ */
+int UDSClientGroupAdd(UDSClientGroup_t *group, UDSClient_t *client);
+
+/**
+ * @brief UDSClientEnqueue() on the client with index `ecu`
+ */
+UDSErr_t UDSClientGroupEnqueue(UDSClientGroup_t *group, int ecu, UDSClientReq_t *req);
+
+/**
+ * @brief UDSClientPoll() every client in the group
+ * @return UDS_OK, or the first error returned by a client's poll
+ */
+UDSErr_t UDSClientGroupPoll(UDSClientGroup_t *group);
+
+/**
+ * @brief Number of queued requests over all clients, including those in flight
+ */
+size_t UDSClientGroupPending(const UDSClientGroup_t *group);
+
+#if UDS_SYS == UDS_SYS_UNIX
+/**
+ * @brief UDSClientWait() for the whole group: sleep until a frame arrives for any client, the
+ * earliest client deadline passes, or timeout_ms elapses. Call UDSClientGroupPoll() afterwards.
+ */
+UDSErr_t UDSClientGroupWait(UDSClientGroup_t *group, int timeout_ms);
+#endif
+
+/**
+ * @brief Send `data` as a request. This and the other UDSSend* functions return UDS_OK once
+ * the request is under way; its outcome is then reported through events. Any other return
+ * value means the request was not started and the client is idle again.
+ */
 UDSErr_t UDSSendBytes(UDSClient_t *client, const uint8_t *data, uint16_t size);
+
+UDSErr_t UDSBroadcastInit(UDSBroadcast_t *bc, UDSBroadcastResp_t *resp, uint16_t max_resp,
+                          uint8_t *buf, size_t buf_size);
+
+/**
+ * @brief Send `data` as one functional request and collect every response into `bc`
+ * @details Responses are gathered until P2 expires, extended to P2* when a responder answers
+ * NRC 0x78, and until every multi-frame response in progress has completed or timed out. The
+ * client then emits UDS_EVT_ResponseReceived with `bc` as the argument. A responder that answers
+ * more than once keeps its last response.
+ * @note `data` must fit into a single frame. Transports without set_collect() only deliver the
+ * response of their physical peer.
+ */
+UDSErr_t UDSSendBroadcast(UDSClient_t *client, UDSBroadcast_t *bc, const uint8_t *data,
+                          uint16_t size);
+
+/**
+ * @brief Look up the response of responder `sa`, NULL if it did not answer
+ */
+const UDSBroadcastResp_t *UDSBroadcastFind(const UDSBroadcast_t *bc, uint32_t sa);
 UDSErr_t UDSSendECUReset(UDSClient_t *client, UDSECUReset_t type);
 UDSErr_t UDSSendDiagSessCtrl(UDSClient_t *client, enum UDSDiagnosticSessionType mode);
 UDSErr_t UDSSendSecurityAccess(UDSClient_t *client, uint8_t level, uint8_t *data, uint16_t size);
@@ -757,6 +1188,10 @@ UDSErr_t UDSSendRequestUpload(UDSClient_t *client, uint8_t dataFormatIdentifier,
                               size_t memorySize);
 UDSErr_t UDSSendTransferData(UDSClient_t *client, uint8_t blockSequenceCounter,
                              const uint16_t blockLength, const uint8_t *data, uint16_t size);
+/**
+ * @brief Send one TransferData request with the next blockLength - 2 bytes of fd. The block is
+ * read with fread() just before sending; UDSConfigDownload() overlaps reading with the bus.
+ */
 UDSErr_t UDSSendTransferDataStream(UDSClient_t *client, uint8_t blockSequenceCounter,
                                    const uint16_t blockLength, FILE *fd);
 UDSErr_t UDSSendRequestTransferExit(UDSClient_t *client);
@@ -769,6 +1204,36 @@ UDSErr_t UDSSendRequestFileTransfer(UDSClient_t *client, enum FileOperationMode
 UDSErr_t UDSCtrlDTCSetting(UDSClient_t *client, uint8_t dtcSettingType,
                            uint8_t *dtcSettingControlOptionRecord, uint16_t len);
 UDSErr_t UDSUnpackRDBIResponse(UDSClient_t *client, UDSRDBIVar_t *vars, uint16_t numVars);
+
+/**
+ * @brief Compile a DID set into a read plan. The variables are checked once (type and length
+ * agree) and split in order into ReadDataByIdentifier requests such that each
+ * request and its positive response fit into mtu bytes. The response offset of every data record
+ * is fixed here, so decoding a sample is a DID check and a copy per variable.
+ *
+ * @param plan
+ * @param vars variables in request order, must stay valid while the plan is in use
+ * @param num_vars
+ * @param chunks storage for the requests
+ * @param max_chunks
+ * @param req_buf storage for the request bytes, UDS_RDBI_PLAN_REQ_BUF_SIZE(num_vars) is enough
+ * @param req_buf_size
+ * @param mtu largest request and response, 0 for UDS_TP_MTU
+ * @return UDS_OK, UDS_ERR_INVALID_ARG for an invalid variable, or UDS_ERR_BUFSIZ when the storage
+ * is too small or a single data record does not fit into mtu
+ */
+UDSErr_t UDSRDBIPlanCompile(UDSRDBIPlan_t *plan, UDSRDBIPlanVar_t *vars, uint16_t num_vars,
+                            UDSRDBIPlanChunk_t *chunks, uint16_t max_chunks, uint8_t *req_buf,
+                            size_t req_buf_size, uint16_t mtu);
+
+/**
+ * @brief Read all variables of a plan. The requests are put on the client queue back to back and
+ * each response is decoded into the variables as it arrives; plan->cb runs after the last one.
+ * Variables of a request that failed keep their previous value.
+ *
+ * @return UDS_OK if the requests were queued, UDS_ERR_BUSY if the previous read is still pending
+ */
+UDSErr_t UDSRDBIPlanRead(UDSClient_t *client, UDSRDBIPlan_t *plan);
 UDSErr_t UDSUnpackSecurityAccessResponse(const UDSClient_t *client,
                                          struct SecurityAccessResponse *resp);
 UDSErr_t UDSUnpackRequestDownloadResponse(const UDSClient_t *client,
@@ -776,10 +1241,37 @@ UDSErr_t UDSUnpackRequestDownloadResponse(const UDSClient_t *client,
 UDSErr_t UDSUnpackRoutineControlResponse(const UDSClient_t *client,
                                          struct RoutineControlResponse *resp);
 
+/**
+ * @brief Download memorySize bytes of fd, starting at its current position, with
+ * RequestDownload, TransferData and RequestTransferExit. The sequence is driven by
+ * UDSClientPoll(): UDS_EVT_DownloadProgress is emitted after every acknowledged block and
+ * UDS_EVT_DownloadComplete once the sequence ends, successfully or not. Do not send other
+ * requests on this client until then.
+ *
+ * The block length is the server's maxNumberOfBlockLength, limited to the transport send buffer.
+ * The next block is copied into the send buffer while the previous one is awaiting its
+ * response. On UNIX, regular files are mmap()ed so that staging a block is a memcpy() from the
+ * page cache, with read-ahead hinted by madvise(); other files are read with fread(). The file
+ * position is left after the last byte sent.
+ *
+ * @param client
+ * @param dataFormatIdentifier
+ * @param addressAndLengthFormatIdentifier
+ * @param memoryAddress
+ * @param memorySize
+ * @param fd image, positioned at the first byte to download
+ * @return UDS_OK if the RequestDownload was sent
+ */
 UDSErr_t UDSConfigDownload(UDSClient_t *client, uint8_t dataFormatIdentifier,
                            uint8_t addressAndLengthFormatIdentifier, size_t memoryAddress,
                            size_t memorySize, FILE *fd);
 
+/**
+ * @brief Abort a download started with UDSConfigDownload(). The request in flight is dropped and
+ * UDS_EVT_DownloadComplete is emitted with err UDS_FAIL.
+ */
+void UDSDownloadAbort(UDSClient_t *client);
+
 
 #pragma once
 
@@ -967,6 +1459,224 @@ typedef struct {
 
 UDSErr_t UDSServerInit(UDSServer_t *srv);
 void UDSServerPoll(UDSServer_t *srv);
+#if UDS_SYS == UDS_SYS_UNIX
+/**
+ * @brief Block until the server has work to do: a frame arrives, the S3, P2/P2* or ECU reset
+ * timer expires, an ISO-TP timer expires, or timeout_ms elapses. Call UDSServerPoll() after it
+ * returns.
+ * @param timeout_ms upper bound on the wait, -1 for none
+ * @return UDS_OK when woken, UDS_ERR_TPORT if poll() fails
+ */
+UDSErr_t UDSServerWait(UDSServer_t *srv, int timeout_ms);
+#endif
+
+#if UDS_SYS == UDS_SYS_UNIX
+#include <pthread.h>
+
+#ifndef UDS_JOB_MAX_WORKERS
+#define UDS_JOB_MAX_WORKERS 8
+#endif
+
+#ifndef UDS_JOB_RECORD_MAX
+#define UDS_JOB_RECORD_MAX 64 // routineControlOptionRecord / routineStatusRecord bytes
+#endif
+
+typedef enum {
+    UDS_JOB_IDLE = 0, // never started
+    UDS_JOB_QUEUED,   // waiting for a worker
+    UDS_JOB_RUNNING,
+    UDS_JOB_DONE, // finished and taken off the completion queue
+} UDSJobState_t;
+
+/**
+ * @brief One run of a routine. The job function reads `option` and writes `status` and returns
+ * the response code of the routine.
+ */
+typedef struct UDSJob {
+    struct UDSJobRoutine *routine;
+    uint8_t option[UDS_JOB_RECORD_MAX]; // routineControlOptionRecord of the start request
+    uint16_t option_len;
+    uint8_t status[UDS_JOB_RECORD_MAX]; // routineStatusRecord returned by stop and results
+    uint16_t status_len;
+    uint8_t nrc;     // result of the job function, UDS_PositiveResponse on success
+    int state;       // UDSJobState_t, private
+    int cancel;      // private, see UDSJobCancelled()
+    bool waiting;    // private: a request is answered with 0x78 until the job is done
+    struct UDSJob *next; // private
+} UDSJob_t;
+
+/**
+ * @brief Job function, runs on a worker thread
+ * @return UDS_PositiveResponse or the NRC to answer the waiting request with
+ */
+typedef uint8_t (*UDSJobFn_t)(UDSJob_t *job);
+
+/**
+ * @brief A routine served by the job engine. Each routine runs at most one job at a time.
+ */
+typedef struct UDSJobRoutine {
+    uint16_t rid;  // routineIdentifier
+    UDSJobFn_t fn;
+    bool wait;     // start is answered once the job has finished, otherwise as soon as it is queued
+    void *data;    // user data for fn
+    UDSJob_t job;  // private
+} UDSJobRoutine_t;
+
+/**
+ * @brief Runs RoutineControl jobs on a worker pool so that the thread calling UDSServerPoll()
+ * never blocks on them. Finished jobs are passed back through a completion queue that the poll
+ * thread drains.
+ */
+typedef struct {
+    UDSJobRoutine_t *routines;
+    uint16_t num_routines;
+    pthread_t workers[UDS_JOB_MAX_WORKERS];
+    int num_workers;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    UDSJob_t *queue_head; // submitted jobs
+    UDSJob_t *queue_tail;
+    UDSJob_t *done_head;  // completion queue
+    bool stop;
+} UDSJobEngine_t;
+
+/**
+ * @brief Start num_workers threads serving the given routines
+ */
+UDSErr_t UDSJobEngineInit(UDSJobEngine_t *engine, UDSJobRoutine_t *routines,
+                          uint16_t num_routines, int num_workers);
+
+/**
+ * @brief Cancel all jobs, wait for running ones to return and stop the workers
+ */
+void UDSJobEngineDeinit(UDSJobEngine_t *engine);
+
+/**
+ * @brief Drain the completion queue. Called by UDSJobEngineRoutineCtrl(); call it from the poll
+ * loop as well to see jobs of routines that do not wait finish.
+ * @return number of jobs that finished
+ */
+int UDSJobEnginePoll(UDSJobEngine_t *engine);
+
+/**
+ * @brief Serve UDS_EVT_RoutineCtrl from the job engine. Call it from the server event handler and
+ * return its result; routines the engine does not know yield UDS_NRC_RequestOutOfRange.
+ *
+ * - start: queues a job. Routines with `wait` answer 0x78 until the job has finished and then
+ *   respond with its result and status record, the others respond at once. A start while the job
+ *   is still active is refused with UDS_NRC_ConditionsNotCorrect.
+ * - stop: cancels the active job and answers 0x78 until it has returned.
+ * - results: answers 0x78 while the job is active, then with its result and status record.
+ *
+ * While a request waits, UDSServerPoll() re-evaluates it and sends 0x78 every 0.3 * p2*.
+ */
+uint8_t UDSJobEngineRoutineCtrl(UDSJobEngine_t *engine, UDSServer_t *srv,
+                                UDSRoutineCtrlArgs_t *args);
+
+/**
+ * @brief Queue a job of routine rid outside of RoutineControl, e.g. from a coroutine handler
+ * @return UDS_OK, UDS_ERR_INVALID_ARG for an unknown rid or an option record that is too long,
+ * UDS_ERR_BUSY while the routine's job is still active
+ */
+UDSErr_t UDSJobEngineStart(UDSJobEngine_t *engine, uint16_t rid, const uint8_t *option,
+                           uint16_t option_len, UDSJob_t **job);
+
+/**
+ * @brief true once the job has been asked to stop; long job functions should check it
+ */
+bool UDSJobCancelled(const UDSJob_t *job);
+
+#include <ucontext.h>
+
+#ifndef UDS_CO_STACK_MIN
+#define UDS_CO_STACK_MIN 16384
+#endif
+
+typedef enum {
+    UDS_CO_IDLE = 0,
+    UDS_CO_RUNNING,
+    UDS_CO_SUSPENDED,
+} UDSCoState_t;
+
+struct UDSCo;
+
+/**
+ * @brief Coroutine handler. Runs on the coroutine's own stack and may suspend with the
+ * UDSCoSleep(), UDSCoWaitFd(), UDSCoWaitJob() and UDSCoYield() calls.
+ * @return the response code, as for a regular event handler
+ */
+typedef uint8_t (*UDSCoFn_t)(struct UDSCo *co, UDSServer_t *srv, UDSEvent_t evt, void *arg);
+
+/**
+ * @brief A stackful coroutine serving one request at a time. While the handler is suspended the
+ * server answers the request with 0x78 and re-evaluates it on every UDSServerPoll(); the handler
+ * resumes in the first poll after its wait condition is met, so waits are resolved with a
+ * granularity of about p2 (see UDSServerWait()).
+ */
+typedef struct UDSCo {
+    ucontext_t ctx;    // private
+    ucontext_t caller; // private
+    void *stack;
+    size_t stack_size;
+    int state; // UDSCoState_t
+    UDSCoFn_t fn;
+    UDSServer_t *srv;
+    UDSEvent_t evt;
+    void *arg; // event argument of the current evaluation of the request
+    uint8_t result;
+    int wait;          // private: what the handler is suspended on
+    bool has_deadline; // private
+    uint32_t deadline; // private
+    int fd;            // private
+    short events;      // private
+    short revents;     // poll() events of the fd after UDSCoWaitFd() returns, 0 on timeout
+    UDSJobEngine_t *engine; // private
+    UDSJob_t *job;          // private
+    void *data; // user data
+} UDSCo_t;
+
+/**
+ * @brief Initialize a coroutine on a caller-provided stack of at least UDS_CO_STACK_MIN bytes
+ */
+UDSErr_t UDSCoInit(UDSCo_t *co, void *stack, size_t stack_size);
+
+/**
+ * @brief Serve an event from a coroutine handler. Call it from the server event handler for the
+ * events that may suspend and return its result. A new request starts fn; while it is suspended
+ * the result is 0x78, and re-evaluations of the same request resume it once its wait condition is
+ * met. If the server has dropped the request in the meantime, the suspended handler is abandoned
+ * without returning: it must not hold resources across a wait that only it would release.
+ */
+uint8_t UDSCoDispatch(UDSCo_t *co, UDSServer_t *srv, UDSEvent_t evt, void *arg, UDSCoFn_t fn);
+
+/*
+ * The wait functions may only be called from a coroutine handler. The event argument of a request
+ * is rebuilt on every evaluation, so each returns the current one: use it, not the argument fn
+ * was called with, after a wait.
+ */
+
+/**
+ * @brief Suspend for at least ms milliseconds
+ */
+void *UDSCoSleep(UDSCo_t *co, uint32_t ms);
+
+/**
+ * @brief Suspend until fd reports one of events, or timeout_ms elapses (-1 for none). The
+ * reported events are in co->revents.
+ */
+void *UDSCoWaitFd(UDSCo_t *co, int fd, short events, int timeout_ms);
+
+/**
+ * @brief Suspend until a job of the job engine is done. Its result is in job->nrc and
+ * job->status.
+ */
+void *UDSCoWaitJob(UDSCo_t *co, UDSJobEngine_t *engine, UDSJob_t *job);
+
+/**
+ * @brief Suspend until the next evaluation of the request
+ */
+void *UDSCoYield(UDSCo_t *co);
+#endif
 
 #if defined(UDS_TP_ISOTP_C)
 #define ISO_TP_USER_SEND_CAN_ARG 1
@@ -1360,6 +2070,16 @@ void isotp_init_link(IsoTpLink *link, uint32_t sendid,
  */
 void isotp_poll(IsoTpLink *link);
 
+/**
+ * @brief Time until isotp_poll must be called again to send the next consecutive frame or to
+ * detect an N_Bs/N_Cr timeout.
+ *
+ * @param link The @code IsoTpLink @endcode instance used.
+ * @param timeout_us Set to the remaining time in microseconds (0 if already due).
+ * @return 1 if a send or receive is in progress, 0 otherwise.
+ */
+int isotp_get_timeout_us(IsoTpLink *link, uint32_t *timeout_us);
+
 /**
  * @brief Handles incoming CAN messages.
  * Determines whether an incoming message is a valid ISO-TP frame or not and handles it accordingly.
@@ -1429,6 +2149,7 @@ typedef struct {
     IsoTpLink func_link;
     uint8_t send_buf[UDS_ISOTP_MTU];
     uint8_t recv_buf[UDS_ISOTP_MTU];
+    uint8_t func_send_buf[8]; // functional requests are single frames
     uint32_t phys_sa, phys_ta;
     uint32_t func_sa, func_ta;
 } UDSISOTpC_t;
@@ -1454,23 +2175,60 @@ void UDSISOTpCDeinit(UDSISOTpC_t *tp);
 
 
 
+/**
+ * @brief Reassembly slot for the responses of one ECU to a functional request
+ */
+typedef struct {
+    IsoTpLink link;
+    uint32_t rx_id; // CAN ID the ECU responds on
+    bool in_use;
+    uint8_t recv_buf[UDS_ISOTP_MTU];
+} UDSTpISOTpCResponder_t;
+
 typedef struct {
     UDSTp_t hdl;
     IsoTpLink phys_link;
     IsoTpLink func_link;
     uint8_t send_buf[UDS_ISOTP_MTU];
     uint8_t recv_buf[UDS_ISOTP_MTU];
+    uint8_t func_send_buf[8]; // functional requests are single frames
     int fd;
     uint32_t phys_sa, phys_ta;
     uint32_t func_sa, func_ta;
     char tag[16];
+
+    // responders to functional requests, see UDSTpISOTpCSetResponders()
+    UDSTpISOTpCResponder_t *responders;
+    int num_responders;
+    uint32_t responder_first_id, responder_last_id;
+    uint32_t responder_fc_offset;
+    bool collecting;
+    UDSTpISOTpCResponder_t *recv_responder; // returned by the last peek
 } UDSTpISOTpC_t;
 
 UDSErr_t UDSTpISOTpCInit(UDSTpISOTpC_t *tp, const char *ifname, uint32_t source_addr,
                          uint32_t target_addr, uint32_t source_addr_func,
                          uint32_t target_addr_func);
+/**
+ * @brief Like UDSTpISOTpCInit() but on a CAN_RAW socket the caller has already opened and bound,
+ * e.g. with CAN_RAW_FILTER set so that only this transport's frames are delivered. The socket is
+ * switched to non-blocking mode and owned by the transport from then on.
+ * @return UDS_ERR_TPORT if fd is invalid
+ */
+UDSErr_t UDSTpISOTpCInitFd(UDSTpISOTpC_t *tp, int fd, uint32_t source_addr, uint32_t target_addr,
+                           uint32_t source_addr_func, uint32_t target_addr_func);
 void UDSTpISOTpCDeinit(UDSTpISOTpC_t *tp);
 
+/**
+ * @brief Give the transport `n` slots to reassemble responses to functional requests from other
+ * ECUs in parallel (see UDSSendBroadcast()). While collecting, a frame whose CAN ID lies in
+ * [first_id, last_id] is taken as a response from the ECU with physical request ID
+ * CAN ID - fc_offset. Flow control frames are sent to that ID, and it is reported as A_SA.
+ * @note ISO 15765-4 11-bit IDs: first_id 0x7E8, last_id 0x7EF, fc_offset 8
+ */
+void UDSTpISOTpCSetResponders(UDSTpISOTpC_t *tp, UDSTpISOTpCResponder_t *pool, int n,
+                              uint32_t first_id, uint32_t last_id, uint32_t fc_offset);
+
 #endif
 
 
@@ -0,0 +1,684 @@
+#ifndef ISO14229_HPP
+#define ISO14229_HPP
+
+/**
+ * @file iso14229.hpp
+ * @brief Header-only C++17 layer over UDSServer_t / UDSClient_t.
+ *
+ * - RAII transport, server and client handles
+ * - big-endian codecs for integers, enums, arrays and aggregates (uds::Codec, uds::Fields)
+ * - DIDs declared as a compile-time table (uds::Did, uds::DidTable) and dispatched through a
+ *   perfect hash computed by the compiler
+ * - services declared as a compile-time table (uds::On, uds::Services) and dispatched through an
+ *   array indexed by UDSEvent_t
+ *
+ * @code
+ * struct Gps { int32_t lat, lon; };
+ * template <> struct uds::Codec<Gps> : uds::Fields<&Gps::lat, &Gps::lon> {};
+ *
+ * static std::array<char, 17> vin() { return {'W', 'V', 'W', ...}; }
+ * static Gps gps() { return {sim.lat, sim.lon}; }
+ * static uint8_t set_gps(const Gps &g) { sim.set(g); return UDS_PositiveResponse; }
+ *
+ * using Dids = uds::DidTable<uds::Did<0xF190, std::array<char, 17>, vin>,
+ *                            uds::Did<0xD100, Gps, gps, set_gps>>;
+ * using Ecu = uds::Services<Dids::Rdbi, Dids::Wdbi, uds::On<UDS_EVT_DiagSessCtrl, session>>;
+ *
+ * uds::IsoTpC tp("vcan0", 0x7E8, 0x7E0, 0x7DF, 0);
+ * uds::Server<Ecu> srv(tp);
+ * for (;;) { srv.wait(-1); srv.poll(); }
+ * @endcode
+ */
+
+#include "iso14229.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+
+#if __cplusplus >= 202002L && __has_include(<span>)
+#include <span>
+#endif
+
+namespace uds {
+
+#if defined(__cpp_lib_span)
+template <class T> using span = std::span<T>;
+#else
+/**
+ * @brief Minimal stand-in for std::span before C++20
+ */
+template <class T> class span {
+  public:
+    constexpr span() noexcept = default;
+    constexpr span(T *data, std::size_t size) noexcept : data_(data), size_(size) {}
+    template <std::size_t N> constexpr span(T (&arr)[N]) noexcept : data_(arr), size_(N) {}
+    template <class U, std::size_t N,
+              class = std::enable_if_t<std::is_convertible_v<U (*)[], T (*)[]>>>
+    constexpr span(std::array<U, N> &arr) noexcept : data_(arr.data()), size_(N) {}
+    template <class U, std::size_t N,
+              class = std::enable_if_t<std::is_convertible_v<const U (*)[], T (*)[]>>>
+    constexpr span(const std::array<U, N> &arr) noexcept : data_(arr.data()), size_(N) {}
+    template <class U, class = std::enable_if_t<std::is_convertible_v<U (*)[], T (*)[]>>>
+    constexpr span(const span<U> &other) noexcept : data_(other.data()), size_(other.size()) {}
+
+    constexpr T *data() const noexcept { return data_; }
+    constexpr std::size_t size() const noexcept { return size_; }
+    constexpr bool empty() const noexcept { return 0 == size_; }
+    constexpr T &operator[](std::size_t i) const noexcept { return data_[i]; }
+    constexpr T *begin() const noexcept { return data_; }
+    constexpr T *end() const noexcept { return data_ + size_; }
+    constexpr span first(std::size_t n) const noexcept { return {data_, n}; }
+    constexpr span subspan(std::size_t off) const noexcept { return {data_ + off, size_ - off}; }
+
+  private:
+    T *data_ = nullptr;
+    std::size_t size_ = 0;
+};
+#endif
+
+// ---------------------------------------------------------------------------------------------
+// Codecs
+// ---------------------------------------------------------------------------------------------
+
+/**
+ * @brief Big-endian wire format of T: `size` bytes, `encode(uint8_t *, const T &)` and
+ * `T decode(const uint8_t *)`. Provided for integers, enums and std::array; specialize it for
+ * other types, usually by deriving from uds::Fields.
+ */
+template <class T, class = void> struct Codec;
+
+template <class T>
+struct Codec<T, std::enable_if_t<std::is_integral_v<T> || std::is_enum_v<T>>> {
+    using U = std::make_unsigned_t<typename std::conditional_t<
+        std::is_enum_v<T>, std::underlying_type<T>, std::common_type<T>>::type>;
+    static constexpr std::size_t size = sizeof(T);
+
+    static constexpr void encode(uint8_t *p, const T &v) {
+        Store(p, static_cast<U>(v), std::make_index_sequence<size>{});
+    }
+    static constexpr T decode(const uint8_t *p) {
+        return static_cast<T>(Load(p, std::make_index_sequence<size>{}));
+    }
+
+  private:
+    // unrolled byte shifts, which the compiler turns into a single load or store and a bswap
+    template <std::size_t... I>
+    static constexpr void Store(uint8_t *p, U u, std::index_sequence<I...>) {
+        ((p[I] = static_cast<uint8_t>(u >> (8 * (size - 1 - I)))), ...);
+    }
+    template <std::size_t... I> static constexpr U Load(const uint8_t *p, std::index_sequence<I...>) {
+        return static_cast<U>(((static_cast<U>(p[I]) << (8 * (size - 1 - I))) | ...));
+    }
+};
+
+template <> struct Codec<bool> {
+    static constexpr std::size_t size = 1;
+    static constexpr void encode(uint8_t *p, const bool &v) { p[0] = v ? 1 : 0; }
+    static constexpr bool decode(const uint8_t *p) { return p[0] != 0; }
+};
+
+template <class E, std::size_t N> struct Codec<std::array<E, N>> {
+    static constexpr std::size_t size = N * Codec<E>::size;
+    static constexpr void encode(uint8_t *p, const std::array<E, N> &v) {
+        for (std::size_t i = 0; i < N; i++) {
+            Codec<E>::encode(p + i * Codec<E>::size, v[i]);
+        }
+    }
+    static constexpr std::array<E, N> decode(const uint8_t *p) {
+        std::array<E, N> v{};
+        for (std::size_t i = 0; i < N; i++) {
+            v[i] = Codec<E>::decode(p + i * Codec<E>::size);
+        }
+        return v;
+    }
+};
+
+namespace detail {
+template <class M> struct Member;
+template <class C, class T> struct Member<T C::*> {
+    using Class = C;
+    using Type = T;
+};
+
+template <auto M> using MemberClass = typename Member<decltype(M)>::Class;
+template <auto M> using MemberType = typename Member<decltype(M)>::Type;
+
+template <auto M, auto... Ms> struct First {
+    using Class = MemberClass<M>;
+};
+} // namespace detail
+
+/**
+ * @brief Codec of an aggregate: its members in the given order, packed without padding
+ */
+template <auto... Members> struct Fields {
+    using T = typename detail::First<Members...>::Class;
+    static_assert((std::is_same_v<T, detail::MemberClass<Members>> && ...),
+                  "all members must belong to the same type");
+    static constexpr std::size_t size = (Codec<detail::MemberType<Members>>::size + ...);
+
+    static constexpr void encode(uint8_t *p, const T &v) {
+        std::size_t off = 0;
+        ((Codec<detail::MemberType<Members>>::encode(p + off, v.*Members),
+          off += Codec<detail::MemberType<Members>>::size),
+         ...);
+    }
+    static constexpr T decode(const uint8_t *p) {
+        T v{};
+        std::size_t off = 0;
+        ((v.*Members = Codec<detail::MemberType<Members>>::decode(p + off),
+          off += Codec<detail::MemberType<Members>>::size),
+         ...);
+        return v;
+    }
+};
+
+// ---------------------------------------------------------------------------------------------
+// Perfect hashing
+// ---------------------------------------------------------------------------------------------
+
+/**
+ * @brief Multiplicative hash `(key * mul) >> shift` that maps a fixed key set into a table of
+ * 2^bits slots without collisions
+ */
+struct PerfectHash {
+    uint32_t mul = 0;
+    uint8_t bits = 0;
+    bool ok = false;
+
+    constexpr std::size_t slots() const { return std::size_t{1} << bits; }
+    constexpr std::size_t operator()(uint16_t key) const {
+        return 0 == bits ? 0 : static_cast<uint32_t>(key * mul) >> (32 - bits);
+    }
+};
+
+namespace detail {
+template <std::size_t N> constexpr bool Unique(const std::array<uint16_t, N> &keys) {
+    for (std::size_t i = 0; i < N; i++) {
+        for (std::size_t j = i + 1; j < N; j++) {
+            if (keys[i] == keys[j]) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+template <std::size_t N>
+constexpr bool Collides(const std::array<uint16_t, N> &keys, const PerfectHash &h) {
+    for (std::size_t i = 0; i < N; i++) {
+        for (std::size_t j = i + 1; j < N; j++) {
+            if (h(keys[i]) == h(keys[j])) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+} // namespace detail
+
+/**
+ * @brief Search a perfect hash for keys at compile time, starting from the smallest table that
+ * holds them and doubling it up to three times. `ok` is false if none was found.
+ */
+template <std::size_t N> constexpr PerfectHash MakePerfectHash(const std::array<uint16_t, N> &keys) {
+    uint8_t bits = 0;
+    while ((std::size_t{1} << bits) < N) {
+        bits++;
+    }
+    for (uint8_t extra = 0; extra <= 3; extra++) {
+        for (uint32_t k = 0; k < 2048; k++) {
+            PerfectHash h;
+            h.mul = 0x9E3779B1u + 2 * k; // odd multipliers around the golden ratio
+            h.bits = static_cast<uint8_t>(bits + extra);
+            if (!detail::Collides(keys, h)) {
+                h.ok = true;
+                return h;
+            }
+        }
+    }
+    return PerfectHash{};
+}
+
+// ---------------------------------------------------------------------------------------------
+// Events
+// ---------------------------------------------------------------------------------------------
+
+/**
+ * @brief Argument type of a server event
+ */
+template <UDSEvent_t E> struct EventArgs { using Type = void; };
+#define UDS_HPP_EVENT_ARGS(evt, type)                                                              \
+    template <> struct EventArgs<evt> { using Type = type; };
+UDS_HPP_EVENT_ARGS(UDS_EVT_Err, UDSErr_t)
+UDS_HPP_EVENT_ARGS(UDS_EVT_DiagSessCtrl, UDSDiagSessCtrlArgs_t)
+UDS_HPP_EVENT_ARGS(UDS_EVT_EcuReset, UDSECUResetArgs_t)
+UDS_HPP_EVENT_ARGS(UDS_EVT_ReadDataByIdent, UDSRDBIArgs_t)
+UDS_HPP_EVENT_ARGS(UDS_EVT_ReadMemByAddr, UDSReadMemByAddrArgs_t)
+UDS_HPP_EVENT_ARGS(UDS_EVT_CommCtrl, UDSCommCtrlArgs_t)
+UDS_HPP_EVENT_ARGS(UDS_EVT_SecAccessRequestSeed, UDSSecAccessRequestSeedArgs_t)
+UDS_HPP_EVENT_ARGS(UDS_EVT_SecAccessValidateKey, UDSSecAccessValidateKeyArgs_t)
+UDS_HPP_EVENT_ARGS(UDS_EVT_WriteDataByIdent, UDSWDBIArgs_t)
+UDS_HPP_EVENT_ARGS(UDS_EVT_RoutineCtrl, UDSRoutineCtrlArgs_t)
+UDS_HPP_EVENT_ARGS(UDS_EVT_RequestDownload, UDSRequestDownloadArgs_t)
+UDS_HPP_EVENT_ARGS(UDS_EVT_RequestUpload, UDSRequestUploadArgs_t)
+UDS_HPP_EVENT_ARGS(UDS_EVT_TransferData, UDSTransferDataArgs_t)
+UDS_HPP_EVENT_ARGS(UDS_EVT_RequestTransferExit, UDSRequestTransferExitArgs_t)
+UDS_HPP_EVENT_ARGS(UDS_EVT_DoScheduledReset, uint8_t) // enum UDSEcuResetType
+UDS_HPP_EVENT_ARGS(UDS_EVT_RequestFileTransfer, UDSRequestFileTransferArgs_t)
+UDS_HPP_EVENT_ARGS(UDS_EVT_CUSTOM, UDSCustomArgs_t)
+#undef UDS_HPP_EVENT_ARGS
+
+/**
+ * @brief Handler of server event E. Fn is `uint8_t (UDSServer_t *, Args *)` with the argument
+ * type of E, or `uint8_t (UDSServer_t *)` for events without an argument.
+ */
+template <UDSEvent_t E, auto Fn> struct On {
+    static constexpr UDSEvent_t event = E;
+    static int call(UDSServer_t *srv, void *arg) {
+        using Args = typename EventArgs<E>::Type;
+        if constexpr (std::is_void_v<Args>) {
+            return Fn(srv);
+        } else {
+            return Fn(srv, static_cast<Args *>(arg));
+        }
+    }
+};
+
+// ---------------------------------------------------------------------------------------------
+// DID table
+// ---------------------------------------------------------------------------------------------
+
+namespace detail {
+template <class T, auto Fn> constexpr uint8_t CallRead(UDSServer_t *srv, T &out) {
+    if constexpr (std::is_invocable_v<decltype(Fn), UDSServer_t *>) {
+        out = Fn(srv);
+    } else {
+        out = Fn();
+    }
+    return UDS_PositiveResponse;
+}
+
+template <class T, auto Fn> constexpr uint8_t CallWrite(UDSServer_t *srv, const T &v) {
+    if constexpr (std::is_invocable_v<decltype(Fn), UDSServer_t *, const T &>) {
+        return Fn(srv, v);
+    } else {
+        return Fn(v);
+    }
+}
+} // namespace detail
+
+/**
+ * @brief A data identifier of type T, encoded with uds::Codec<T>.
+ * @tparam Read `T ()` or `T (UDSServer_t *)`, nullptr for a write-only DID
+ * @tparam Write `uint8_t (const T &)` or `uint8_t (UDSServer_t *, const T &)` returning
+ * UDS_PositiveResponse or an NRC, nullptr (the default) for a read-only DID
+ */
+template <uint16_t Id, class T, auto Read, auto Write = nullptr> struct Did {
+    using Type = T;
+    static constexpr uint16_t id = Id;
+    static constexpr std::size_t size = Codec<T>::size;
+    static constexpr bool readable = !std::is_null_pointer_v<decltype(Read)>;
+    static constexpr bool writable = !std::is_null_pointer_v<decltype(Write)>;
+
+    static uint8_t read(UDSServer_t *srv, UDSRDBIArgs_t *args) {
+        if constexpr (!readable) {
+            return UDS_NRC_RequestOutOfRange;
+        } else {
+            T v{};
+            uint8_t nrc = detail::CallRead<T, Read>(srv, v);
+            if (UDS_PositiveResponse != nrc) {
+                return nrc;
+            }
+            uint8_t buf[size];
+            Codec<T>::encode(buf, v);
+            return args->copy(srv, buf, static_cast<uint16_t>(size));
+        }
+    }
+
+    static uint8_t write(UDSServer_t *srv, UDSWDBIArgs_t *args) {
+        if constexpr (!writable) {
+            return UDS_NRC_RequestOutOfRange;
+        } else {
+            if (args->len != size) {
+                return UDS_NRC_IncorrectMessageLengthOrInvalidFormat;
+            }
+            return detail::CallWrite<T, Write>(srv, Codec<T>::decode(args->data));
+        }
+    }
+};
+
+/**
+ * @brief Serves UDS_EVT_ReadDataByIdent and UDS_EVT_WriteDataByIdent for a fixed set of DIDs.
+ * A DID is looked up with one hash, one compare and one indirect call into the DID's own
+ * encoder; unknown DIDs and DIDs without the requested direction yield
+ * UDS_NRC_RequestOutOfRange.
+ */
+template <class... Dids> class DidTable {
+  public:
+    static constexpr std::size_t count = sizeof...(Dids);
+    static_assert(count > 0, "empty DID table");
+
+    static uint8_t read(UDSServer_t *srv, UDSRDBIArgs_t *args) {
+        const Slot &s = slots[hash(args->dataId)];
+        if (s.id != args->dataId || nullptr == s.read) {
+            return UDS_NRC_RequestOutOfRange;
+        }
+        return s.read(srv, args);
+    }
+
+    static uint8_t write(UDSServer_t *srv, UDSWDBIArgs_t *args) {
+        const Slot &s = slots[hash(args->dataId)];
+        if (s.id != args->dataId || nullptr == s.write) {
+            return UDS_NRC_RequestOutOfRange;
+        }
+        return s.write(srv, args);
+    }
+
+    static constexpr bool contains(uint16_t id) {
+        const Slot &s = slots[hash(id)];
+        return s.id == id && (s.read || s.write);
+    }
+
+  private:
+    using ReadFn = uint8_t (*)(UDSServer_t *, UDSRDBIArgs_t *);
+    using WriteFn = uint8_t (*)(UDSServer_t *, UDSWDBIArgs_t *);
+    struct Slot {
+        uint16_t id = 0;
+        ReadFn read = nullptr; // both NULL for an empty slot
+        WriteFn write = nullptr;
+    };
+
+    static constexpr std::array<uint16_t, count> ids = {Dids::id...};
+    static_assert(detail::Unique(ids), "duplicate DID in DID table");
+    static constexpr PerfectHash hash = MakePerfectHash(ids);
+    static_assert(hash.ok, "no perfect hash found for this DID set");
+
+    static constexpr std::array<Slot, hash.slots()> MakeSlots() {
+        std::array<Slot, hash.slots()> t{};
+        ((t[hash(Dids::id)] = Slot{Dids::id, Dids::readable ? &Dids::read : nullptr,
+                                   Dids::writable ? &Dids::write : nullptr}),
+         ...);
+        return t;
+    }
+    static constexpr std::array<Slot, hash.slots()> slots = MakeSlots();
+
+  public:
+    using Rdbi = On<UDS_EVT_ReadDataByIdent, &DidTable::read>;
+    using Wdbi = On<UDS_EVT_WriteDataByIdent, &DidTable::write>;
+};
+
+// ---------------------------------------------------------------------------------------------
+// Service table
+// ---------------------------------------------------------------------------------------------
+
+/**
+ * @brief The server callback for a fixed set of handlers. Events are dispatched through an array
+ * indexed by UDSEvent_t, as a switch would; events without a handler answer
+ * UDS_NRC_ServiceNotSupported.
+ */
+template <class... Handlers> class Services {
+  public:
+    static int fn(UDSServer_t *srv, UDSEvent_t evt, void *arg) {
+        if (static_cast<unsigned>(evt) >= UDS_EVT_MAX) {
+            return UDS_NRC_ServiceNotSupported;
+        }
+        return table[evt](srv, arg);
+    }
+
+  private:
+    using Fn = int (*)(UDSServer_t *, void *);
+    static int Unhandled(UDSServer_t *, void *) { return UDS_NRC_ServiceNotSupported; }
+
+    static constexpr std::array<UDSEvent_t, sizeof...(Handlers)> events = {Handlers::event...};
+    static constexpr bool Unique() {
+        for (std::size_t i = 0; i < events.size(); i++) {
+            for (std::size_t j = i + 1; j < events.size(); j++) {
+                if (events[i] == events[j]) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+    static_assert(Unique(), "more than one handler for an event");
+
+    static constexpr std::array<Fn, UDS_EVT_MAX> MakeTable() {
+        std::array<Fn, UDS_EVT_MAX> t{};
+        for (auto &f : t) {
+            f = &Unhandled;
+        }
+        ((t[Handlers::event] = &Handlers::call), ...);
+        return t;
+    }
+    static constexpr std::array<Fn, UDS_EVT_MAX> table = MakeTable();
+};
+
+// ---------------------------------------------------------------------------------------------
+// RAII handles
+// ---------------------------------------------------------------------------------------------
+
+#if defined(UDS_TP_ISOTP_C_SOCKETCAN)
+/**
+ * @brief isotp-c transport on a CAN_RAW socket, see UDSTpISOTpCInit(). Check error() after
+ * construction.
+ */
+class IsoTpC {
+  public:
+    IsoTpC(const char *ifname, uint32_t source_addr, uint32_t target_addr,
+           uint32_t source_addr_func, uint32_t target_addr_func)
+        : err_(UDSTpISOTpCInit(&tp_, ifname, source_addr, target_addr, source_addr_func,
+                               target_addr_func)) {}
+    ~IsoTpC() {
+        if (UDS_OK == err_) {
+            UDSTpISOTpCDeinit(&tp_);
+        }
+    }
+    IsoTpC(const IsoTpC &) = delete;
+    IsoTpC &operator=(const IsoTpC &) = delete;
+
+    UDSErr_t error() const { return err_; }
+    UDSTp_t *get() { return &tp_.hdl; }
+    operator UDSTp_t *() { return &tp_.hdl; }
+    UDSTpISOTpC_t &native() { return tp_; }
+
+  private:
+    UDSTpISOTpC_t tp_{};
+    UDSErr_t err_;
+};
+#endif
+
+#if defined(UDS_TP_ISOTP_SOCK)
+/**
+ * @brief Linux kernel ISO-TP transport, see UDSTpIsoTpSockInitServer() and
+ * UDSTpIsoTpSockInitClient(). Check error() after construction.
+ */
+class IsoTpSock {
+  public:
+    struct ServerTag {};
+    struct ClientTag {};
+
+    IsoTpSock(ServerTag, const char *ifname, uint32_t source_addr, uint32_t target_addr,
+              uint32_t source_addr_func)
+        : err_(UDSTpIsoTpSockInitServer(&tp_, ifname, source_addr, target_addr,
+                                        source_addr_func)) {}
+    IsoTpSock(ClientTag, const char *ifname, uint32_t source_addr, uint32_t target_addr,
+              uint32_t target_addr_func)
+        : err_(UDSTpIsoTpSockInitClient(&tp_, ifname, source_addr, target_addr,
+                                        target_addr_func)) {}
+    ~IsoTpSock() {
+        if (UDS_OK == err_) {
+            UDSTpIsoTpSockDeinit(&tp_);
+        }
+    }
+    IsoTpSock(const IsoTpSock &) = delete;
+    IsoTpSock &operator=(const IsoTpSock &) = delete;
+
+    UDSErr_t error() const { return err_; }
+    UDSTp_t *get() { return &tp_.hdl; }
+    operator UDSTp_t *() { return &tp_.hdl; }
+    UDSTpIsoTpSock_t &native() { return tp_; }
+
+  private:
+    UDSTpIsoTpSock_t tp_{};
+    UDSErr_t err_ = UDS_FAIL;
+};
+#endif
+
+/**
+ * @brief A UDSServer_t whose callback is Services::fn. `fn_data` stays free for the user.
+ */
+template <class ServicesT> class Server {
+  public:
+    explicit Server(UDSTp_t *tp) {
+        UDSServerInit(&srv_);
+        srv_.tp = tp;
+        srv_.fn = &ServicesT::fn;
+    }
+    Server(const Server &) = delete;
+    Server &operator=(const Server &) = delete;
+
+    void poll() { UDSServerPoll(&srv_); }
+#if UDS_SYS == UDS_SYS_UNIX
+    UDSErr_t wait(int timeout_ms) { return UDSServerWait(&srv_, timeout_ms); }
+#endif
+
+    UDSServer_t *get() { return &srv_; }
+    UDSServer_t *operator->() { return &srv_; }
+
+  private:
+    UDSServer_t srv_{};
+};
+
+/**
+ * @brief A UDSClient_t with blocking, typed helpers built on the request queue. `fn` may be
+ * replaced; it defaults to one that ignores all events.
+ */
+class Client {
+  public:
+    explicit Client(UDSTp_t *tp) {
+        UDSClientInit(&client_);
+        client_.tp = tp;
+        client_.fn = &Ignore;
+    }
+#if UDS_SYS == UDS_SYS_UNIX && defined(__linux__)
+    ~Client() { UDSClientCloseTimerFd(&client_); }
+#endif
+    Client(const Client &) = delete;
+    Client &operator=(const Client &) = delete;
+
+    UDSErr_t poll() { return UDSClientPoll(&client_); }
+
+    /**
+     * @brief Send req and poll until it completes
+     * @param resp receives the positive response, truncated to its size
+     * @param resp_len set to the full response length
+     * @return UDS_OK, the NRC of a negative response, or a UDS_ERR_* code
+     */
+    UDSErr_t request(span<const uint8_t> req, span<uint8_t> resp, std::size_t *resp_len) {
+        Pending p{};
+        p.resp = resp;
+        UDSClientReq_t r{};
+        r.data = req.data();
+        r.len = static_cast<uint16_t>(req.size());
+        r.options = client_.defaultOptions;
+        r.cb = &Complete;
+        r.cb_data = &p;
+        UDSErr_t err = UDSClientEnqueue(&client_, &r);
+        if (UDS_OK != err) {
+            return err;
+        }
+        while (!p.done) {
+#if UDS_SYS == UDS_SYS_UNIX
+            UDSClientWait(&client_, -1);
+#endif
+            UDSClientPoll(&client_);
+        }
+        if (resp_len) {
+            *resp_len = p.len;
+        }
+        return p.err;
+    }
+
+    /**
+     * @brief ReadDataByIdentifier of D (a uds::Did) into out
+     */
+    template <class D> UDSErr_t read(typename D::Type &out) {
+        const uint8_t req[3] = {kSID_READ_DATA_BY_IDENTIFIER, static_cast<uint8_t>(D::id >> 8),
+                                static_cast<uint8_t>(D::id)};
+        uint8_t resp[3 + D::size];
+        std::size_t len = 0;
+        UDSErr_t err = request(span<const uint8_t>(req, sizeof(req)),
+                               span<uint8_t>(resp, sizeof(resp)), &len);
+        if (UDS_OK != err) {
+            return err;
+        }
+        if (len < sizeof(resp)) {
+            return UDS_ERR_RESP_TOO_SHORT;
+        }
+        if (len > sizeof(resp)) {
+            return UDS_ERR_BUFSIZ;
+        }
+        if (Codec<uint16_t>::decode(resp + 1) != D::id) {
+            return UDS_ERR_DID_MISMATCH;
+        }
+        out = Codec<typename D::Type>::decode(resp + 3);
+        return UDS_OK;
+    }
+
+    /**
+     * @brief WriteDataByIdentifier of D (a uds::Did) with v
+     */
+    template <class D> UDSErr_t write(const typename D::Type &v) {
+        uint8_t req[3 + D::size] = {kSID_WRITE_DATA_BY_IDENTIFIER,
+                                    static_cast<uint8_t>(D::id >> 8),
+                                    static_cast<uint8_t>(D::id)};
+        Codec<typename D::Type>::encode(req + 3, v);
+        uint8_t resp[3];
+        std::size_t len = 0;
+        UDSErr_t err = request(span<const uint8_t>(req, sizeof(req)),
+                               span<uint8_t>(resp, sizeof(resp)), &len);
+        if (UDS_OK != err) {
+            return err;
+        }
+        if (len < sizeof(resp)) {
+            return UDS_ERR_RESP_TOO_SHORT;
+        }
+        return Codec<uint16_t>::decode(resp + 1) == D::id ? UDS_OK : UDS_ERR_DID_MISMATCH;
+    }
+
+    UDSClient_t *get() { return &client_; }
+    UDSClient_t *operator->() { return &client_; }
+
+  private:
+    struct Pending {
+        span<uint8_t> resp;
+        std::size_t len;
+        UDSErr_t err;
+        bool done;
+    };
+
+    static int Ignore(UDSClient_t *, UDSEvent_t, void *) { return UDS_OK; }
+
+    static void Complete(UDSClient_t *client, UDSClientReq_t *req, UDSErr_t err) {
+        Pending *p = static_cast<Pending *>(req->cb_data);
+        p->err = err;
+        p->len = 0;
+        if (UDS_OK == err) {
+            p->len = client->recv_size;
+            std::memcpy(p->resp.data(), client->recv_buf,
+                        p->len < p->resp.size() ? p->len : p->resp.size());
+        }
+        p->done = true;
+    }
+
+    UDSClient_t client_{};
+};
+
+} // namespace uds
+
+#endif
@@ -28,7 +28,7 @@ cat > /home/ctfuser/.welcome << 'EOF'
 - isotpsend: ISO-TP协议发送
 
 CAN接口: vcan0
-UDS服务监听: 0x7E0
+UDS服务监听: 0x7E0 (物理寻址) / 0x7DF (功能寻址)
 UDS响应: 0x7E8
 
 提示: 使用vim编辑Python脚本进行UDS协议探索
@@ -0,0 +1,65 @@
+#include "uds_arena.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+static int g_alloc_sealed = 0;
+
+int uds_arena_init(uds_arena_t *a, size_t size) {
+    a->base = malloc(size);
+    if (!a->base) {
+        return -1;
+    }
+    a->size = size;
+    a->used = 0;
+    a->high_water = 0;
+    return 0;
+}
+
+void *uds_arena_alloc(uds_arena_t *a, size_t size) {
+    size_t start = (a->used + UDS_ARENA_ALIGN - 1) & ~(size_t)(UDS_ARENA_ALIGN - 1);
+    if (start > a->size || size > a->size - start) {
+        return NULL;
+    }
+    a->used = start + size;
+    if (a->used > a->high_water) {
+        a->high_water = a->used;
+    }
+    return a->base + start;
+}
+
+void uds_alloc_seal(void) {
+    g_alloc_sealed = 1;
+}
+
+#ifdef UDS_STRICT_ALLOC
+// 通过链接选项 -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc 截获程序自身的堆分配
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t nmemb, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+static void alloc_after_seal(const char *fn, size_t size) {
+    fprintf(stderr, "[STRICT_ALLOC] 初始化完成后调用了%s(%zu)\n", fn, size);
+    abort();
+}
+
+void *__wrap_malloc(size_t size) {
+    if (g_alloc_sealed) {
+        alloc_after_seal("malloc", size);
+    }
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t nmemb, size_t size) {
+    if (g_alloc_sealed) {
+        alloc_after_seal("calloc", nmemb * size);
+    }
+    return __real_calloc(nmemb, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+    if (g_alloc_sealed) {
+        alloc_after_seal("realloc", size);
+    }
+    return __real_realloc(ptr, size);
+}
+#endif
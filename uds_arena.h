@@ -0,0 +1,30 @@
+#ifndef UDS_ARENA_H
+#define UDS_ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// 线性分配器：启动时一次性分配，请求处理路径上只做指针移动，每个请求结束后整体复位
+// 多帧重组缓冲、响应构造缓冲和处理函数的临时空间都从这里分配
+#define UDS_ARENA_ALIGN 16
+
+typedef struct {
+    uint8_t *base;
+    size_t size;
+    size_t used;
+    size_t high_water; // 历史最大用量，用于确认容量设置是否合理
+} uds_arena_t;
+
+// 分配size字节的后备内存，失败返回-1
+int uds_arena_init(uds_arena_t *a, size_t size);
+
+// 从arena中分配，按UDS_ARENA_ALIGN对齐；空间不足返回NULL
+void *uds_arena_alloc(uds_arena_t *a, size_t size);
+
+// 释放本次请求分配的全部内存
+static inline void uds_arena_reset(uds_arena_t *a) { a->used = 0; }
+
+// 初始化完成：严格模式（make STRICT_ALLOC=1）下此后任何malloc/calloc/realloc都会直接abort
+void uds_alloc_seal(void);
+
+#endif
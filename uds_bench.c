@@ -0,0 +1,552 @@
+// 基准测试：按请求组合驱动UDS服务器，统计吞吐和延迟并输出JSON
+// 传输：
+//   loop  进程内回环，服务器事件循环跑在独立线程，经SOCK_SEQPACKET交换struct can_frame
+//   can   CAN_RAW（默认vcan0），需另行启动uds_server
+// -P 在每次操作前后读取perf计数器，按请求类型输出每请求的cycles/instructions/缓存与分支未命中；
+//    回环模式下分别统计服务器线程和客户端线程，CAN模式只统计客户端
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <linux/can.h>
+#include <linux/can/raw.h>
+#include "uds_server.h"
+#include "uds_stats.h"
+#include "uds_timer.h"
+#include "uds_rt.h"
+#include "uds_perf.h"
+
+#define UDS_PHYS_ID 0x7E0
+#define UDS_RESP_ID 0x7E8
+#define BENCH_MAX_RESP (8 + 0x1000)
+#define BENCH_P2_STAR_MS 5000 // 收到0x78后等待最终响应的时间
+
+// 客户端侧的ISO-TP链路与计数
+typedef struct {
+    int fd;
+    int timeout_ms;
+    uint64_t frames_tx;
+    uint64_t frames_rx;
+    uint64_t bytes_tx; // UDS数据字节数（不含PCI）
+    uint64_t bytes_rx;
+} bench_link_t;
+
+// 请求组合中的一种操作，一次操作可以包含多个请求
+typedef struct {
+    const char *name;
+    int (*run)(bench_link_t *l, uint8_t *resp);
+    int weight;
+    int credit; // 平滑加权轮询
+    uint64_t ops;
+    uint64_t requests;
+    uint64_t errors;
+    uds_hist_t latency; // 单个请求：请求首帧发出 -> 响应末帧收到
+    uds_perf_sample_t perf[2]; // 计数器差值之和，按bench_perf_thread_t区分
+} bench_op_t;
+
+// -P：计数器按线程打开
+typedef enum { BENCH_PERF_SERVER, BENCH_PERF_CLIENT } bench_perf_thread_t;
+static const char *const g_perf_thread_names[2] = { "server", "client" };
+static uds_perf_t g_perf[2];
+static int g_perf_enabled[2];
+
+static uds_hist_t g_all_latency;
+static uint64_t g_requests = 0;
+
+static int link_send(bench_link_t *l, const uint8_t *data, int dlc) {
+    struct can_frame f = { .can_id = UDS_PHYS_ID, .can_dlc = dlc };
+    memcpy(f.data, data, dlc);
+    for (;;) {
+        if (write(l->fd, &f, sizeof(f)) == sizeof(f)) {
+            l->frames_tx++;
+            return 0;
+        }
+        if (errno != ENOBUFS && errno != EAGAIN && errno != EINTR) {
+            return -1;
+        }
+        usleep(100);
+    }
+}
+
+// 读取下一帧响应，忽略其他ID的帧；超时返回-1
+static int link_recv(bench_link_t *l, struct can_frame *f, int timeout_ms) {
+    uint64_t deadline = uds_now_ms() + timeout_ms;
+    for (;;) {
+        int64_t left = (int64_t)(deadline - uds_now_ms());
+        struct pollfd pfd = { .fd = l->fd, .events = POLLIN };
+        if (left < 0 || poll(&pfd, 1, (int)left) <= 0) {
+            return -1;
+        }
+        if (read(l->fd, f, sizeof(*f)) != sizeof(*f)) {
+            return -1;
+        }
+        if (f->can_id == UDS_RESP_ID) {
+            l->frames_rx++;
+            return 0;
+        }
+    }
+}
+
+// 发出一个请求并接收最终响应（跳过0x78），返回响应长度，失败返回-1
+static int isotp_request(bench_link_t *l, const uint8_t *req, int len, uint8_t *resp) {
+    uint8_t buf[8];
+    struct can_frame f;
+
+    if (len <= 7) {
+        buf[0] = len;
+        memcpy(&buf[1], req, len);
+        if (link_send(l, buf, 1 + len) < 0) {
+            return -1;
+        }
+    } else {
+        buf[0] = 0x10 | ((len >> 8) & 0x0F);
+        buf[1] = len & 0xFF;
+        memcpy(&buf[2], req, 6);
+        if (link_send(l, buf, 8) < 0 || link_recv(l, &f, l->timeout_ms) < 0 || (f.data[0] >> 4) != 0x3) {
+            return -1;
+        }
+        // 服务器的FC为BS=0、STmin=0，连续帧直接发完
+        int off = 6;
+        uint8_t sn = 1;
+        while (off < len) {
+            int chunk = len - off > 7 ? 7 : len - off;
+            buf[0] = 0x20 | sn;
+            memcpy(&buf[1], req + off, chunk);
+            if (link_send(l, buf, 1 + chunk) < 0) {
+                return -1;
+            }
+            off += chunk;
+            sn = (sn + 1) & 0x0F;
+        }
+    }
+    l->bytes_tx += len;
+
+    int timeout = l->timeout_ms;
+    for (;;) {
+        if (link_recv(l, &f, timeout) < 0) {
+            return -1;
+        }
+        uint8_t type = f.data[0] >> 4;
+        if (type == 0x0) {
+            int n = f.data[0] & 0x0F;
+            if (n == 0 || n >= f.can_dlc) {
+                return -1;
+            }
+            memcpy(resp, &f.data[1], n);
+            if (n == 3 && resp[0] == 0x7F && resp[2] == 0x78) {
+                timeout = BENCH_P2_STAR_MS;
+                continue;
+            }
+            l->bytes_rx += n;
+            return n;
+        }
+        if (type != 0x1) {
+            continue;
+        }
+        // 首帧：12位长度为0时后跟32位长度
+        uint32_t total = ((f.data[0] & 0x0F) << 8) | f.data[1];
+        int hdr = 2;
+        if (total == 0) {
+            total = ((uint32_t)f.data[2] << 24) | (f.data[3] << 16) | (f.data[4] << 8) | f.data[5];
+            hdr = 6;
+        }
+        if (total > BENCH_MAX_RESP) {
+            return -1;
+        }
+        uint32_t got = 8 - hdr;
+        memcpy(resp, &f.data[hdr], got);
+        static const uint8_t fc[3] = { 0x30, 0x00, 0x00 };
+        if (link_send(l, fc, 3) < 0) {
+            return -1;
+        }
+        uint8_t sn = 1;
+        while (got < total) {
+            if (link_recv(l, &f, l->timeout_ms) < 0 || f.data[0] != (0x20 | sn)) {
+                return -1;
+            }
+            uint32_t chunk = total - got < 7 ? total - got : 7;
+            memcpy(resp + got, &f.data[1], chunk);
+            got += chunk;
+            sn = (sn + 1) & 0x0F;
+        }
+        l->bytes_rx += total;
+        return total;
+    }
+}
+
+// 计时并检查肯定响应SID，返回响应长度，失败返回-1
+static int timed_request(bench_link_t *l, bench_op_t *op, const uint8_t *req, int len, uint8_t *resp) {
+    uint64_t t0 = uds_rt_realtime_ns();
+    int n = isotp_request(l, req, len, resp);
+    uint64_t dt = uds_rt_realtime_ns() - t0;
+    op->requests++;
+    g_requests++;
+    if (n <= 0 || resp[0] != (req[0] | 0x40)) {
+        return -1;
+    }
+    uds_hist_record(&op->latency, dt);
+    uds_hist_record(&g_all_latency, dt);
+    return n;
+}
+
+static bench_op_t *g_cur_op;
+
+static int op_rdbi(bench_link_t *l, uint8_t *resp) {
+    static const uint8_t req[] = { 0x22, 0xF1, 0x90 };
+    return timed_request(l, g_cur_op, req, sizeof(req), resp) < 0 ? -1 : 0;
+}
+
+static int op_tester(bench_link_t *l, uint8_t *resp) {
+    static const uint8_t req[] = { 0x3E, 0x00 };
+    return timed_request(l, g_cur_op, req, sizeof(req), resp) < 0 ? -1 : 0;
+}
+
+// 级别5 seed/key（0x23读内存的前提）
+static int op_security(bench_link_t *l, uint8_t *resp) {
+    uint8_t req[6] = { 0x27, 0x05 };
+    if (timed_request(l, g_cur_op, req, 2, resp) < 6) {
+        return -1;
+    }
+    uint32_t seed = ((uint32_t)resp[2] << 24) | (resp[3] << 16) | (resp[4] << 8) | resp[5];
+    uint32_t key = calc_key_level5(seed);
+    req[1] = 0x06;
+    req[2] = key >> 24;
+    req[3] = key >> 16;
+    req[4] = key >> 8;
+    req[5] = key;
+    return timed_request(l, g_cur_op, req, 6, resp) < 0 ? -1 : 0;
+}
+
+// 4KB读内存：格式0x24（2字节长度、4字节地址），8字节请求走首帧+连续帧，响应走32位长度首帧
+static int op_read4k(bench_link_t *l, uint8_t *resp) {
+    static const uint8_t req[] = { 0x23, 0x24, 0x40, 0x00, 0x00, 0x00, 0x10, 0x00 };
+    return timed_request(l, g_cur_op, req, sizeof(req), resp) == 2 + 0x1000 ? 0 : -1;
+}
+
+static bench_op_t g_ops[] = {
+    { "rdbi", op_rdbi },
+    { "read4k", op_read4k },
+    { "security", op_security },
+    { "tester", op_tester },
+};
+#define N_OPS (int)(sizeof(g_ops) / sizeof(g_ops[0]))
+
+// 解析 "rdbi:4,read4k:1,..."，未出现的操作权重为0
+static int parse_mix(const char *spec) {
+    char buf[256];
+    snprintf(buf, sizeof(buf), "%s", spec);
+    for (char *tok = strtok(buf, ","); tok; tok = strtok(NULL, ",")) {
+        char *colon = strchr(tok, ':');
+        int weight = colon ? atoi(colon + 1) : 1;
+        if (colon) {
+            *colon = '\0';
+        }
+        int i;
+        for (i = 0; i < N_OPS; i++) {
+            if (strcmp(g_ops[i].name, tok) == 0) {
+                g_ops[i].weight = weight;
+                break;
+            }
+        }
+        if (i == N_OPS) {
+            fprintf(stderr, "未知操作: %s（可用: rdbi read4k security tester）\n", tok);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// 平滑加权轮询：各操作按权重均匀交错，而不是成批出现
+static bench_op_t *next_op(void) {
+    int total = 0;
+    bench_op_t *best = NULL;
+    for (int i = 0; i < N_OPS; i++) {
+        if (!g_ops[i].weight) {
+            continue;
+        }
+        g_ops[i].credit += g_ops[i].weight;
+        total += g_ops[i].weight;
+        if (!best || g_ops[i].credit > best->credit) {
+            best = &g_ops[i];
+        }
+    }
+    best->credit -= total;
+    return best;
+}
+
+static pid_t g_server_tid;
+
+static void *server_thread(void *arg) {
+    __atomic_store_n(&g_server_tid, (pid_t)syscall(SYS_gettid), __ATOMIC_RELEASE);
+    uds_server_run();
+    return NULL;
+}
+
+static int open_can(const char *ifname) {
+    struct ifreq ifr;
+    struct sockaddr_can addr = { .can_family = AF_CAN };
+    int s = socket(PF_CAN, SOCK_RAW, CAN_RAW);
+    if (s < 0) {
+        perror("socket");
+        return -1;
+    }
+    snprintf(ifr.ifr_name, sizeof(ifr.ifr_name), "%s", ifname);
+    if (ioctl(s, SIOCGIFINDEX, &ifr) < 0) {
+        perror("SIOCGIFINDEX");
+        close(s);
+        return -1;
+    }
+    addr.can_ifindex = ifr.ifr_ifindex;
+    struct can_filter filter = { .can_id = UDS_RESP_ID, .can_mask = CAN_SFF_MASK };
+    setsockopt(s, SOL_CAN_RAW, CAN_RAW_FILTER, &filter, sizeof(filter));
+    if (bind(s, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        perror("bind");
+        close(s);
+        return -1;
+    }
+    return s;
+}
+
+static void json_hist(FILE *out, const uds_hist_t *h) {
+    fprintf(out, "{\"count\": %llu, \"min\": %.1f, \"p50\": %.1f, \"p90\": %.1f, \"p99\": %.1f, "
+                 "\"p999\": %.1f, \"max\": %.1f}",
+            (unsigned long long)h->count, h->count ? h->min / 1000.0 : 0.0,
+            uds_hist_percentile(h, 0.50) / 1000.0, uds_hist_percentile(h, 0.90) / 1000.0,
+            uds_hist_percentile(h, 0.99) / 1000.0, uds_hist_percentile(h, 0.999) / 1000.0,
+            h->max / 1000.0);
+}
+
+// 每请求的平均计数，instructions和cycles都可用时附带IPC
+static void json_perf(FILE *out, const uds_perf_t *p, const uds_perf_sample_t *s, uint64_t requests) {
+    const char *sep = "";
+    fprintf(out, "{");
+    for (int e = 0; e < UDS_PERF_COUNT; e++) {
+        if (!uds_perf_available(p, e)) {
+            continue;
+        }
+        fprintf(out, "%s\"%s\": %.1f", sep, uds_perf_name(e), requests ? (double)s->v[e] / requests : 0.0);
+        sep = ", ";
+    }
+    if (uds_perf_available(p, UDS_PERF_CYCLES) && uds_perf_available(p, UDS_PERF_INSTRUCTIONS) &&
+        s->v[UDS_PERF_CYCLES]) {
+        fprintf(out, ", \"ipc\": %.3f", (double)s->v[UDS_PERF_INSTRUCTIONS] / s->v[UDS_PERF_CYCLES]);
+    }
+    fprintf(out, "}");
+}
+
+// 执行一次操作；-P时在前后读取各线程计数器并累加差值
+static int run_op(bench_op_t *op, bench_link_t *l, uint8_t *resp) {
+    uds_perf_sample_t before[2], after[2];
+    int ok[2] = { 0, 0 };
+    for (int t = 0; t < 2; t++) {
+        ok[t] = g_perf_enabled[t] && uds_perf_read(&g_perf[t], &before[t]) == 0;
+    }
+    int ret = op->run(l, resp);
+    for (int t = 0; t < 2; t++) {
+        if (ok[t] && uds_perf_read(&g_perf[t], &after[t]) == 0) {
+            uds_perf_accumulate(&op->perf[t], &before[t], &after[t]);
+        }
+    }
+    return ret;
+}
+
+static void usage(const char *prog) {
+    printf("用法: %s [-t loop|can] [-i ifname] [-m mix] [-d seconds] [-n ops] [-w warmup] [-o file] [-P]\n", prog);
+    printf("  -t  传输: loop 进程内回环(默认)，can 经CAN_RAW连接已运行的uds_server\n");
+    printf("  -i  CAN接口 (默认vcan0)\n");
+    printf("  -m  请求组合，操作:权重，逗号分隔 (默认 rdbi:4,read4k:1,security:1,tester:4)\n");
+    printf("      rdbi=22 F190  read4k=23读4KB  security=27 05/06  tester=3E 00\n");
+    printf("  -d  测试时长秒数 (默认5)；-n 指定操作次数时忽略\n");
+    printf("  -w  预热操作次数，不计入结果 (默认100)\n");
+    printf("  -o  JSON输出文件 (默认标准输出)\n");
+    printf("  -P  按请求类型统计perf计数器（硬件不可用时退回软件计数器）\n");
+}
+
+int main(int argc, char **argv) {
+    const char *transport = "loop";
+    const char *ifname = "vcan0";
+    const char *mix = "rdbi:4,read4k:1,security:1,tester:4";
+    const char *out_path = NULL;
+    double duration = 5.0;
+    long max_ops = 0;
+    long warmup = 100;
+    int use_perf = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "t:i:m:d:n:w:o:Ph")) != -1) {
+        switch (opt) {
+        case 't': transport = optarg; break;
+        case 'i': ifname = optarg; break;
+        case 'm': mix = optarg; break;
+        case 'd': duration = atof(optarg); break;
+        case 'n': max_ops = atol(optarg); break;
+        case 'w': warmup = atol(optarg); break;
+        case 'o': out_path = optarg; break;
+        case 'P': use_perf = 1; break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (parse_mix(mix) < 0) {
+        return 1;
+    }
+
+    bench_link_t link = { .fd = -1, .timeout_ms = 1000 };
+    pthread_t server;
+    int sv[2] = { -1, -1 };
+    if (strcmp(transport, "loop") == 0) {
+        if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sv) < 0) {
+            perror("socketpair");
+            return 1;
+        }
+        uds_server_set_logging(0);
+        srand(1);
+        if (uds_server_init(sv[1]) < 0 || pthread_create(&server, NULL, server_thread, NULL) != 0) {
+            fprintf(stderr, "服务器线程启动失败\n");
+            return 1;
+        }
+        link.fd = sv[0];
+    } else if (strcmp(transport, "can") == 0) {
+        link.fd = open_can(ifname);
+        if (link.fd < 0) {
+            return 1;
+        }
+    } else {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (use_perf) {
+        if (sv[0] >= 0) {
+            clockid_t clock;
+            while (!__atomic_load_n(&g_server_tid, __ATOMIC_ACQUIRE)) {
+                usleep(1000);
+            }
+            pthread_getcpuclockid(server, &clock);
+            uds_perf_open(&g_perf[BENCH_PERF_SERVER], g_server_tid, clock);
+            g_perf_enabled[BENCH_PERF_SERVER] = 1;
+        }
+        uds_perf_open(&g_perf[BENCH_PERF_CLIENT], 0, CLOCK_THREAD_CPUTIME_ID);
+        g_perf_enabled[BENCH_PERF_CLIENT] = 1;
+    }
+
+    uint8_t *resp = malloc(BENCH_MAX_RESP);
+    // 0x23需要级别5，先解锁一次（security操作会反复重新解锁）
+    g_cur_op = &g_ops[2];
+    if (op_security(&link, resp) < 0) {
+        fprintf(stderr, "级别5安全访问失败，服务器是否在运行？\n");
+        return 1;
+    }
+    for (long i = 0; i < warmup; i++) {
+        g_cur_op = next_op();
+        g_cur_op->run(&link, resp);
+    }
+    // 预热结束，清零全部计数
+    memset(&g_all_latency, 0, sizeof(g_all_latency));
+    g_requests = 0;
+    for (int i = 0; i < N_OPS; i++) {
+        g_ops[i].ops = g_ops[i].requests = g_ops[i].errors = 0;
+        memset(&g_ops[i].latency, 0, sizeof(g_ops[i].latency));
+        memset(g_ops[i].perf, 0, sizeof(g_ops[i].perf));
+    }
+    link.frames_tx = link.frames_rx = link.bytes_tx = link.bytes_rx = 0;
+
+    uint64_t errors = 0;
+    uint64_t start = uds_rt_realtime_ns();
+    uint64_t end = start + (uint64_t)(duration * 1e9);
+    for (long n = 0;; n++) {
+        if (max_ops ? n >= max_ops : (n & 15) == 0 && uds_rt_realtime_ns() >= end) {
+            break;
+        }
+        g_cur_op = next_op();
+        g_cur_op->ops++;
+        if (run_op(g_cur_op, &link, resp) < 0) {
+            g_cur_op->errors++;
+            errors++;
+        }
+    }
+    double elapsed = (uds_rt_realtime_ns() - start) / 1e9;
+
+    if (sv[0] >= 0) {
+        uds_server_stop();
+        shutdown(sv[0], SHUT_RDWR); // 唤醒服务器线程的poll()
+        pthread_join(server, NULL);
+        close(sv[0]);
+        close(sv[1]);
+    } else {
+        close(link.fd);
+    }
+
+    FILE *out = out_path ? fopen(out_path, "w") : stdout;
+    if (!out) {
+        perror(out_path);
+        return 1;
+    }
+    fprintf(out, "{\n  \"transport\": \"%s\",\n", strcmp(transport, "can") == 0 ? ifname : "loop");
+    fprintf(out, "  \"mix\": \"%s\",\n", mix);
+    fprintf(out, "  \"duration_s\": %.3f,\n", elapsed);
+    fprintf(out, "  \"requests\": %llu,\n  \"errors\": %llu,\n", (unsigned long long)g_requests,
+            (unsigned long long)errors);
+    fprintf(out, "  \"requests_per_s\": %.1f,\n", g_requests / elapsed);
+    fprintf(out, "  \"frames_tx\": %llu,\n  \"frames_rx\": %llu,\n  \"frames_per_s\": %.1f,\n",
+            (unsigned long long)link.frames_tx, (unsigned long long)link.frames_rx,
+            (link.frames_tx + link.frames_rx) / elapsed);
+    fprintf(out, "  \"bytes_tx\": %llu,\n  \"bytes_rx\": %llu,\n  \"bytes_per_s\": %.1f,\n",
+            (unsigned long long)link.bytes_tx, (unsigned long long)link.bytes_rx,
+            (link.bytes_tx + link.bytes_rx) / elapsed);
+    if (use_perf) {
+        const uds_perf_t *p = &g_perf[BENCH_PERF_CLIENT];
+        fprintf(out, "  \"perf_source\": \"%s\",\n",
+                p->use_clock ? "thread_cpu_clock" : uds_perf_has_hardware(p) ? "hardware" : "software");
+    }
+    fprintf(out, "  \"latency_us\": ");
+    json_hist(out, &g_all_latency);
+    fprintf(out, ",\n  \"ops\": {");
+    int first = 1;
+    for (int i = 0; i < N_OPS; i++) {
+        bench_op_t *op = &g_ops[i];
+        if (!op->weight) {
+            continue;
+        }
+        fprintf(out, "%s\n    \"%s\": {\"weight\": %d, \"ops\": %llu, \"requests\": %llu, \"errors\": %llu, "
+                     "\"latency_us\": ",
+                first ? "" : ",", op->name, op->weight, (unsigned long long)op->ops,
+                (unsigned long long)op->requests, (unsigned long long)op->errors);
+        json_hist(out, &op->latency);
+        if (use_perf) {
+            fprintf(out, ", \"perf_per_request\": {");
+            const char *sep = "";
+            for (int t = 0; t < 2; t++) {
+                if (!g_perf_enabled[t]) {
+                    continue;
+                }
+                fprintf(out, "%s\"%s\": ", sep, g_perf_thread_names[t]);
+                json_perf(out, &g_perf[t], &op->perf[t], op->requests);
+                sep = ", ";
+            }
+            fprintf(out, "}");
+        }
+        fprintf(out, "}");
+        first = 0;
+    }
+    fprintf(out, "\n  }\n}\n");
+    if (out != stdout) {
+        fclose(out);
+    }
+    for (int t = 0; t < 2; t++) {
+        if (g_perf_enabled[t]) {
+            uds_perf_close(&g_perf[t]);
+        }
+    }
+    free(resp);
+    return errors ? 2 : 0;
+}
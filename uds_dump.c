@@ -0,0 +1,353 @@
+// 内存dump工具：安全访问解锁后按地址范围读取内存，写入稀疏文件
+//   优先使用0x35 RequestUpload + 0x36 TransferData（服务器不支持时回退）；
+//   0x23 ReadMemoryByAddress的块大小自动探测：从ISO-TP报文能容纳的最大值开始，
+//   服务器以NRC拒绝时减半重试，响应比请求短时取响应长度
+// 全零块不写入（留作文件空洞）。进度记录在 <输出文件>.resume，中断后用 -r 从断点继续
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include "iso14229.h"
+#include "uds_tool.h"
+
+#define DUMP_MAX_CHUNK (UDS_ISOTP_MTU - 2) // 0x63 + 格式字节 + 数据须放入一个ISO-TP报文
+#define DUMP_PROGRESS_MS 1000              // 进度输出间隔
+
+// ============== 输出文件与断点 ==============
+typedef struct {
+    int fd;
+    int resume_fd;
+    uint32_t start;
+    uint32_t size;
+    uint32_t done;     // 已完成的字节数（从start起连续）
+    uint64_t written;  // 实际写入的字节数（不含空洞）
+    uint64_t t_start;
+    uint64_t t_report;
+    uint32_t done_at_start;
+    int progress_shown; // 已输出过以\r刷新的进度行
+} dump_out_t;
+
+// 断点文件格式: "start size done\n"，均为8位十六进制，定长以便原地覆盖
+static void save_progress(dump_out_t *o) {
+    char buf[32];
+    int n = snprintf(buf, sizeof(buf), "%08X %08X %08X\n", o->start, o->size, o->done);
+    if (pwrite(o->resume_fd, buf, n, 0) != n) {
+        perror("写入断点文件");
+    }
+}
+
+static int open_output(dump_out_t *o, const char *path, int resume) {
+    char resume_path[4096];
+    snprintf(resume_path, sizeof(resume_path), "%s.resume", path);
+    o->fd = open(path, O_RDWR | O_CREAT | (resume ? 0 : O_TRUNC), 0644);
+    if (o->fd < 0) {
+        perror(path);
+        return -1;
+    }
+    o->resume_fd = open(resume_path, O_RDWR | O_CREAT, 0644);
+    if (o->resume_fd < 0) {
+        perror(resume_path);
+        return -1;
+    }
+    if (resume) {
+        char buf[32] = { 0 };
+        unsigned start, size, done;
+        if (pread(o->resume_fd, buf, sizeof(buf) - 1, 0) > 0 &&
+            sscanf(buf, "%x %x %x", &start, &size, &done) == 3) {
+            if (start != o->start || size != o->size || done > size) {
+                fprintf(stderr, "断点文件记录的范围 0x%08X+0x%X 与本次参数不一致\n", start, size);
+                return -1;
+            }
+            o->done = done;
+            printf("[LOG] 从断点继续: 0x%08X (已完成%u/%u字节)\n", o->start + done, done, size);
+        } else {
+            printf("[LOG] 没有可用的断点记录，从头开始\n");
+        }
+    }
+    // 丢弃断点之后的旧内容（没有接受断点时即整个文件），否则全零块留下的空洞会保留上次dump的数据
+    if (ftruncate(o->fd, o->done) < 0) {
+        perror("ftruncate");
+        return -1;
+    }
+    // 先把文件扩展到完整大小：未写入的区域为空洞，读出为零
+    if (ftruncate(o->fd, o->size) < 0) {
+        perror("ftruncate");
+        return -1;
+    }
+    save_progress(o);
+    o->done_at_start = o->done;
+    o->t_start = o->t_report = uds_tool_now_ns(CLOCK_MONOTONIC);
+    return 0;
+}
+
+static int is_zero(const uint8_t *p, uint32_t n) {
+    for (uint32_t i = 0; i < n; i++) {
+        if (p[i]) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void report_progress(dump_out_t *o, int final) {
+    uint64_t now = uds_tool_now_ns(CLOCK_MONOTONIC);
+    double elapsed = (now - o->t_start) / 1e9;
+    double rate = elapsed > 0 ? (o->done - o->done_at_start) / elapsed : 0;
+    if (final) {
+        if (o->progress_shown) {
+            printf("\n");
+            o->progress_shown = 0;
+        }
+        printf("[LOG] 完成 %u/%u 字节，用时 %.2f 秒，%.1f KiB/s，%llu 个请求（%llu 次超时重试），"
+               "实际写入 %llu 字节\n",
+               o->done, o->size, elapsed, rate / 1024, (unsigned long long)uds_tool_requests,
+               (unsigned long long)uds_tool_retries, (unsigned long long)o->written);
+    } else if (now - o->t_report >= DUMP_PROGRESS_MS * 1000000ull) {
+        o->t_report = now;
+        o->progress_shown = 1;
+        printf("\r[LOG] 0x%08X  %u/%u 字节 (%.1f%%)  %.1f KiB/s", o->start + o->done, o->done,
+               o->size, o->size ? 100.0 * o->done / o->size : 100.0, rate / 1024);
+        fflush(stdout);
+    }
+}
+
+// 保存一块数据并推进断点
+static int store(dump_out_t *o, const uint8_t *data, uint32_t n) {
+    if (!is_zero(data, n)) {
+        if (pwrite(o->fd, data, n, o->done) != (ssize_t)n) {
+            perror("pwrite");
+            return -1;
+        }
+        o->written += n;
+    }
+    o->done += n;
+    save_progress(o);
+    report_progress(o, 0);
+    return 0;
+}
+
+// ============== 0x35/0x36/0x37 上传 ==============
+// 服务器不支持0x35（或拒绝该范围）时返回1，调用方回退到0x23；失败返回-1
+static int dump_upload(dump_out_t *o) {
+    uint32_t addr = o->start + o->done;
+    uint32_t size = o->size - o->done;
+    // dataFormatIdentifier 0x00（不压缩不加密），addressAndLengthFormatIdentifier 0x44
+    uint8_t req[11] = { 0x35, 0x00, 0x44, addr >> 24, addr >> 16, addr >> 8, addr,
+                        size >> 24, size >> 16, size >> 8, size };
+    UDSErr_t err = uds_tool_request(req, sizeof(req));
+    if (err != UDS_OK) {
+        if (err < 0x100) {
+            printf("[LOG] RequestUpload被拒绝 (NRC 0x%02X)，改用ReadMemoryByAddress\n", err);
+            return 1;
+        }
+        uds_tool_print_err("RequestUpload", err);
+        return -1;
+    }
+    // 0x75 lengthFormatIdentifier maxNumberOfBlockLength
+    uint8_t len_bytes = uds_tool_client.recv_size >= 2 ? uds_tool_client.recv_buf[1] >> 4 : 0;
+    if (len_bytes == 0 || len_bytes > 4 || uds_tool_client.recv_size < 2u + len_bytes) {
+        fprintf(stderr, "RequestUpload响应格式错误\n");
+        return -1;
+    }
+    uint32_t max_block = 0;
+    for (int i = 0; i < len_bytes; i++) {
+        max_block = (max_block << 8) | uds_tool_client.recv_buf[2 + i];
+    }
+    if (max_block > UDS_ISOTP_MTU) {
+        max_block = UDS_ISOTP_MTU;
+    }
+    if (max_block <= 2) {
+        fprintf(stderr, "RequestUpload块长度无效: %u\n", max_block);
+        return -1;
+    }
+    printf("[LOG] 使用RequestUpload，每块%u字节\n", max_block - 2);
+
+    uint8_t bsc = 1;
+    while (o->done < o->size && !uds_tool_stop) {
+        uint8_t td[2] = { 0x36, bsc };
+        err = uds_tool_request(td, sizeof(td));
+        if (err != UDS_OK) {
+            uds_tool_print_err("TransferData", err);
+            return -1;
+        }
+        if (uds_tool_client.recv_size < 3 || uds_tool_client.recv_buf[1] != bsc) {
+            fprintf(stderr, "TransferData响应序号错误\n");
+            return -1;
+        }
+        uint32_t n = uds_tool_client.recv_size - 2;
+        if (n > o->size - o->done) {
+            n = o->size - o->done;
+        }
+        if (store(o, uds_tool_client.recv_buf + 2, n) < 0) {
+            return -1;
+        }
+        bsc++; // 0xFF之后回到0x00
+    }
+    if (uds_tool_stop) {
+        return 0;
+    }
+    uint8_t exit_req[1] = { 0x37 };
+    err = uds_tool_request(exit_req, sizeof(exit_req));
+    if (err != UDS_OK) {
+        uds_tool_print_err("RequestTransferExit", err);
+        return -1;
+    }
+    return 0;
+}
+
+// ============== 0x23 读内存 ==============
+static int dump_read(dump_out_t *o, uint32_t chunk) {
+    int auto_size = chunk == 0;
+    uint32_t hdr = 0; // 响应头部长度，0为尚未确定
+    if (auto_size || chunk > DUMP_MAX_CHUNK) {
+        chunk = DUMP_MAX_CHUNK;
+    }
+    if (chunk > 16) {
+        chunk &= ~0xFu; // 保持后续请求地址对齐
+    }
+    while (o->done < o->size && !uds_tool_stop) {
+        uint32_t addr = o->start + o->done;
+        uint32_t n = o->size - o->done < chunk ? o->size - o->done : chunk;
+        // 格式0x24：2字节长度、4字节地址
+        uint8_t req[8] = { 0x23, 0x24, addr >> 24, addr >> 16, addr >> 8, addr, n >> 8, n };
+        UDSErr_t err = uds_tool_request(req, sizeof(req));
+        if (err != UDS_OK) {
+            // 长度超出服务器限制时服务器返回0x22/0x31/0x13/0x14，块大小减半再试
+            if (auto_size && err < 0x100 && err != 0x33 && n > 1) {
+                chunk = n / 2 > 16 ? (n / 2) & ~0xFu : n / 2;
+                if (uds_tool_verbose) {
+                    fprintf(stderr, "[LOG] 0x%08X 读取%u字节被拒绝 (NRC 0x%02X)，块大小降为%u\n",
+                            addr, n, err, chunk);
+                }
+                continue;
+            }
+            fprintf(stderr, "\n0x%08X: ", addr);
+            uds_tool_print_err("ReadMemoryByAddress", err);
+            return -1;
+        }
+        // 标准响应为0x63 + 数据；本服务器在数据前回显格式字节。头部长度由第一个完整响应确定，
+        // 之后被截断的响应不能再按长度推断，否则会把格式字节当成数据
+        uint32_t size = uds_tool_client.recv_size;
+        if (hdr == 0) {
+            if (size == n + 2 && uds_tool_client.recv_buf[1] == 0x24) {
+                hdr = 2;
+            } else if (size == n + 1) {
+                hdr = 1;
+            } else if (size > 2 && size < n + 1) {
+                chunk = size - 2; // 响应被截断，缩小到一定能完整返回的长度再读一次
+                continue;
+            } else {
+                fprintf(stderr, "\n0x%08X: ReadMemoryByAddress响应长度%u与请求的%u字节不符\n", addr, size, n);
+                return -1;
+            }
+        }
+        uint32_t got = size > hdr ? size - hdr : 0;
+        if (got == 0) {
+            fprintf(stderr, "\n0x%08X: ReadMemoryByAddress响应没有数据\n", addr);
+            return -1;
+        }
+        if (got > n) {
+            got = n;
+        } else if (got < n && auto_size) {
+            chunk = got; // 服务器截断了响应，以实际长度作为块大小
+        }
+        if (store(o, uds_tool_client.recv_buf + hdr, got) < 0) {
+            return -1;
+        }
+    }
+    if (o->progress_shown) {
+        printf("\n");
+        o->progress_shown = 0;
+    }
+    if (auto_size) {
+        printf("[LOG] ReadMemoryByAddress块大小: %u字节\n", chunk);
+    }
+    return 0;
+}
+
+static void usage(const char *prog) {
+    printf("用法: %s [-i ifname] [-a phys:resp] [-s session] [-l level] [-c chunk] [-U] [-r] [-v]\n"
+           "       [-o file] ADDR SIZE\n", prog);
+    printf("  -i  CAN接口 (默认vcan0)\n");
+    printf("  -a  请求ID:响应ID (默认7E0:7E8)\n");
+    printf("  -s  先切换到该诊断会话 (默认不切换)\n");
+    printf("  -l  安全访问级别，0为不解锁 (默认05)\n");
+    printf("  -c  0x23每次读取的字节数 (默认自动探测)\n");
+    printf("  -U  不尝试0x35 RequestUpload\n");
+    printf("  -r  从 <file>.resume 记录的断点继续\n");
+    printf("  -v  输出重试和块大小调整信息\n");
+    printf("  -o  输出文件 (默认memory_dump.bin)\n");
+    printf("例: %s 40000000 20000\n", prog);
+}
+
+int main(int argc, char **argv) {
+    const char *ifname = "vcan0";
+    const char *out_path = "memory_dump.bin";
+    uint32_t phys = 0x7E0, resp = 0x7E8;
+    int session = 0, level = 0x05, resume = 0, try_upload = 1;
+    uint32_t chunk = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "i:a:s:l:c:Urvo:h")) != -1) {
+        switch (opt) {
+        case 'i': ifname = optarg; break;
+        case 'a':
+            if (uds_tool_parse_ids(optarg, &phys, &resp) < 0) {
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 's': session = strtoul(optarg, NULL, 16); break;
+        case 'l': level = strtoul(optarg, NULL, 16); break;
+        case 'c': chunk = strtoul(optarg, NULL, 0); break;
+        case 'U': try_upload = 0; break;
+        case 'r': resume = 1; break;
+        case 'v': uds_tool_verbose = 1; break;
+        case 'o': out_path = optarg; break;
+        default: usage(argv[0]); return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (argc - optind != 2 || (level && !(level & 1))) {
+        usage(argv[0]);
+        return 1;
+    }
+    dump_out_t out = { .start = strtoul(argv[optind], NULL, 16),
+                       .size = strtoul(argv[optind + 1], NULL, 16) };
+    if (out.size == 0 || out.start + (uint64_t)out.size > 0x100000000ull) {
+        fprintf(stderr, "地址范围无效\n");
+        return 1;
+    }
+
+    if (uds_tool_init(ifname, phys, resp, "dump") < 0) {
+        return 1;
+    }
+    if ((session && uds_tool_change_session(session) < 0) || (level && uds_tool_unlock(level) < 0)) {
+        return 1;
+    }
+    if (open_output(&out, out_path, resume) < 0) {
+        return 1;
+    }
+    printf("[LOG] dump 0x%08X - 0x%08X 到 %s\n", out.start, out.start + out.size, out_path);
+
+    int ret = try_upload ? dump_upload(&out) : 1;
+    if (ret > 0) {
+        ret = dump_read(&out, chunk);
+    }
+    report_progress(&out, 1);
+    close(out.fd);
+    if (ret < 0 || uds_tool_stop) {
+        close(out.resume_fd);
+        fprintf(stderr, "dump未完成，可用 -r 从0x%08X继续\n", out.start + out.done);
+        return 1;
+    }
+    close(out.resume_fd);
+    char resume_path[4096];
+    snprintf(resume_path, sizeof(resume_path), "%s.resume", out_path);
+    unlink(resume_path);
+    return 0;
+}
@@ -0,0 +1,75 @@
+#ifndef UDS_ECU_H
+#define UDS_ECU_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// ECU模型：DID、会话、安全级别和内存区域的常量表，由uds_ecugen从ECU描述（默认ecu.json）
+// 生成到uds_ecu_model.c，uds_server只做查表，运行时不解析任何描述。
+// make ECU=variant.json 生成另一个变体的uds_server
+
+#define UDS_ECU_MAX_SESSIONS 32 // 会话掩码为uint32_t，按会话表下标置位
+
+typedef enum {
+    UDS_ECU_DID_STATIC,    // 固定内容，resp为预先序列化好的完整肯定响应（62 + DID + 数据）
+    UDS_ECU_DID_SELF_DIAG, // 0xFDxx自诊断，由服务器在读取时构造
+} uds_ecu_did_kind_t;
+
+typedef struct {
+    uint16_t id;
+    uint8_t kind;          // uds_ecu_did_kind_t
+    uint8_t min_level;     // 读取所需的安全级别，0为无需解锁
+    uint32_t session_mask; // 允许读取的会话
+    const uint8_t *resp;   // UDS_ECU_DID_STATIC
+    uint16_t resp_len;
+} uds_ecu_did_t;
+
+typedef struct {
+    uint8_t id;          // diagnosticSessionType
+    uint8_t resp[6];     // 预先序列化的肯定响应：50 id P2(ms) P2*(10ms)
+} uds_ecu_session_t;
+
+typedef struct {
+    uint8_t level;         // 请求seed的子功能（奇数），提交key为level + 1
+    uint32_t session_mask; // 允许解锁的会话
+    uint32_t (*key)(uint32_t seed);
+} uds_ecu_security_t;
+
+typedef enum {
+    UDS_ECU_REGION_ELF,    // 按偏移 addr - base 读服务器自身ELF文件，超出文件部分补零；文件未加载时直接读内存
+    UDS_ECU_REGION_MEMORY, // 直接读进程内存
+} uds_ecu_region_source_t;
+
+typedef struct {
+    uint32_t start;
+    uint32_t end; // 含
+    uint32_t base; // UDS_ECU_REGION_ELF：文件偏移0对应的地址
+    uint32_t max_read;
+    uint8_t min_level;
+    uint8_t source; // uds_ecu_region_source_t
+} uds_ecu_region_t;
+
+typedef struct {
+    const char *name;
+    const char *value;
+} uds_ecu_string_t;
+
+extern const char uds_ecu_name[];
+
+// 会话表，第0项为默认会话（S3超时后回到该会话）
+extern const uds_ecu_session_t uds_ecu_sessions[];
+extern const int uds_ecu_num_sessions;
+
+extern const uds_ecu_string_t uds_ecu_strings[]; // 描述中的全部字符串，启动时打印地址
+extern const int uds_ecu_num_strings;
+extern const char *const uds_ecu_boot_message; // 启动时广播，NULL为不发送
+
+extern const uint8_t uds_ecu_mem_min_level; // 所有内存区域中最低的读取级别，0x23先按它检查
+
+// 查找，未定义时返回NULL（会话返回-1）
+const uds_ecu_did_t *uds_ecu_did(uint16_t did);                 // 完美哈希
+int uds_ecu_session(uint8_t id);                                // 会话表下标
+const uds_ecu_security_t *uds_ecu_security(uint8_t level);      // 按奇数子功能
+const uds_ecu_region_t *uds_ecu_region(uint32_t addr);          // 按地址二分查找
+
+#endif
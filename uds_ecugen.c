@@ -0,0 +1,879 @@
+// ECU模型生成器：读取JSON格式的ECU描述，生成uds_ecu.h中声明的常量表（uds_ecu_model.c）
+//   ./uds_ecugen -o uds_ecu_model.c ecu.json
+// 输出内容不变时不改写文件，make每次运行生成器也不会触发重编
+//
+// 描述格式（数值可写成数字或"0x..."字符串）：
+//   name          变体名称
+//   strings       {名称: 字符串}，DID和boot_message按名称引用
+//   boot_message  启动时广播的字符串名称，可省略
+//   sessions      [{id, name, p2_ms, p2_star_ms}]，第一项为默认会话
+//   security      [{level（请求seed的奇数子功能）, key, sessions}]
+//                 key为uds_key.h中的函数名，或运算列表
+//                 [["xor"|"add"|"sub"|"rol"|"ror", 值], ["not"]]，按顺序作用于seed
+//   dids          [{id, string | data（十六进制字节）| self_diag: true, min_level, sessions}]
+//   regions       [{name, start, end, source: "elf"|"memory", base, max_read, min_level}]
+//   sessions字段列出会话名称或ID，省略表示全部会话
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <ctype.h>
+#include <errno.h>
+#include <unistd.h>
+
+#define MAX_SESSIONS 32     // 与UDS_ECU_MAX_SESSIONS一致
+#define MAX_MEM_READ 0x1000 // 服务器0x23响应缓冲的上限
+
+// ---------------------------------------------------------------------------
+// JSON
+// ---------------------------------------------------------------------------
+
+typedef enum { J_NULL, J_BOOL, J_NUM, J_STR, J_ARR, J_OBJ } jtype_t;
+
+typedef struct jnode {
+    jtype_t type;
+    int line;
+    double num;
+    char *str;            // J_STR的值
+    char *key;            // 对象成员的键
+    struct jnode *child;  // J_ARR/J_OBJ的第一个元素
+    struct jnode *next;
+    int len;              // J_ARR/J_OBJ的元素数
+} jnode_t;
+
+static const char *g_path;
+static const char *g_pos;
+static int g_line = 1;
+
+static void die(int line, const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    fprintf(stderr, "%s:%d: ", g_path, line);
+    vfprintf(stderr, fmt, ap);
+    fprintf(stderr, "\n");
+    va_end(ap);
+    exit(1);
+}
+
+static void skip_ws(void) {
+    while (*g_pos == ' ' || *g_pos == '\t' || *g_pos == '\r' || *g_pos == '\n') {
+        if (*g_pos == '\n') {
+            g_line++;
+        }
+        g_pos++;
+    }
+}
+
+static jnode_t *new_node(jtype_t type) {
+    jnode_t *n = calloc(1, sizeof(*n));
+    if (!n) {
+        perror("calloc");
+        exit(1);
+    }
+    n->type = type;
+    n->line = g_line;
+    return n;
+}
+
+static char *parse_string_raw(void) {
+    size_t cap = 32, len = 0;
+    char *s = malloc(cap);
+    g_pos++; // "
+    for (;;) {
+        char c = *g_pos++;
+        if (c == '\0' || c == '\n') {
+            die(g_line, "字符串未结束");
+        }
+        if (c == '"') {
+            break;
+        }
+        if (c == '\\') {
+            c = *g_pos++;
+            switch (c) {
+            case '"': case '\\': case '/': break;
+            case 'n': c = '\n'; break;
+            case 't': c = '\t'; break;
+            case 'r': c = '\r'; break;
+            case 'u': {
+                unsigned v;
+                if (sscanf(g_pos, "%4x", &v) != 1 || v > 0x7F) {
+                    die(g_line, "只支持ASCII范围的\\u转义");
+                }
+                g_pos += 4;
+                c = (char)v;
+                break;
+            }
+            default:
+                die(g_line, "无效的转义 \\%c", c);
+            }
+        }
+        if (len + 2 > cap) {
+            cap *= 2;
+            s = realloc(s, cap);
+        }
+        s[len++] = c;
+    }
+    s[len] = '\0';
+    return s;
+}
+
+static jnode_t *parse_value(void) {
+    skip_ws();
+    jnode_t *n;
+    if (*g_pos == '{' || *g_pos == '[') {
+        int obj = *g_pos == '{';
+        n = new_node(obj ? J_OBJ : J_ARR);
+        g_pos++;
+        jnode_t **tail = &n->child;
+        skip_ws();
+        if (*g_pos == (obj ? '}' : ']')) {
+            g_pos++;
+            return n;
+        }
+        for (;;) {
+            char *key = NULL;
+            if (obj) {
+                skip_ws();
+                if (*g_pos != '"') {
+                    die(g_line, "应为成员名");
+                }
+                key = parse_string_raw();
+                skip_ws();
+                if (*g_pos++ != ':') {
+                    die(g_line, "成员名后应为':'");
+                }
+            }
+            jnode_t *v = parse_value();
+            v->key = key;
+            *tail = v;
+            tail = &v->next;
+            n->len++;
+            skip_ws();
+            if (*g_pos == ',') {
+                g_pos++;
+                continue;
+            }
+            if (*g_pos++ != (obj ? '}' : ']')) {
+                die(g_line, obj ? "应为','或'}'" : "应为','或']'");
+            }
+            return n;
+        }
+    }
+    if (*g_pos == '"') {
+        n = new_node(J_STR);
+        n->str = parse_string_raw();
+        return n;
+    }
+    if (!strncmp(g_pos, "true", 4) || !strncmp(g_pos, "false", 5)) {
+        n = new_node(J_BOOL);
+        n->num = *g_pos == 't';
+        g_pos += n->num ? 4 : 5;
+        return n;
+    }
+    if (!strncmp(g_pos, "null", 4)) {
+        g_pos += 4;
+        return new_node(J_NULL);
+    }
+    if (*g_pos == '-' || isdigit((unsigned char)*g_pos)) {
+        n = new_node(J_NUM);
+        char *end;
+        n->num = strtod(g_pos, &end);
+        g_pos = end;
+        return n;
+    }
+    die(g_line, "无法解析的值");
+    return NULL;
+}
+
+static const char *jstr(const jnode_t *n) { return n->str; }
+
+static const jnode_t *jget(const jnode_t *obj, const char *key) {
+    for (const jnode_t *c = obj->child; c; c = c->next) {
+        if (!strcmp(c->key, key)) {
+            return c;
+        }
+    }
+    return NULL;
+}
+
+static void check_keys(const jnode_t *obj, const char *what, const char *const *keys) {
+    for (const jnode_t *c = obj->child; c; c = c->next) {
+        int ok = 0;
+        for (int i = 0; keys[i]; i++) {
+            ok |= !strcmp(c->key, keys[i]);
+        }
+        if (!ok) {
+            die(c->line, "%s: 未知字段 \"%s\"", what, c->key);
+        }
+    }
+}
+
+static const jnode_t *expect(const jnode_t *n, jtype_t type, const char *what) {
+    static const char *names[] = {"null", "布尔值", "数值", "字符串", "数组", "对象"};
+    if (!n || n->type != type) {
+        die(n ? n->line : g_line, "%s应为%s", what, names[type]);
+    }
+    return n;
+}
+
+// 数字或"0x..."字符串
+static uint32_t juint(const jnode_t *n, const char *what, uint32_t max) {
+    uint64_t v;
+    if (n && n->type == J_NUM && n->num >= 0 && n->num == (uint64_t)n->num) {
+        v = (uint64_t)n->num;
+    } else if (n && n->type == J_STR) {
+        char *end;
+        errno = 0;
+        v = strtoull(jstr(n), &end, 0);
+        if (errno || *end || end == jstr(n)) {
+            die(n->line, "%s: 无效的数值 \"%s\"", what, jstr(n));
+        }
+    } else {
+        die(n ? n->line : g_line, "%s应为非负整数", what);
+        return 0;
+    }
+    if (v > max) {
+        die(n->line, "%s超出范围 (最大0x%X)", what, max);
+    }
+    return (uint32_t)v;
+}
+
+static uint32_t juint_opt(const jnode_t *obj, const char *key, uint32_t def, uint32_t max) {
+    const jnode_t *n = jget(obj, key);
+    return n ? juint(n, key, max) : def;
+}
+
+// ---------------------------------------------------------------------------
+// 模型
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    const char *name;
+    const char *value;
+} str_t;
+
+typedef struct {
+    uint8_t id;
+    const char *name;
+    uint16_t p2_ms;
+    uint16_t p2_star_10ms;
+} session_t;
+
+typedef struct {
+    uint8_t level;
+    uint32_t session_mask;
+    const char *key_fn;  // uds_key.h中的函数
+    const jnode_t *ops;  // 或运算列表
+} security_t;
+
+typedef struct {
+    uint16_t id;
+    int self_diag;
+    uint8_t min_level;
+    uint32_t session_mask;
+    const uint8_t *data;
+    size_t len;
+    const char *string; // 引用的字符串名称，用于注释
+} did_t;
+
+typedef struct {
+    const char *name;
+    uint32_t start, end, base, max_read;
+    uint8_t min_level;
+    int elf;
+    int line;
+} region_t;
+
+static str_t *g_strings;
+static int g_num_strings;
+static session_t g_sessions[MAX_SESSIONS];
+static int g_num_sessions;
+static security_t *g_security;
+static int g_num_security;
+static did_t *g_dids;
+static int g_num_dids;
+static region_t *g_regions;
+static int g_num_regions;
+
+static const str_t *find_string(const jnode_t *n, const char *what) {
+    const char *name = jstr(expect(n, J_STR, what));
+    for (int i = 0; i < g_num_strings; i++) {
+        if (!strcmp(g_strings[i].name, name)) {
+            return &g_strings[i];
+        }
+    }
+    die(n->line, "%s: 未定义的字符串 \"%s\"", what, name);
+    return NULL;
+}
+
+static int is_ident(const char *s) {
+    if (!isalpha((unsigned char)*s) && *s != '_') {
+        return 0;
+    }
+    for (; *s; s++) {
+        if (!isalnum((unsigned char)*s) && *s != '_') {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static uint32_t all_sessions(void) {
+    return g_num_sessions == 32 ? 0xFFFFFFFFu : (1u << g_num_sessions) - 1;
+}
+
+// 会话名称或ID列表 -> 会话掩码
+static uint32_t session_mask(const jnode_t *obj) {
+    const jnode_t *list = jget(obj, "sessions");
+    if (!list) {
+        return all_sessions();
+    }
+    expect(list, J_ARR, "sessions");
+    uint32_t mask = 0;
+    for (const jnode_t *s = list->child; s; s = s->next) {
+        int found = -1;
+        for (int i = 0; i < g_num_sessions; i++) {
+            if ((s->type == J_STR && !strcmp(jstr(s), g_sessions[i].name)) ||
+                ((s->type == J_NUM || (s->type == J_STR && isdigit((unsigned char)jstr(s)[0]))) &&
+                 juint(s, "会话", 0x7F) == g_sessions[i].id)) {
+                found = i;
+            }
+        }
+        if (found < 0) {
+            die(s->line, "未定义的会话");
+        }
+        mask |= 1u << found;
+    }
+    return mask;
+}
+
+static uint8_t *parse_hex(const jnode_t *n, size_t *len) {
+    const char *s = jstr(expect(n, J_STR, "data"));
+    size_t slen = strlen(s);
+    if (slen % 2) {
+        die(n->line, "data: 十六进制字节数应为偶数");
+    }
+    uint8_t *out = malloc(slen / 2 + 1);
+    for (size_t i = 0; i < slen / 2; i++) {
+        unsigned v;
+        if (!isxdigit((unsigned char)s[2 * i]) || !isxdigit((unsigned char)s[2 * i + 1]) ||
+            sscanf(s + 2 * i, "%2x", &v) != 1) {
+            die(n->line, "data: 无效的十六进制字节");
+        }
+        out[i] = v;
+    }
+    *len = slen / 2;
+    return out;
+}
+
+static void load_model(const jnode_t *root) {
+    static const char *const top_keys[] = {"name", "strings", "boot_message", "sessions",
+                                           "security", "dids", "regions", NULL};
+    expect(root, J_OBJ, "ECU描述");
+    check_keys(root, "ECU描述", top_keys);
+
+    const jnode_t *strings = jget(root, "strings");
+    if (strings) {
+        expect(strings, J_OBJ, "strings");
+        g_strings = calloc(strings->len + 1, sizeof(*g_strings));
+        for (const jnode_t *s = strings->child; s; s = s->next) {
+            if (!is_ident(s->key)) {
+                die(s->line, "字符串名称应为C标识符: \"%s\"", s->key);
+            }
+            for (int i = 0; i < g_num_strings; i++) {
+                if (!strcmp(g_strings[i].name, s->key)) {
+                    die(s->line, "重复的字符串 \"%s\"", s->key);
+                }
+            }
+            g_strings[g_num_strings].name = s->key;
+            g_strings[g_num_strings].value = jstr(expect(s, J_STR, s->key));
+            g_num_strings++;
+        }
+    }
+
+    const jnode_t *sessions = expect(jget(root, "sessions"), J_ARR, "sessions");
+    if (sessions->len < 1 || sessions->len > MAX_SESSIONS) {
+        die(sessions->line, "sessions: 需要1到%d个会话", MAX_SESSIONS);
+    }
+    for (const jnode_t *s = sessions->child; s; s = s->next) {
+        static const char *const keys[] = {"id", "name", "p2_ms", "p2_star_ms", NULL};
+        expect(s, J_OBJ, "会话");
+        check_keys(s, "会话", keys);
+        session_t *ss = &g_sessions[g_num_sessions];
+        ss->id = juint(jget(s, "id"), "会话id", 0x7F);
+        ss->name = jget(s, "name") ? jstr(expect(jget(s, "name"), J_STR, "会话name")) : "";
+        ss->p2_ms = juint_opt(s, "p2_ms", 50, 0xFFFF);
+        ss->p2_star_10ms = juint_opt(s, "p2_star_ms", 5000, 0xFFFF * 10) / 10;
+        if (ss->id == 0) {
+            die(s->line, "会话id不能为0");
+        }
+        for (int i = 0; i < g_num_sessions; i++) {
+            if (g_sessions[i].id == ss->id || (*ss->name && !strcmp(g_sessions[i].name, ss->name))) {
+                die(s->line, "重复的会话");
+            }
+        }
+        g_num_sessions++;
+    }
+
+    const jnode_t *security = jget(root, "security");
+    if (security) {
+        expect(security, J_ARR, "security");
+        g_security = calloc(security->len + 1, sizeof(*g_security));
+        for (const jnode_t *s = security->child; s; s = s->next) {
+            static const char *const keys[] = {"level", "key", "sessions", NULL};
+            expect(s, J_OBJ, "安全级别");
+            check_keys(s, "安全级别", keys);
+            security_t *sec = &g_security[g_num_security];
+            sec->level = juint(jget(s, "level"), "level", 0x7D);
+            if (!(sec->level & 1)) {
+                die(s->line, "level应为请求seed的奇数子功能");
+            }
+            for (int i = 0; i < g_num_security; i++) {
+                if (g_security[i].level == sec->level) {
+                    die(s->line, "重复的安全级别 0x%02X", sec->level);
+                }
+            }
+            const jnode_t *key = jget(s, "key");
+            if (key && key->type == J_STR) {
+                if (!is_ident(jstr(key))) {
+                    die(key->line, "key应为函数名");
+                }
+                sec->key_fn = jstr(key);
+            } else if (key && key->type == J_ARR) {
+                for (const jnode_t *op = key->child; op; op = op->next) {
+                    expect(op, J_ARR, "key运算");
+                    const char *name = jstr(expect(op->child, J_STR, "key运算名"));
+                    int unary = !strcmp(name, "not");
+                    int shift = !strcmp(name, "rol") || !strcmp(name, "ror");
+                    if (!unary && !shift && strcmp(name, "xor") && strcmp(name, "add") &&
+                        strcmp(name, "sub")) {
+                        die(op->line, "未知的key运算 \"%s\"", name);
+                    }
+                    if (op->len != (unary ? 1 : 2)) {
+                        die(op->line, "key运算 \"%s\" 的参数个数不对", name);
+                    }
+                    if (!unary) {
+                        juint(op->child->next, name, shift ? 31 : 0xFFFFFFFFu);
+                    }
+                }
+                sec->ops = key;
+            } else {
+                die(s->line, "key应为函数名或运算列表");
+            }
+            sec->session_mask = session_mask(s);
+            g_num_security++;
+        }
+    }
+
+    const jnode_t *dids = expect(jget(root, "dids"), J_ARR, "dids");
+    if (dids->len < 1 || dids->len > 0xFFFF) {
+        die(dids->line, "dids: 至少需要一个DID");
+    }
+    g_dids = calloc(dids->len, sizeof(*g_dids));
+    for (const jnode_t *d = dids->child; d; d = d->next) {
+        static const char *const keys[] = {"id", "string", "data", "self_diag", "min_level",
+                                           "sessions", NULL};
+        expect(d, J_OBJ, "DID");
+        check_keys(d, "DID", keys);
+        did_t *did = &g_dids[g_num_dids];
+        did->id = juint(jget(d, "id"), "DID id", 0xFFFF);
+        did->min_level = juint_opt(d, "min_level", 0, 0x7F);
+        did->session_mask = session_mask(d);
+        const jnode_t *str = jget(d, "string"), *data = jget(d, "data"), *sd = jget(d, "self_diag");
+        if ((str != NULL) + (data != NULL) + (sd != NULL) != 1) {
+            die(d->line, "DID 0x%04X: string、data、self_diag需且仅需一个", did->id);
+        }
+        if (str) {
+            const str_t *s = find_string(str, "string");
+            did->data = (const uint8_t *)s->value;
+            did->len = strlen(s->value);
+            did->string = s->name;
+        } else if (data) {
+            did->data = parse_hex(data, &did->len);
+        } else {
+            did->self_diag = expect(sd, J_BOOL, "self_diag")->num != 0;
+            if (!did->self_diag || (did->id >> 8) != 0xFD) {
+                die(sd->line, "self_diag只用于0xFDxx");
+            }
+        }
+        if (3 + did->len > MAX_MEM_READ + 2) {
+            die(d->line, "DID 0x%04X: 数据过长", did->id);
+        }
+        for (int i = 0; i < g_num_dids; i++) {
+            if (g_dids[i].id == did->id) {
+                die(d->line, "重复的DID 0x%04X", did->id);
+            }
+        }
+        g_num_dids++;
+    }
+
+    const jnode_t *regions = jget(root, "regions");
+    if (regions) {
+        expect(regions, J_ARR, "regions");
+        g_regions = calloc(regions->len + 1, sizeof(*g_regions));
+        for (const jnode_t *r = regions->child; r; r = r->next) {
+            static const char *const keys[] = {"name", "start", "end", "source", "base",
+                                               "max_read", "min_level", NULL};
+            expect(r, J_OBJ, "内存区域");
+            check_keys(r, "内存区域", keys);
+            region_t *rg = &g_regions[g_num_regions];
+            rg->line = r->line;
+            rg->name = jget(r, "name") ? jstr(expect(jget(r, "name"), J_STR, "name")) : "";
+            rg->start = juint(jget(r, "start"), "start", 0xFFFFFFFFu);
+            rg->end = juint(jget(r, "end"), "end", 0xFFFFFFFFu);
+            rg->base = juint_opt(r, "base", rg->start, 0xFFFFFFFFu);
+            rg->max_read = juint_opt(r, "max_read", MAX_MEM_READ, MAX_MEM_READ);
+            rg->min_level = juint_opt(r, "min_level", 0, 0x7F);
+            const char *src = jstr(expect(jget(r, "source"), J_STR, "source"));
+            if (!strcmp(src, "elf")) {
+                rg->elf = 1;
+            } else if (strcmp(src, "memory")) {
+                die(r->line, "source应为\"elf\"或\"memory\"");
+            }
+            if (rg->end < rg->start || (rg->elf && rg->base > rg->start)) {
+                die(r->line, "区域 %s: 地址范围无效", rg->name);
+            }
+            g_num_regions++;
+        }
+    }
+
+    const jnode_t *boot = jget(root, "boot_message");
+    if (boot) {
+        find_string(boot, "boot_message");
+    }
+}
+
+static int cmp_did(const void *a, const void *b) {
+    return (int)((const did_t *)a)->id - (int)((const did_t *)b)->id;
+}
+
+static int cmp_region(const void *a, const void *b) {
+    uint32_t x = ((const region_t *)a)->start, y = ((const region_t *)b)->start;
+    return x < y ? -1 : x > y;
+}
+
+// 乘法哈希 (did * mul) >> (32 - bits)，从能放下全部DID的最小表开始，最多放大到8倍
+static void find_hash(uint32_t *mul, int *bits) {
+    int b = 1;
+    while ((1 << b) < g_num_dids) {
+        b++;
+    }
+    uint8_t *used = malloc(1u << (b + 3));
+    for (int extra = 0; extra <= 3; extra++, b++) {
+        for (uint32_t k = 0; k < 65536; k++) {
+            uint32_t m = 0x9E3779B1u + 2 * k;
+            memset(used, 0, 1u << b);
+            int i;
+            for (i = 0; i < g_num_dids; i++) {
+                uint32_t h = (uint32_t)(g_dids[i].id * m) >> (32 - b);
+                if (used[h]++) {
+                    break;
+                }
+            }
+            if (i == g_num_dids) {
+                *mul = m;
+                *bits = b;
+                free(used);
+                return;
+            }
+        }
+    }
+    fprintf(stderr, "%s: 找不到DID集合的完美哈希\n", g_path);
+    exit(1);
+}
+
+// ---------------------------------------------------------------------------
+// 输出
+// ---------------------------------------------------------------------------
+
+static void emit_cstring(FILE *out, const char *s) {
+    fputc('"', out);
+    for (; *s; s++) {
+        unsigned char c = *s;
+        if (c == '"' || c == '\\') {
+            fprintf(out, "\\%c", c);
+        } else if (c == '\n') {
+            fputs("\\n", out);
+        } else if (c < 0x20 || c >= 0x7F) {
+            fprintf(out, "\\%03o", c);
+        } else {
+            fputc(c, out);
+        }
+    }
+    fputc('"', out);
+}
+
+static void emit_key_fn(FILE *out, const security_t *sec) {
+    fprintf(out, "static uint32_t key_level_%02x(uint32_t seed) {\n", sec->level);
+    fprintf(out, "    uint32_t key = seed;\n");
+    for (const jnode_t *op = sec->ops->child; op; op = op->next) {
+        const char *name = jstr(op->child);
+        if (!strcmp(name, "not")) {
+            fprintf(out, "    key = ~key;\n");
+            continue;
+        }
+        uint32_t v = juint(op->child->next, name, 0xFFFFFFFFu);
+        if (!strcmp(name, "xor")) {
+            fprintf(out, "    key ^= 0x%08Xu;\n", v);
+        } else if (!strcmp(name, "add")) {
+            fprintf(out, "    key += 0x%08Xu;\n", v);
+        } else if (!strcmp(name, "sub")) {
+            fprintf(out, "    key -= 0x%08Xu;\n", v);
+        } else if (v == 0) {
+            continue;
+        } else if (!strcmp(name, "rol")) {
+            fprintf(out, "    key = (key << %u) | (key >> %u);\n", v, 32 - v);
+        } else {
+            fprintf(out, "    key = (key >> %u) | (key << %u);\n", v, 32 - v);
+        }
+    }
+    fprintf(out, "    return key;\n}\n\n");
+}
+
+static void emit(FILE *out, const jnode_t *root) {
+    const jnode_t *name = jget(root, "name");
+    const jnode_t *boot = jget(root, "boot_message");
+
+    fprintf(out, "// 由uds_ecugen从%s生成，不要手工修改\n", g_path);
+    fprintf(out, "#include <stddef.h>\n#include \"uds_ecu.h\"\n#include \"uds_key.h\"\n\n");
+    fprintf(out, "const char uds_ecu_name[] = ");
+    emit_cstring(out, name ? jstr(expect(name, J_STR, "name")) : "");
+    fprintf(out, ";\n\n");
+
+    // 字符串：具名的全局常量，保留在ELF中
+    for (int i = 0; i < g_num_strings; i++) {
+        fprintf(out, "const char uds_ecu_str_%s[] = ", g_strings[i].name);
+        emit_cstring(out, g_strings[i].value);
+        fprintf(out, ";\n");
+    }
+    fprintf(out, "\nconst uds_ecu_string_t uds_ecu_strings[] = {\n");
+    for (int i = 0; i < g_num_strings; i++) {
+        fprintf(out, "    {\"%s\", uds_ecu_str_%s},\n", g_strings[i].name, g_strings[i].name);
+    }
+    if (!g_num_strings) {
+        fprintf(out, "    {NULL, NULL},\n");
+    }
+    fprintf(out, "};\nconst int uds_ecu_num_strings = %d;\n", g_num_strings);
+    if (boot) {
+        fprintf(out, "const char *const uds_ecu_boot_message = uds_ecu_str_%s;\n\n", jstr(boot));
+    } else {
+        fprintf(out, "const char *const uds_ecu_boot_message = NULL;\n\n");
+    }
+
+    // 会话：预先序列化的0x10肯定响应，ID到下标的直接索引表
+    fprintf(out, "const uds_ecu_session_t uds_ecu_sessions[] = {\n");
+    for (int i = 0; i < g_num_sessions; i++) {
+        const session_t *s = &g_sessions[i];
+        fprintf(out, "    {0x%02X, {0x50, 0x%02X, 0x%02X, 0x%02X, 0x%02X, 0x%02X}}, // %s\n", s->id,
+                s->id, s->p2_ms >> 8, s->p2_ms & 0xFF, s->p2_star_10ms >> 8,
+                s->p2_star_10ms & 0xFF, s->name);
+    }
+    fprintf(out, "};\nconst int uds_ecu_num_sessions = %d;\n\n", g_num_sessions);
+    fprintf(out, "static const uint8_t session_index[0x80] = { // 下标 + 1\n");
+    for (int i = 0; i < g_num_sessions; i++) {
+        fprintf(out, "    [0x%02X] = %d,\n", g_sessions[i].id, i + 1);
+    }
+    fprintf(out, "};\n\nint uds_ecu_session(uint8_t id) {\n"
+                 "    return id < 0x80 ? session_index[id] - 1 : -1;\n}\n\n");
+
+    // 安全级别
+    for (int i = 0; i < g_num_security; i++) {
+        if (g_security[i].ops) {
+            emit_key_fn(out, &g_security[i]);
+        }
+    }
+    fprintf(out, "static const uds_ecu_security_t security[] = {\n");
+    for (int i = 0; i < g_num_security; i++) {
+        const security_t *s = &g_security[i];
+        fprintf(out, "    {0x%02X, 0x%08Xu, ", s->level, s->session_mask);
+        if (s->ops) {
+            fprintf(out, "key_level_%02x},\n", s->level);
+        } else {
+            fprintf(out, "%s},\n", s->key_fn);
+        }
+    }
+    if (!g_num_security) {
+        fprintf(out, "    {0, 0, NULL},\n");
+    }
+    fprintf(out, "};\n\nstatic const uint8_t security_index[0x80] = { // 下标 + 1\n");
+    for (int i = 0; i < g_num_security; i++) {
+        fprintf(out, "    [0x%02X] = %d,\n", g_security[i].level, i + 1);
+    }
+    fprintf(out, "};\n\nconst uds_ecu_security_t *uds_ecu_security(uint8_t level) {\n"
+                 "    uint8_t i = level < 0x80 ? security_index[level] : 0;\n"
+                 "    return i ? &security[i - 1] : NULL;\n}\n\n");
+
+    // DID：按ID排序，静态DID为完整的肯定响应
+    qsort(g_dids, g_num_dids, sizeof(*g_dids), cmp_did);
+    for (int i = 0; i < g_num_dids; i++) {
+        const did_t *d = &g_dids[i];
+        if (d->self_diag) {
+            continue;
+        }
+        fprintf(out, "static const uint8_t did_%04X[%zu] = { // ", d->id, 3 + d->len);
+        if (d->string) {
+            fprintf(out, "%s", d->string);
+        }
+        fprintf(out, "\n    0x62, 0x%02X, 0x%02X,", d->id >> 8, d->id & 0xFF);
+        for (size_t j = 0; j < d->len; j++) {
+            fprintf(out, "%s0x%02X,", (j + 3) % 12 == 0 ? "\n    " : " ", d->data[j]);
+        }
+        fprintf(out, "\n};\n");
+    }
+    fprintf(out, "\nstatic const uds_ecu_did_t dids[] = {\n");
+    for (int i = 0; i < g_num_dids; i++) {
+        const did_t *d = &g_dids[i];
+        if (d->self_diag) {
+            fprintf(out, "    {0x%04X, UDS_ECU_DID_SELF_DIAG, %u, 0x%08Xu, NULL, 0},\n", d->id,
+                    d->min_level, d->session_mask);
+        } else {
+            fprintf(out, "    {0x%04X, UDS_ECU_DID_STATIC, %u, 0x%08Xu, did_%04X, %zu},\n", d->id,
+                    d->min_level, d->session_mask, d->id, 3 + d->len);
+        }
+    }
+    uint32_t mul;
+    int bits;
+    find_hash(&mul, &bits);
+    const char *slot_type = g_num_dids < 0xFF ? "uint8_t" : "uint16_t";
+    fprintf(out, "};\n\nstatic const %s did_slot[%d] = { // 完美哈希槽，下标 + 1\n", slot_type,
+            1 << bits);
+    for (int i = 0; i < g_num_dids; i++) {
+        uint32_t h = (uint32_t)(g_dids[i].id * mul) >> (32 - bits);
+        fprintf(out, "    [%u] = %d, // 0x%04X\n", h, i + 1, g_dids[i].id);
+    }
+    fprintf(out, "};\n\nconst uds_ecu_did_t *uds_ecu_did(uint16_t did) {\n"
+                 "    %s i = did_slot[(uint32_t)(did * 0x%08Xu) >> %d];\n"
+                 "    return i && dids[i - 1].id == did ? &dids[i - 1] : NULL;\n}\n\n",
+            slot_type, mul, 32 - bits);
+
+    // 内存区域：按起始地址排序，二分查找
+    qsort(g_regions, g_num_regions, sizeof(*g_regions), cmp_region);
+    uint8_t mem_min_level = 0;
+    for (int i = 0; i < g_num_regions; i++) {
+        if (i > 0 && g_regions[i].start <= g_regions[i - 1].end) {
+            die(g_regions[i].line, "内存区域 %s 与 %s 重叠", g_regions[i].name,
+                g_regions[i - 1].name);
+        }
+        if (i == 0 || g_regions[i].min_level < mem_min_level) {
+            mem_min_level = g_regions[i].min_level;
+        }
+    }
+    fprintf(out, "static const uds_ecu_region_t regions[] = {\n");
+    for (int i = 0; i < g_num_regions; i++) {
+        const region_t *r = &g_regions[i];
+        fprintf(out, "    {0x%08Xu, 0x%08Xu, 0x%08Xu, %u, %u, %s}, // %s\n", r->start, r->end,
+                r->base, r->max_read, r->min_level,
+                r->elf ? "UDS_ECU_REGION_ELF" : "UDS_ECU_REGION_MEMORY", r->name);
+    }
+    if (!g_num_regions) {
+        fprintf(out, "    {0, 0, 0, 0, 0, 0},\n");
+    }
+    fprintf(out, "};\n\nconst uint8_t uds_ecu_mem_min_level = %u;\n\n", mem_min_level);
+    fprintf(out, "const uds_ecu_region_t *uds_ecu_region(uint32_t addr) {\n"
+                 "    int lo = 0, hi = %d;\n"
+                 "    while (lo < hi) {\n"
+                 "        int mid = (lo + hi) / 2;\n"
+                 "        if (addr < regions[mid].start) {\n"
+                 "            hi = mid;\n"
+                 "        } else if (addr > regions[mid].end) {\n"
+                 "            lo = mid + 1;\n"
+                 "        } else {\n"
+                 "            return &regions[mid];\n"
+                 "        }\n"
+                 "    }\n"
+                 "    return NULL;\n}\n",
+            g_num_regions);
+}
+
+// 内容与现有文件相同时不改写，保持时间戳
+static int write_if_changed(const char *path, const char *buf, size_t len) {
+    FILE *f = fopen(path, "rb");
+    if (f) {
+        char *old = malloc(len + 1);
+        size_t n = fread(old, 1, len + 1, f);
+        fclose(f);
+        int same = n == len && !memcmp(old, buf, len);
+        free(old);
+        if (same) {
+            return 0;
+        }
+    }
+    char tmp[4096];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    f = fopen(tmp, "wb");
+    if (!f || fwrite(buf, 1, len, f) != len || fclose(f) != 0) {
+        perror(tmp);
+        return -1;
+    }
+    if (rename(tmp, path) != 0) {
+        perror(path);
+        return -1;
+    }
+    return 1;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "用法: %s [-o uds_ecu_model.c] ecu.json\n", prog);
+}
+
+int main(int argc, char **argv) {
+    const char *out_path = NULL;
+    int opt;
+    while ((opt = getopt(argc, argv, "o:h")) != -1) {
+        switch (opt) {
+        case 'o': out_path = optarg; break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (optind != argc - 1) {
+        usage(argv[0]);
+        return 1;
+    }
+    g_path = argv[optind];
+
+    FILE *f = fopen(g_path, "rb");
+    if (!f) {
+        perror(g_path);
+        return 1;
+    }
+    size_t cap = 4096, len = 0, n;
+    char *src = malloc(cap);
+    while ((n = fread(src + len, 1, cap - len - 1, f)) > 0) {
+        len += n;
+        if (len + 1 == cap) {
+            cap *= 2;
+            src = realloc(src, cap);
+        }
+    }
+    fclose(f);
+    src[len] = '\0';
+    g_pos = src;
+
+    jnode_t *root = parse_value();
+    skip_ws();
+    if (*g_pos) {
+        die(g_line, "多余的内容");
+    }
+    load_model(root);
+
+    char *buf = NULL;
+    size_t buf_len = 0;
+    FILE *out = open_memstream(&buf, &buf_len);
+    emit(out, root);
+    fclose(out);
+
+    if (!out_path) {
+        fwrite(buf, 1, buf_len, stdout);
+        return 0;
+    }
+    int r = write_if_changed(out_path, buf, buf_len);
+    if (r < 0) {
+        return 1;
+    }
+    fprintf(stderr, "[LOG] %s: %d个DID，%d个会话，%d个安全级别，%d个内存区域%s\n", out_path,
+            g_num_dids, g_num_sessions, g_num_security, g_num_regions, r ? "" : "（未变化）");
+    return 0;
+}
@@ -0,0 +1,66 @@
+#include "uds_key.h"
+
+uint32_t calc_key(uint32_t seed) {
+    return seed ^ 0xdeadbeef;
+}
+
+uint32_t calc_key_level3(uint32_t seed) {
+    // 更复杂的级别3密钥算法
+    uint32_t key = seed;
+    
+    // 步骤1: 循环左移
+    key = (key << 7) | (key >> 25);
+    
+    // 步骤2: 异或操作
+    key ^= 0xCAFEBABE;
+    
+    // 步骤3: 加法运算
+    key += 0x12345678;
+    
+    // 步骤4: 位运算
+    key = (key & 0xFFFF0000) | ((key & 0x0000FFFF) ^ 0xABCD);
+    
+    // 步骤5: 最终异或
+    key ^= 0xDEADBEEF;
+    
+    return key;
+}
+
+uint32_t calc_key_level5(uint32_t seed) {
+    // 级别5密钥算法 - 更复杂
+    uint32_t key = seed;
+    
+    // 步骤1: 多重异或
+    key ^= 0x12345678;
+    key ^= 0x87654321;
+    
+    // 步骤2: 循环右移
+    key = (key >> 13) | (key << 19);
+    
+    // 步骤3: 位运算
+    key = (key & 0xFF00FF00) | ((key & 0x00FF00FF) ^ 0x55555555);
+    
+    // 步骤4: 加法运算
+    key += 0xDEADBEEF;
+    
+    // 步骤5: 最终异或
+    key ^= 0xCAFEBABE;
+    
+    return key;
+}
+
+int uds_key_for_level(uint8_t level, uint32_t seed, uint32_t *key) {
+    switch (level) {
+    case 0x01:
+        *key = calc_key(seed);
+        return 0;
+    case 0x03:
+        *key = calc_key_level3(seed);
+        return 0;
+    case 0x05:
+        *key = calc_key_level5(seed);
+        return 0;
+    default:
+        return -1;
+    }
+}
@@ -0,0 +1,14 @@
+#ifndef UDS_KEY_H
+#define UDS_KEY_H
+
+#include <stdint.h>
+
+// 0x27各安全级别的key算法，服务器校验与客户端工具解锁共用
+uint32_t calc_key(uint32_t seed);
+uint32_t calc_key_level3(uint32_t seed);
+uint32_t calc_key_level5(uint32_t seed);
+
+// 按请求seed的子功能（0x01/0x03/0x05）计算key，不支持的级别返回-1
+int uds_key_for_level(uint8_t level, uint32_t seed, uint32_t *key);
+
+#endif
@@ -0,0 +1,729 @@
+// 多线程UDS负载发生器：每个虚拟诊断仪是一个UDSClient_t，经isotp-c SocketCAN传输收发，
+// 使用独立的CAN ID对和带过滤器的CAN_RAW套接字，按场景脚本循环发送请求
+//   闭环（默认）：诊断仪收到响应后立即发送下一个请求
+//   开环（-r）：按固定总速率为每个诊断仪排定发送时刻，诊断仪仍在等待响应时请求顺延；
+//              延迟从排定时刻算起，服务器变慢造成的排队计入延迟（校正协调遗漏）
+// 单个uds_server只应答一对ID，多个诊断仪需要对应数量的服务器实例（uds_server -a phys:resp）
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <time.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <linux/can.h>
+#include <linux/can/raw.h>
+#include "iso14229.h"
+#include "uds_key.h"
+#include "uds_stats.h"
+
+#define LOAD_MAX_TESTERS 512
+#define LOAD_MAX_THREADS 64
+#define LOAD_MAX_STEPS 32
+#define LOAD_MAX_REQ 64
+#define LOAD_MAX_READ (UDS_ISOTP_MTU - 2) // 0x63 + 格式字节 + 数据须放入一个ISO-TP报文
+#define LOAD_RETRY_MS 100                 // 出错后重新执行场景前的等待
+#define LOAD_DEFAULT_SCRIPT "session 01; unlock 05; loop; rdbi F190; read 40000000 400; tester"
+
+// ============== 场景脚本 ==============
+enum {
+    STEP_SESSION,
+    STEP_UNLOCK,
+    STEP_RDBI,
+    STEP_READ,
+    STEP_TESTER,
+    STEP_RAW,
+    STEP_WAIT,
+    STEP_KINDS,
+};
+
+static const char *const g_step_names[STEP_KINDS] = {
+    "session", "unlock", "rdbi", "read", "tester", "raw", "wait",
+};
+
+typedef struct {
+    int kind;
+    uint8_t req[LOAD_MAX_REQ]; // unlock为请求seed的报文
+    uint16_t len;
+    uint32_t wait_ms;
+} load_step_t;
+
+typedef struct {
+    load_step_t steps[LOAD_MAX_STEPS];
+    int n;
+    int loop_start; // "loop"之后的步骤循环执行，之前的只在开始和出错后执行
+} load_script_t;
+
+static load_script_t g_script;
+
+// 解析十六进制字节串，允许空格分隔（"22F190"或"22 F1 90"）
+static int parse_hex_bytes(char **save, uint8_t *out, int max) {
+    int n = 0;
+    char *tok;
+    while ((tok = strtok_r(NULL, " \t", save)) != NULL) {
+        size_t len = strlen(tok);
+        if (len % 2) {
+            return -1;
+        }
+        for (size_t i = 0; i < len; i += 2) {
+            char byte[3] = { tok[i], tok[i + 1], 0 };
+            char *end;
+            if (n >= max) {
+                return -1;
+            }
+            out[n++] = strtoul(byte, &end, 16);
+            if (*end) {
+                return -1;
+            }
+        }
+    }
+    return n;
+}
+
+static int next_hex(char **save, uint32_t *value) {
+    char *tok = strtok_r(NULL, " \t", save);
+    char *end;
+    if (!tok) {
+        return -1;
+    }
+    *value = strtoul(tok, &end, 16);
+    return *end ? -1 : 0;
+}
+
+static int parse_step(char *line, load_script_t *sc) {
+    char *save;
+    char *cmd = strtok_r(line, " \t", &save);
+    uint32_t a, b;
+    if (!cmd) {
+        return 0; // 空行
+    }
+    if (strcmp(cmd, "loop") == 0) {
+        sc->loop_start = sc->n;
+        return 0;
+    }
+    if (sc->n >= LOAD_MAX_STEPS) {
+        fprintf(stderr, "场景步骤过多（最多%d）\n", LOAD_MAX_STEPS);
+        return -1;
+    }
+    load_step_t *st = &sc->steps[sc->n];
+    memset(st, 0, sizeof(*st));
+    if (strcmp(cmd, "session") == 0 && next_hex(&save, &a) == 0) {
+        st->kind = STEP_SESSION;
+        st->req[0] = 0x10;
+        st->req[1] = a;
+        st->len = 2;
+    } else if (strcmp(cmd, "unlock") == 0 && next_hex(&save, &a) == 0 && (a & 1)) {
+        st->kind = STEP_UNLOCK;
+        st->req[0] = 0x27;
+        st->req[1] = a;
+        st->len = 2;
+    } else if (strcmp(cmd, "rdbi") == 0) {
+        st->kind = STEP_RDBI;
+        st->req[st->len++] = 0x22;
+        // 无效的DID或超出请求长度时报错，而不是静默截断DID列表
+        char *tok;
+        while ((tok = strtok_r(NULL, " \t", &save)) != NULL) {
+            char *end;
+            unsigned long did = strtoul(tok, &end, 16);
+            if (*end || did > 0xFFFF || st->len + 2 > LOAD_MAX_REQ) {
+                goto bad;
+            }
+            st->req[st->len++] = did >> 8;
+            st->req[st->len++] = did;
+        }
+        if (st->len == 1) {
+            goto bad;
+        }
+    } else if (strcmp(cmd, "read") == 0 && next_hex(&save, &a) == 0 && next_hex(&save, &b) == 0 &&
+               b > 0 && b <= LOAD_MAX_READ) {
+        // 格式0x24：2字节长度、4字节地址
+        uint8_t req[] = { 0x23, 0x24, a >> 24, a >> 16, a >> 8, a, b >> 8, b };
+        st->kind = STEP_READ;
+        memcpy(st->req, req, sizeof(req));
+        st->len = sizeof(req);
+    } else if (strcmp(cmd, "tester") == 0) {
+        st->kind = STEP_TESTER;
+        st->req[0] = 0x3E;
+        st->req[1] = 0x00;
+        st->len = 2;
+    } else if (strcmp(cmd, "raw") == 0) {
+        int n = parse_hex_bytes(&save, st->req, LOAD_MAX_REQ);
+        if (n <= 0) {
+            goto bad;
+        }
+        st->kind = STEP_RAW;
+        st->len = n;
+    } else if (strcmp(cmd, "wait") == 0) {
+        char *tok = strtok_r(NULL, " \t", &save);
+        if (!tok) {
+            goto bad;
+        }
+        st->kind = STEP_WAIT;
+        st->wait_ms = atoi(tok);
+    } else {
+        goto bad;
+    }
+    sc->n++;
+    return 0;
+bad:
+    fprintf(stderr, "无法解析场景步骤: %s\n", cmd);
+    return -1;
+}
+
+// 步骤以换行或分号分隔，#之后为注释
+static int parse_script(char *text, load_script_t *sc) {
+    memset(sc, 0, sizeof(*sc));
+    sc->loop_start = -1;
+    char *save;
+    for (char *line = strtok_r(text, ";\n", &save); line; line = strtok_r(NULL, ";\n", &save)) {
+        char *hash = strchr(line, '#');
+        if (hash) {
+            *hash = '\0';
+        }
+        if (parse_step(line, sc) < 0) {
+            return -1;
+        }
+    }
+    if (sc->loop_start < 0) {
+        sc->loop_start = 0;
+    }
+    for (int i = sc->loop_start; i < sc->n; i++) {
+        if (sc->steps[i].kind != STEP_WAIT) {
+            return 0;
+        }
+    }
+    fprintf(stderr, "场景的循环部分没有请求\n");
+    return -1;
+}
+
+static char *read_file(const char *path) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char *buf = malloc(size + 1);
+    if (buf && fread(buf, 1, size, f) != (size_t)size) {
+        free(buf);
+        buf = NULL;
+    }
+    fclose(f);
+    if (buf) {
+        buf[size] = '\0';
+    }
+    return buf;
+}
+
+// ============== 诊断仪与工作线程 ==============
+typedef struct {
+    uint64_t requests;
+    uint64_t errors;   // 否定响应与传输错误
+    uint64_t timeouts; // P2/P2*超时
+    uds_hist_t latency; // 排定发送时刻 -> 响应（闭环时即实际发送时刻）
+    uds_hist_t service; // 实际发送时刻 -> 响应
+} load_stats_t;
+
+struct load_worker;
+
+typedef struct {
+    UDSClient_t client;
+    UDSTpISOTpC_t tp;
+    struct load_worker *w;
+    uint32_t phys_id;
+    uint32_t resp_id;
+    int step;
+    int phase;            // unlock: 0请求seed，1发送key
+    uint8_t key_req[6];
+    int busy;             // 有请求在等待响应
+    int result;           // 回调结果：0未完成，1成功，-1出错
+    UDSErr_t err;
+    uint64_t due_ns;      // 下一个请求最早的发送时刻（开环为排定时刻）
+    uint64_t intended_ns; // 当前请求的排定时刻
+    uint64_t sent_ns;
+} load_tester_t;
+
+typedef struct load_worker {
+    pthread_t thread;
+    load_tester_t *testers;
+    int n;
+    load_stats_t stats[STEP_KINDS];
+    uint64_t late;      // 开环：实际发送晚于排定时刻超过1ms的请求数
+    uint64_t max_lag_ns;
+} load_worker_t;
+
+static volatile sig_atomic_t g_stop = 0;
+static uint64_t g_end_ns;
+static uint64_t g_interval_ns; // 开环时每个诊断仪的请求间隔，0为闭环
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static int tester_fn(UDSClient_t *client, UDSEvent_t evt, void *ev_data) {
+    load_tester_t *t = client->fn_data;
+    switch (evt) {
+    case UDS_EVT_ResponseReceived:
+        if (g_script.steps[t->step].kind == STEP_UNLOCK && t->phase == 0) {
+            uint32_t seed, key = 0;
+            if (client->recv_size < 6) {
+                t->err = UDS_ERR_RESP_TOO_SHORT;
+                t->result = -1;
+                break;
+            }
+            seed = ((uint32_t)client->recv_buf[2] << 24) | (client->recv_buf[3] << 16) |
+                   (client->recv_buf[4] << 8) | client->recv_buf[5];
+            // seed为0表示已解锁
+            if (seed && uds_key_for_level(client->send_buf[1], seed, &key) < 0) {
+                t->err = UDS_ERR_INVALID_ARG;
+                t->result = -1;
+                break;
+            }
+            t->key_req[0] = 0x27;
+            t->key_req[1] = client->send_buf[1] + 1;
+            t->key_req[2] = key >> 24;
+            t->key_req[3] = key >> 16;
+            t->key_req[4] = key >> 8;
+            t->key_req[5] = key;
+            if (!seed) {
+                t->phase = 1; // 跳过发送key
+            }
+        }
+        t->result = 1;
+        break;
+    case UDS_EVT_Err:
+        t->err = *(UDSErr_t *)ev_data;
+        t->result = -1;
+        break;
+    default:
+        break;
+    }
+    return UDS_OK;
+}
+
+static void tester_schedule_next(load_tester_t *t, uint64_t now) {
+    if (g_interval_ns && t->step >= g_script.loop_start) {
+        t->due_ns = t->intended_ns + g_interval_ns;
+    } else {
+        t->due_ns = now;
+    }
+}
+
+// 跳过wait步骤并推迟due_ns；回到循环起点
+static void tester_advance(load_tester_t *t, uint64_t now) {
+    for (;;) {
+        if (++t->step >= g_script.n) {
+            t->step = g_script.loop_start;
+        }
+        const load_step_t *st = &g_script.steps[t->step];
+        if (st->kind != STEP_WAIT) {
+            return;
+        }
+        uint64_t until = now + (uint64_t)st->wait_ms * 1000000;
+        if (until > t->due_ns) {
+            t->due_ns = until;
+        }
+    }
+}
+
+static void tester_complete(load_tester_t *t, uint64_t now) {
+    const load_step_t *st = &g_script.steps[t->step];
+    load_stats_t *s = &t->w->stats[st->kind];
+    s->requests++;
+    t->busy = 0;
+    if (t->result < 0) {
+        if (t->err == UDS_ERR_TIMEOUT) {
+            s->timeouts++;
+        } else {
+            s->errors++;
+        }
+        // 会话超时、服务器复位等都会使后续请求失败，从头执行场景
+        t->step = 0;
+        t->phase = 0;
+        t->due_ns = now + (uint64_t)LOAD_RETRY_MS * 1000000;
+        if (g_script.steps[0].kind == STEP_WAIT) {
+            t->step = -1;
+            tester_advance(t, now);
+        }
+        return;
+    }
+    uds_hist_record(&s->latency, now - t->intended_ns);
+    uds_hist_record(&s->service, now - t->sent_ns);
+    tester_schedule_next(t, now);
+    if (st->kind == STEP_UNLOCK && t->phase == 0) {
+        t->phase = 1;
+        return;
+    }
+    t->phase = 0;
+    tester_advance(t, now);
+}
+
+static void tester_send(load_tester_t *t, uint64_t now) {
+    const load_step_t *st = &g_script.steps[t->step];
+    const uint8_t *req = st->req;
+    uint16_t len = st->len;
+    if (st->kind == STEP_UNLOCK && t->phase == 1) {
+        req = t->key_req;
+        len = sizeof(t->key_req);
+    }
+    t->intended_ns = g_interval_ns && t->step >= g_script.loop_start ? t->due_ns : now;
+    if (now - t->intended_ns > t->w->max_lag_ns) {
+        t->w->max_lag_ns = now - t->intended_ns;
+    }
+    if (now - t->intended_ns > 1000000) {
+        t->w->late++;
+    }
+    t->sent_ns = now;
+    t->result = 0;
+    t->busy = 1;
+    UDSErr_t err = UDSSendBytes(&t->client, req, len);
+    // 返回错误说明请求没有开始，不会再有事件，直接按出错处理；开始后的失败经UDS_EVT_Err报告
+    if (err != UDS_OK) {
+        t->err = err;
+        t->result = -1;
+    }
+}
+
+// 距下一个需要处理的时刻的纳秒数：空闲诊断仪的发送时刻，忙碌诊断仪的P2/ISO-TP截止时刻
+static uint64_t worker_timeout(load_worker_t *w, uint64_t now) {
+    uint64_t timeout = 100000000; // 最多睡眠100ms，以便检查结束时间
+    uint32_t ms = UDSMillis();
+    for (int i = 0; i < w->n; i++) {
+        load_tester_t *t = &w->testers[i];
+        uint64_t left;
+        if (!t->busy) {
+            left = t->due_ns > now ? t->due_ns - now : 0;
+        } else {
+            // P2/P2*与ISO-TP定时器中最早的截止时刻（到达后1ms才算到期），没有时下一毫秒再轮询
+            uint32_t deadline;
+            if (!UDSClientGetDeadline(&t->client, &deadline)) {
+                deadline = ms;
+            }
+            int32_t d = (int32_t)(deadline - ms) + 1;
+            left = d > 0 ? (uint64_t)d * 1000000 : 0;
+        }
+        if (left < timeout) {
+            timeout = left;
+        }
+    }
+    return timeout;
+}
+
+static void *worker_thread(void *arg) {
+    load_worker_t *w = arg;
+    struct pollfd pfds[LOAD_MAX_TESTERS];
+    for (int i = 0; i < w->n; i++) {
+        pfds[i].fd = w->testers[i].tp.fd;
+        pfds[i].events = POLLIN;
+    }
+    while (!g_stop) {
+        uint64_t now = now_ns();
+        if (now >= g_end_ns) {
+            break;
+        }
+        for (int i = 0; i < w->n; i++) {
+            load_tester_t *t = &w->testers[i];
+            if (t->busy) {
+                UDSClientPoll(&t->client);
+                if (t->result) {
+                    now = now_ns();
+                    tester_complete(t, now);
+                }
+            }
+            // 收到响应后在同一轮内立即发出下一个请求
+            if (!t->busy && now >= t->due_ns) {
+                tester_send(t, now);
+                if (t->result) {
+                    tester_complete(t, now_ns());
+                }
+            }
+        }
+        uint64_t timeout = worker_timeout(w, now_ns());
+        if (timeout) {
+            struct timespec ts = { timeout / 1000000000, timeout % 1000000000 };
+            ppoll(pfds, w->n, &ts, NULL);
+        }
+    }
+    return NULL;
+}
+
+static int open_tester_socket(const char *ifname, uint32_t resp_id) {
+    struct ifreq ifr;
+    struct sockaddr_can addr = { .can_family = AF_CAN };
+    int s = socket(PF_CAN, SOCK_RAW, CAN_RAW);
+    if (s < 0) {
+        perror("socket");
+        return -1;
+    }
+    snprintf(ifr.ifr_name, sizeof(ifr.ifr_name), "%s", ifname);
+    if (ioctl(s, SIOCGIFINDEX, &ifr) < 0) {
+        perror("SIOCGIFINDEX");
+        close(s);
+        return -1;
+    }
+    addr.can_ifindex = ifr.ifr_ifindex;
+    // 只接收本诊断仪的响应ID，避免每个套接字都处理总线上的全部帧
+    struct can_filter filter = { .can_id = resp_id, .can_mask = CAN_SFF_MASK };
+    setsockopt(s, SOL_CAN_RAW, CAN_RAW_FILTER, &filter, sizeof(filter));
+    if (bind(s, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        perror("bind");
+        close(s);
+        return -1;
+    }
+    return s;
+}
+
+static void stop_handler(int sig) {
+    g_stop = 1;
+}
+
+// ============== 报告 ==============
+static void json_hist(FILE *out, const uds_hist_t *h) {
+    fprintf(out, "{\"count\": %llu, \"min\": %.1f, \"p50\": %.1f, \"p90\": %.1f, \"p99\": %.1f, "
+                 "\"p999\": %.1f, \"max\": %.1f}",
+            (unsigned long long)h->count, h->count ? h->min / 1000.0 : 0.0,
+            uds_hist_percentile(h, 0.50) / 1000.0, uds_hist_percentile(h, 0.90) / 1000.0,
+            uds_hist_percentile(h, 0.99) / 1000.0, uds_hist_percentile(h, 0.999) / 1000.0,
+            h->max / 1000.0);
+}
+
+static void usage(const char *prog) {
+    printf("用法: %s [-i ifname] [-n testers] [-j threads] [-a phys:resp] [-S stride] [-s file | -e steps]\n"
+           "       [-r rate] [-d seconds] [-o file]\n", prog);
+    printf("  -i  CAN接口 (默认vcan0)\n");
+    printf("  -n  虚拟诊断仪数量 (默认1)\n");
+    printf("  -j  工作线程数 (默认min(诊断仪数, CPU数))\n");
+    printf("  -a  第一个诊断仪的请求ID:响应ID (默认7E0:7E8)\n");
+    printf("  -S  每个诊断仪ID对的增量 (默认1)，第k个为 phys+k*S : resp+k*S\n");
+    printf("  -s  场景脚本文件；-e 直接给出步骤，以分号分隔\n");
+    printf("      session XX | unlock L | rdbi DID... | read ADDR SIZE | tester | raw HEX | wait MS | loop\n");
+    printf("      loop之前的步骤只在开始和出错后执行 (默认 \"%s\")\n", LOAD_DEFAULT_SCRIPT);
+    printf("  -r  开环模式的总请求速率(次/秒)，不指定时为闭环\n");
+    printf("  -d  测试时长秒数 (默认10)\n");
+    printf("  -o  JSON输出文件 (默认标准输出)\n");
+}
+
+int main(int argc, char **argv) {
+    const char *ifname = "vcan0";
+    const char *script_path = NULL;
+    const char *out_path = NULL;
+    char *script_text = NULL;
+    int n_testers = 1;
+    int n_threads = 0;
+    uint32_t base_phys = 0x7E0, base_resp = 0x7E8, stride = 1;
+    double rate = 0;
+    double duration = 10.0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "i:n:j:a:S:s:e:r:d:o:h")) != -1) {
+        switch (opt) {
+        case 'i': ifname = optarg; break;
+        case 'n': n_testers = atoi(optarg); break;
+        case 'j': n_threads = atoi(optarg); break;
+        case 'a': {
+            char *end;
+            base_phys = strtoul(optarg, &end, 16);
+            if (*end != ':') {
+                usage(argv[0]);
+                return 1;
+            }
+            base_resp = strtoul(end + 1, NULL, 16);
+            break;
+        }
+        case 'S': stride = strtoul(optarg, NULL, 0); break;
+        case 's': script_path = optarg; break;
+        case 'e': script_text = strdup(optarg); break;
+        case 'r': rate = atof(optarg); break;
+        case 'd': duration = atof(optarg); break;
+        case 'o': out_path = optarg; break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (n_testers < 1 || n_testers > LOAD_MAX_TESTERS || rate < 0) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (script_path) {
+        free(script_text);
+        script_text = read_file(script_path);
+        if (!script_text) {
+            return 1;
+        }
+    } else if (!script_text) {
+        script_text = strdup(LOAD_DEFAULT_SCRIPT);
+    }
+    if (parse_script(script_text, &g_script) < 0) {
+        return 1;
+    }
+    free(script_text);
+
+    // 各诊断仪的ID对互不相同，且任何请求ID都不能与响应ID重合
+    uint32_t last_phys = base_phys + (n_testers - 1) * stride;
+    uint32_t last_resp = base_resp + (n_testers - 1) * stride;
+    int overlap = last_phys > CAN_SFF_MASK || last_resp > CAN_SFF_MASK || (stride == 0 && n_testers > 1);
+    for (int i = 0; i < n_testers && !overlap; i++) {
+        for (int j = 0; j < n_testers; j++) {
+            if (base_phys + i * stride == base_resp + j * stride) {
+                overlap = 1;
+                break;
+            }
+        }
+    }
+    if (overlap) {
+        fprintf(stderr, "CAN ID重叠或越界: 请求0x%03X..0x%03X, 响应0x%03X..0x%03X\n", base_phys,
+                last_phys, base_resp, last_resp);
+        return 1;
+    }
+
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (n_threads <= 0) {
+        n_threads = cpus > 0 ? (int)cpus : 1;
+    }
+    if (n_threads > n_testers) {
+        n_threads = n_testers;
+    }
+    if (n_threads > LOAD_MAX_THREADS) {
+        n_threads = LOAD_MAX_THREADS;
+    }
+
+    load_tester_t *testers = calloc(n_testers, sizeof(*testers));
+    load_worker_t *workers = calloc(n_threads, sizeof(*workers));
+    if (!testers || !workers) {
+        perror("calloc");
+        return 1;
+    }
+    g_interval_ns = rate > 0 ? (uint64_t)(n_testers * 1e9 / rate) : 0;
+    uint64_t start = now_ns();
+    for (int k = 0; k < n_testers; k++) {
+        load_tester_t *t = &testers[k];
+        t->phys_id = base_phys + k * stride;
+        t->resp_id = base_resp + k * stride;
+        int fd = open_tester_socket(ifname, t->resp_id);
+        if (fd < 0 || UDSTpISOTpCInitFd(&t->tp, fd, t->resp_id, t->phys_id, t->resp_id, 0x7DF) != UDS_OK) {
+            return 1;
+        }
+        snprintf(t->tp.tag, sizeof(t->tp.tag), "tester%d", k);
+        UDSClientInit(&t->client);
+        t->client.tp = &t->tp.hdl;
+        t->client.fn = tester_fn;
+        t->client.fn_data = t;
+        // 开环时各诊断仪的排定时刻错开，避免同时发送
+        t->due_ns = start + (g_interval_ns ? g_interval_ns * k / n_testers : 0);
+        t->step = -1;
+        tester_advance(t, start);
+    }
+    // 诊断仪按编号连续分给各线程
+    for (int i = 0, k = 0; i < n_threads; i++) {
+        int n = n_testers / n_threads + (i < n_testers % n_threads);
+        workers[i].testers = &testers[k];
+        workers[i].n = n;
+        for (int j = 0; j < n; j++) {
+            testers[k + j].w = &workers[i];
+        }
+        k += n;
+    }
+
+    struct sigaction sa = { .sa_handler = stop_handler };
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    g_end_ns = start + (uint64_t)(duration * 1e9);
+    for (int i = 0; i < n_threads; i++) {
+        if (pthread_create(&workers[i].thread, NULL, worker_thread, &workers[i]) != 0) {
+            fprintf(stderr, "工作线程启动失败\n");
+            return 1;
+        }
+    }
+    for (int i = 0; i < n_threads; i++) {
+        pthread_join(workers[i].thread, NULL);
+    }
+    double elapsed = (now_ns() - start) / 1e9;
+
+    // 合并各线程统计
+    load_stats_t *steps = calloc(STEP_KINDS, sizeof(*steps));
+    load_stats_t *total = calloc(1, sizeof(*total));
+    uint64_t late = 0, max_lag_ns = 0;
+    for (int i = 0; i < n_threads; i++) {
+        for (int s = 0; s < STEP_KINDS; s++) {
+            const load_stats_t *src = &workers[i].stats[s];
+            load_stats_t *dst[2] = { &steps[s], total };
+            for (int d = 0; d < 2; d++) {
+                dst[d]->requests += src->requests;
+                dst[d]->errors += src->errors;
+                dst[d]->timeouts += src->timeouts;
+                uds_hist_merge(&dst[d]->latency, &src->latency);
+                uds_hist_merge(&dst[d]->service, &src->service);
+            }
+        }
+        late += workers[i].late;
+        if (workers[i].max_lag_ns > max_lag_ns) {
+            max_lag_ns = workers[i].max_lag_ns;
+        }
+    }
+    for (int k = 0; k < n_testers; k++) {
+        UDSTpISOTpCDeinit(&testers[k].tp);
+    }
+
+    FILE *out = out_path ? fopen(out_path, "w") : stdout;
+    if (!out) {
+        perror(out_path);
+        return 1;
+    }
+    fprintf(out, "{\n  \"interface\": \"%s\",\n", ifname);
+    fprintf(out, "  \"mode\": \"%s\",\n", g_interval_ns ? "open" : "closed");
+    if (g_interval_ns) {
+        fprintf(out, "  \"target_rate\": %.1f,\n", rate);
+    }
+    fprintf(out, "  \"testers\": %d,\n  \"threads\": %d,\n", n_testers, n_threads);
+    fprintf(out, "  \"ids\": \"0x%03X:0x%03X +%u\",\n", base_phys, base_resp, stride);
+    fprintf(out, "  \"duration_s\": %.3f,\n", elapsed);
+    fprintf(out, "  \"requests\": %llu,\n  \"errors\": %llu,\n  \"timeouts\": %llu,\n",
+            (unsigned long long)total->requests, (unsigned long long)total->errors,
+            (unsigned long long)total->timeouts);
+    fprintf(out, "  \"requests_per_s\": %.1f,\n", total->requests / elapsed);
+    if (g_interval_ns) {
+        fprintf(out, "  \"late_sends\": %llu,\n  \"max_send_lag_ms\": %.3f,\n", (unsigned long long)late,
+                max_lag_ns / 1e6);
+    }
+    fprintf(out, "  \"latency_us\": ");
+    json_hist(out, &total->latency);
+    fprintf(out, ",\n  \"service_us\": ");
+    json_hist(out, &total->service);
+    fprintf(out, ",\n  \"steps\": {");
+    int first = 1;
+    for (int s = 0; s < STEP_KINDS; s++) {
+        const load_stats_t *st = &steps[s];
+        if (!st->requests) {
+            continue;
+        }
+        fprintf(out, "%s\n    \"%s\": {\"requests\": %llu, \"errors\": %llu, \"timeouts\": %llu, \"latency_us\": ",
+                first ? "" : ",", g_step_names[s], (unsigned long long)st->requests,
+                (unsigned long long)st->errors, (unsigned long long)st->timeouts);
+        json_hist(out, &st->latency);
+        fprintf(out, ", \"service_us\": ");
+        json_hist(out, &st->service);
+        fprintf(out, "}");
+        first = 0;
+    }
+    fprintf(out, "\n  }\n}\n");
+    if (out != stdout) {
+        fclose(out);
+    }
+    int ret = total->errors + total->timeouts ? 2 : 0;
+    free(steps);
+    free(total);
+    free(testers);
+    free(workers);
+    return ret;
+}
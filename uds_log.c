@@ -0,0 +1,688 @@
+// DID数据记录工具：按目标频率循环读取一组DID，写入mmap的列式文件
+//   服务器支持0x2A ReadDataByPeriodicIdentifier且所有DID都在0xF200-0xF2FF时由服务器周期发送；
+//   否则用编译好的RDBI计划（UDSRDBIPlanCompile）按MTU拆分成多个0x22请求，经客户端队列背靠背发送，
+//   服务器每个0x22只支持一个DID时自动退回到每个DID一个请求
+//
+// 文件格式（小端，追加写入，可以一边记录一边用 -x 提取）：
+//   [0, 4096)       文件头 log_header_t，列描述 log_col_t[num_cols]
+//   之后是定长的段，每段 rows_per_seg 行：
+//     log_seg_t 段头（64字节：首末时间戳、行数）
+//     时间戳列 uint64_t[rows_per_seg]（CLOCK_REALTIME纳秒）
+//     每个DID一列，len字节 × rows_per_seg，保存响应中的原始字节
+//   段按时间顺序排列、长度固定，段头即稀疏时间索引：按时间范围提取时先对段头二分，
+//   再在段内对时间戳列二分
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include "iso14229.h"
+#include "uds_tool.h"
+
+#define LOG_MAGIC "UDSLOG1"
+#define LOG_VERSION 1
+#define LOG_HEADER_SIZE 4096
+#define LOG_SEG_HEADER_SIZE 64
+#define LOG_ROWS_PER_SEG 4096
+#define LOG_MAX_DIDS 256
+#define LOG_PROGRESS_MS 1000
+
+typedef struct {
+    uint16_t did;
+    uint16_t len;    // 每个值的字节数
+    uint32_t offset; // 列在段内的偏移
+} log_col_t;
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    uint32_t seg_size;     // 段长度（页对齐）
+    uint32_t rows_per_seg;
+    uint32_t num_cols;
+    uint32_t row_bytes;    // 一行所有DID值的字节数
+    uint64_t start_ns;     // 开始记录的时间
+    uint32_t mode;         // 0x22 或 0x2A
+    uint32_t rate_hz;      // 目标频率，0为尽可能快
+    log_col_t cols[];
+} log_header_t;
+
+typedef struct {
+    uint64_t first_ns;
+    uint64_t last_ns;
+    uint32_t rows; // 已提交的行数，数据写完后才递增
+    uint32_t index;
+    uint8_t reserved[LOG_SEG_HEADER_SIZE - 24];
+} log_seg_t;
+
+_Static_assert(sizeof(log_seg_t) == LOG_SEG_HEADER_SIZE, "段头大小");
+_Static_assert(sizeof(log_header_t) + LOG_MAX_DIDS * sizeof(log_col_t) <= LOG_HEADER_SIZE,
+               "文件头放不下全部列");
+
+// ============== 列式文件写入 ==============
+typedef struct {
+    int fd;
+    log_header_t *hdr; // 映射的文件头
+    uint8_t *seg;      // 当前段的映射
+    uint32_t seg_index;
+    uint64_t rows;     // 已提交的总行数
+} log_file_t;
+
+static log_seg_t *seg_header(uint8_t *seg) {
+    return (log_seg_t *)seg;
+}
+
+static uint64_t *seg_times(uint8_t *seg) {
+    return (uint64_t *)(seg + LOG_SEG_HEADER_SIZE);
+}
+
+// 当前行中第c列的位置
+static uint8_t *seg_cell(const log_header_t *hdr, uint8_t *seg, uint32_t c, uint32_t row) {
+    return seg + hdr->cols[c].offset + (size_t)row * hdr->cols[c].len;
+}
+
+// 文件扩展一段并映射为当前段
+static int map_segment(log_file_t *f, uint32_t index) {
+    if (f->seg) {
+        munmap(f->seg, f->hdr->seg_size);
+        f->seg = NULL;
+    }
+    off_t off = LOG_HEADER_SIZE + (off_t)index * f->hdr->seg_size;
+    if (ftruncate(f->fd, off + f->hdr->seg_size) < 0) {
+        perror("ftruncate");
+        return -1;
+    }
+    void *p = mmap(NULL, f->hdr->seg_size, PROT_READ | PROT_WRITE, MAP_SHARED, f->fd, off);
+    if (p == MAP_FAILED) {
+        perror("mmap");
+        return -1;
+    }
+    f->seg = p;
+    f->seg_index = index;
+    seg_header(f->seg)->index = index;
+    return 0;
+}
+
+static int log_create(log_file_t *f, const char *path, const log_col_t *cols, uint32_t n,
+                      uint32_t mode, uint32_t rate_hz) {
+    memset(f, 0, sizeof(*f));
+    f->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (f->fd < 0) {
+        perror(path);
+        return -1;
+    }
+    if (ftruncate(f->fd, LOG_HEADER_SIZE) < 0) {
+        perror("ftruncate");
+        return -1;
+    }
+    void *p = mmap(NULL, LOG_HEADER_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, f->fd, 0);
+    if (p == MAP_FAILED) {
+        perror("mmap");
+        return -1;
+    }
+    log_header_t *hdr = p;
+    f->hdr = hdr;
+    hdr->version = LOG_VERSION;
+    hdr->header_size = LOG_HEADER_SIZE;
+    hdr->rows_per_seg = LOG_ROWS_PER_SEG;
+    hdr->num_cols = n;
+    hdr->mode = mode;
+    hdr->rate_hz = rate_hz;
+    hdr->start_ns = uds_tool_now_ns(CLOCK_REALTIME);
+    size_t off = LOG_SEG_HEADER_SIZE + LOG_ROWS_PER_SEG * sizeof(uint64_t);
+    for (uint32_t c = 0; c < n; c++) {
+        hdr->cols[c] = cols[c];
+        hdr->cols[c].offset = off;
+        hdr->row_bytes += cols[c].len;
+        off += (size_t)LOG_ROWS_PER_SEG * cols[c].len;
+    }
+    long page = sysconf(_SC_PAGESIZE);
+    hdr->seg_size = (off + page - 1) & ~(size_t)(page - 1);
+    // magic最后写入，读者看到magic时文件头已完整
+    memcpy(hdr->magic, LOG_MAGIC, sizeof(hdr->magic));
+    return map_segment(f, 0);
+}
+
+// 当前段中下一行的位置；段满时切换到新段
+static uint32_t log_next_row(log_file_t *f) {
+    log_seg_t *s = seg_header(f->seg);
+    if (s->rows == f->hdr->rows_per_seg && map_segment(f, f->seg_index + 1) < 0) {
+        return UINT32_MAX;
+    }
+    return seg_header(f->seg)->rows;
+}
+
+// 提交一行：数据已写入各列，写入时间戳后再递增行数
+static void log_commit_row(log_file_t *f, uint64_t t) {
+    log_seg_t *s = seg_header(f->seg);
+    uint32_t row = s->rows;
+    seg_times(f->seg)[row] = t;
+    if (row == 0) {
+        s->first_ns = t;
+    }
+    s->last_ns = t;
+    __atomic_store_n(&s->rows, row + 1, __ATOMIC_RELEASE);
+    f->rows++;
+}
+
+static void log_close(log_file_t *f) {
+    if (f->seg) {
+        msync(f->seg, f->hdr->seg_size, MS_SYNC);
+        munmap(f->seg, f->hdr->seg_size);
+    }
+    if (f->hdr) {
+        munmap(f->hdr, LOG_HEADER_SIZE);
+    }
+    if (f->fd >= 0) {
+        close(f->fd);
+    }
+}
+
+// ============== 采样 ==============
+typedef struct {
+    log_file_t *file;
+    uint32_t num_cols;
+    uint16_t dids[LOG_MAX_DIDS];
+    uint16_t lens[LOG_MAX_DIDS];
+
+    // 0x22: 一个计划（多DID请求）或每个DID一个计划
+    UDSRDBIPlan_t plans[LOG_MAX_DIDS];
+    UDSRDBIPlanVar_t vars[LOG_MAX_DIDS];
+    UDSRDBIPlanChunk_t chunks[LOG_MAX_DIDS];
+    uint8_t req_buf[UDS_RDBI_PLAN_REQ_BUF_SIZE(LOG_MAX_DIDS)];
+    uint32_t num_plans;
+    uint32_t plans_pending;
+    UDSErr_t cycle_err;
+
+    // 0x2A: 本行已收到的列
+    uint8_t updated[LOG_MAX_DIDS];
+    uint32_t num_updated;
+
+    uint32_t row; // 正在填充的行
+    uint64_t samples;
+    uint64_t errors;
+} sampler_t;
+
+static sampler_t g_sampler;
+
+// 各计划变量的目标指向当前行的单元格：响应直接解码进文件
+static int point_vars(sampler_t *s) {
+    s->row = log_next_row(s->file);
+    if (s->row == UINT32_MAX) {
+        return -1;
+    }
+    for (uint32_t c = 0; c < s->num_cols; c++) {
+        s->vars[c].data = seg_cell(s->file->hdr, s->file->seg, c, s->row);
+    }
+    return 0;
+}
+
+static void plan_done(UDSClient_t *client, UDSRDBIPlan_t *plan, UDSErr_t err) {
+    sampler_t *s = plan->cb_data;
+    if (err != UDS_OK && s->cycle_err == UDS_OK) {
+        s->cycle_err = err;
+    }
+    s->plans_pending--;
+}
+
+// 按MTU拆分所有DID（per_did为每个DID单独一个请求）
+static int compile_plans(sampler_t *s, int per_did) {
+    for (uint32_t c = 0; c < s->num_cols; c++) {
+        s->vars[c] = (UDSRDBIPlanVar_t){ .did = s->dids[c], .len = s->lens[c],
+                                         .type = UDS_RDBI_BYTES, .data = s->req_buf };
+    }
+    s->num_plans = per_did ? s->num_cols : 1;
+    for (uint32_t i = 0; i < s->num_plans; i++) {
+        uint32_t first = per_did ? i : 0;
+        uint32_t n = per_did ? 1 : s->num_cols;
+        UDSErr_t err = UDSRDBIPlanCompile(&s->plans[i], &s->vars[first], n, &s->chunks[first],
+                                          LOG_MAX_DIDS - first, &s->req_buf[3 * first],
+                                          UDS_RDBI_PLAN_REQ_BUF_SIZE(n), 0);
+        if (err != UDS_OK) {
+            uds_tool_print_err("编译RDBI计划", err);
+            return -1;
+        }
+        s->plans[i].cb = plan_done;
+        s->plans[i].cb_data = s;
+    }
+    if (uds_tool_verbose) {
+        uint32_t reqs = 0;
+        for (uint32_t i = 0; i < s->num_plans; i++) {
+            reqs += s->plans[i].num_chunks;
+        }
+        printf("[LOG] 每次采样%u个0x22请求\n", reqs);
+    }
+    return 0;
+}
+
+static UDSErr_t start_cycle(sampler_t *s) {
+    s->cycle_err = UDS_OK;
+    s->plans_pending = s->num_plans;
+    for (uint32_t i = 0; i < s->num_plans; i++) {
+        UDSErr_t err = UDSRDBIPlanRead(&uds_tool_client, &s->plans[i]);
+        if (err != UDS_OK) {
+            s->plans_pending -= s->num_plans - i;
+            return err;
+        }
+    }
+    return UDS_OK;
+}
+
+// 完成一轮0x22后提交行；返回-1表示文件错误
+static int finish_cycle(sampler_t *s) {
+    if (s->cycle_err != UDS_OK) {
+        s->errors++;
+        if (uds_tool_verbose) {
+            uds_tool_print_err("采样", s->cycle_err);
+        }
+        return 0;
+    }
+    log_commit_row(s->file, uds_tool_now_ns(CLOCK_REALTIME));
+    s->samples++;
+    return point_vars(s);
+}
+
+// 逐个读取每个DID，得到数据长度
+static int probe_dids(sampler_t *s) {
+    for (uint32_t c = 0; c < s->num_cols; c++) {
+        uint8_t req[3] = { 0x22, s->dids[c] >> 8, s->dids[c] & 0xFF };
+        UDSErr_t err = uds_tool_request(req, sizeof(req));
+        if (err != UDS_OK) {
+            fprintf(stderr, "DID 0x%04X: ", s->dids[c]);
+            uds_tool_print_err("读取", err);
+            return -1;
+        }
+        if (uds_tool_client.recv_size <= 3 || uds_tool_client.recv_buf[1] != req[1] ||
+            uds_tool_client.recv_buf[2] != req[2]) {
+            fprintf(stderr, "DID 0x%04X: 响应格式错误\n", s->dids[c]);
+            return -1;
+        }
+        s->lens[c] = uds_tool_client.recv_size - 3;
+        if (uds_tool_verbose) {
+            printf("[LOG] DID 0x%04X: %u字节\n", s->dids[c], s->lens[c]);
+        }
+    }
+    return 0;
+}
+
+// 0x2A：所有DID都是周期DID（0xF2xx）且服务器接受时返回1
+static int try_periodic(sampler_t *s, uint8_t mode) {
+    uint8_t req[2 + LOG_MAX_DIDS] = { 0x2A, mode };
+    for (uint32_t c = 0; c < s->num_cols; c++) {
+        if ((s->dids[c] >> 8) != 0xF2) {
+            return 0;
+        }
+        req[2 + c] = s->dids[c] & 0xFF;
+    }
+    UDSErr_t err = uds_tool_request(req, 2 + s->num_cols);
+    if (err != UDS_OK) {
+        if (uds_tool_verbose) {
+            uds_tool_print_err("ReadDataByPeriodicIdentifier", err);
+        }
+        return 0;
+    }
+    return 1;
+}
+
+static void stop_periodic(sampler_t *s) {
+    uint8_t req[2 + LOG_MAX_DIDS] = { 0x2A, 0x04 };
+    for (uint32_t c = 0; c < s->num_cols; c++) {
+        req[2 + c] = s->dids[c] & 0xFF;
+    }
+    UDSErr_t err = uds_tool_request(req, 2 + s->num_cols);
+    if (err != UDS_OK) {
+        uds_tool_print_err("停止周期发送", err);
+    }
+}
+
+// 处理一个周期响应：periodicDataIdentifier + 数据（部分实现在前面带0x6A）
+static int on_periodic(sampler_t *s, const uint8_t *buf, size_t len) {
+    if (len >= 2 && buf[0] == 0x6A) {
+        buf++;
+        len--;
+    }
+    for (uint32_t c = 0; c < s->num_cols; c++) {
+        if ((s->dids[c] & 0xFF) != buf[0] || len != 1u + s->lens[c]) {
+            continue;
+        }
+        memcpy(s->vars[c].data, buf + 1, s->lens[c]);
+        if (!s->updated[c]) {
+            s->updated[c] = 1;
+            s->num_updated++;
+        }
+        // 所有列都更新过一次后提交一行
+        if (s->num_updated == s->num_cols) {
+            memset(s->updated, 0, s->num_cols);
+            s->num_updated = 0;
+            log_commit_row(s->file, uds_tool_now_ns(CLOCK_REALTIME));
+            s->samples++;
+            return point_vars(s);
+        }
+        return 0;
+    }
+    s->errors++;
+    return 0;
+}
+
+static void report(sampler_t *s, uint64_t t_start, uint64_t *last_samples, int final) {
+    double elapsed = (uds_tool_now_ns(CLOCK_MONOTONIC) - t_start) / 1e9;
+    if (final) {
+        struct rusage ru;
+        getrusage(RUSAGE_SELF, &ru);
+        double cpu = ru.ru_utime.tv_sec + ru.ru_stime.tv_sec +
+                     (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+        printf("[LOG] 完成: %llu 行，%llu 次失败，用时 %.2f 秒，%.1f 行/秒，CPU %.2f 秒 (%.1f%%)\n",
+               (unsigned long long)s->samples, (unsigned long long)s->errors, elapsed,
+               elapsed > 0 ? s->samples / elapsed : 0, cpu, elapsed > 0 ? 100 * cpu / elapsed : 0);
+    } else {
+        printf("[LOG] %.0f秒 %llu 行 (%llu 行/秒) %llu 次失败\n", elapsed,
+               (unsigned long long)s->samples,
+               (unsigned long long)(s->samples - *last_samples) * 1000 / LOG_PROGRESS_MS,
+               (unsigned long long)s->errors);
+        *last_samples = s->samples;
+    }
+}
+
+static int record(sampler_t *s, const char *path, uint32_t rate_hz, double duration,
+                  int use_periodic, uint8_t periodic_mode) {
+    if (probe_dids(s) < 0) {
+        return -1;
+    }
+    log_col_t cols[LOG_MAX_DIDS];
+    for (uint32_t c = 0; c < s->num_cols; c++) {
+        cols[c] = (log_col_t){ .did = s->dids[c], .len = s->lens[c] };
+    }
+    int periodic = use_periodic && try_periodic(s, periodic_mode);
+    log_file_t file;
+    if (log_create(&file, path, cols, s->num_cols, periodic ? 0x2A : 0x22, rate_hz) < 0) {
+        return -1;
+    }
+    s->file = &file;
+    if (periodic) {
+        printf("[LOG] 使用0x2A周期读取 (transmissionMode 0x%02X)\n", periodic_mode);
+    } else if (compile_plans(s, 0) < 0) {
+        return -1;
+    }
+    if (point_vars(s) < 0) {
+        return -1;
+    }
+    if (rate_hz) {
+        printf("[LOG] 记录%u个DID到 %s，每秒%u次\n", s->num_cols, path, rate_hz);
+    } else {
+        printf("[LOG] 记录%u个DID到 %s，不限频率\n", s->num_cols, path);
+    }
+
+    uint64_t period_ns = rate_hz ? 1000000000ull / rate_hz : 0;
+    uint64_t t_start = uds_tool_now_ns(CLOCK_MONOTONIC);
+    uint64_t t_next = t_start;
+    uint64_t t_end = duration > 0 ? t_start + (uint64_t)(duration * 1e9) : UINT64_MAX;
+    uint64_t t_report = t_start + LOG_PROGRESS_MS * 1000000ull;
+    uint64_t last_samples = 0;
+    int in_cycle = 0, probed = 0, ret = 0;
+
+    while (!uds_tool_stop) {
+        uint64_t now = uds_tool_now_ns(CLOCK_MONOTONIC);
+        if (now >= t_end) {
+            break;
+        }
+        if (now >= t_report) {
+            report(s, t_start, &last_samples, 0);
+            t_report += LOG_PROGRESS_MS * 1000000ull;
+        }
+        if (periodic) {
+            // 周期响应是未经请求的报文，客户端空闲时直接从传输层取
+            UDSTpPoll(uds_tool_client.tp);
+            uint8_t *buf;
+            UDSSDU_t info;
+            ssize_t len = UDSTpPeek(uds_tool_client.tp, &buf, &info);
+            if (len > 0) {
+                ret = on_periodic(s, buf, len);
+                UDSTpAckRecv(uds_tool_client.tp);
+                if (ret < 0) {
+                    break;
+                }
+                continue;
+            }
+            UDSClientWait(&uds_tool_client, 100);
+            continue;
+        }
+
+        if (!in_cycle && now >= t_next) {
+            UDSErr_t err = start_cycle(s);
+            if (err != UDS_OK) {
+                uds_tool_print_err("采样", err);
+                ret = -1;
+                break;
+            }
+            in_cycle = 1;
+            // 落后超过一个周期时不追赶，从现在重新计时
+            t_next = period_ns && t_next + period_ns > now ? t_next + period_ns : now + period_ns;
+        }
+        UDSClientPoll(&uds_tool_client);
+        if (in_cycle && s->plans_pending == 0) {
+            in_cycle = 0;
+            if (!probed) {
+                probed = 1;
+                // 服务器每个0x22只返回第一个DID时，响应长度或DID对不上
+                UDSErr_t e = s->cycle_err;
+                if ((e == UDS_FAIL || e == UDS_ERR_DID_MISMATCH || e == UDS_ERR_RESP_TOO_SHORT ||
+                     e == UDS_NRC_IncorrectMessageLengthOrInvalidFormat) &&
+                    s->num_plans == 1 && s->num_cols > 1) {
+                    printf("[LOG] 服务器不支持单个0x22读取多个DID，改为每个DID一个请求\n");
+                    if (compile_plans(s, 1) < 0 || point_vars(s) < 0) {
+                        ret = -1;
+                        break;
+                    }
+                    t_next = now;
+                    continue;
+                }
+            }
+            if (finish_cycle(s) < 0) {
+                ret = -1;
+                break;
+            }
+            continue;
+        }
+        if (!in_cycle) {
+            int64_t wait_ms = (int64_t)(t_next - uds_tool_now_ns(CLOCK_MONOTONIC)) / 1000000;
+            UDSClientWait(&uds_tool_client, wait_ms > 100 ? 100 : wait_ms < 0 ? 0 : (int)wait_ms);
+        } else {
+            UDSClientWait(&uds_tool_client, 100);
+        }
+    }
+    if (periodic) {
+        stop_periodic(s);
+    }
+    report(s, t_start, &last_samples, 1);
+    log_close(&file);
+    return ret;
+}
+
+// ============== 按时间范围提取 ==============
+// 打印一个值：1/2/4字节按大端无符号整数，其余为十六进制
+static void print_value(const uint8_t *p, uint16_t len) {
+    if (len == 1 || len == 2 || len == 4) {
+        uint32_t v = 0;
+        for (uint16_t i = 0; i < len; i++) {
+            v = (v << 8) | p[i];
+        }
+        printf(",%u", v);
+        return;
+    }
+    putchar(',');
+    for (uint16_t i = 0; i < len; i++) {
+        printf("%02X", p[i]);
+    }
+}
+
+static int extract(const char *path, double from_s, double to_s) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror(path);
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size < LOG_HEADER_SIZE) {
+        fprintf(stderr, "%s: 不是记录文件\n", path);
+        close(fd);
+        return -1;
+    }
+    uint8_t *base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        perror("mmap");
+        return -1;
+    }
+    const log_header_t *hdr = (const log_header_t *)base;
+    if (memcmp(hdr->magic, LOG_MAGIC, sizeof(hdr->magic)) != 0 || hdr->version != LOG_VERSION ||
+        hdr->num_cols > LOG_MAX_DIDS || hdr->seg_size == 0) {
+        fprintf(stderr, "%s: 不是记录文件\n", path);
+        munmap(base, st.st_size);
+        return -1;
+    }
+    uint32_t num_segs = (st.st_size - hdr->header_size) / hdr->seg_size;
+    uint64_t from = from_s > 0 ? hdr->start_ns + (uint64_t)(from_s * 1e9) : 0;
+    uint64_t to = to_s > 0 ? hdr->start_ns + (uint64_t)(to_s * 1e9) : UINT64_MAX;
+
+    // 段头二分：第一个last_ns >= from的段
+    uint32_t lo = 0, hi = num_segs;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        const log_seg_t *s = (const log_seg_t *)(base + hdr->header_size +
+                                                 (size_t)mid * hdr->seg_size);
+        uint32_t rows = __atomic_load_n(&s->rows, __ATOMIC_ACQUIRE);
+        if (rows && s->last_ns < from) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    printf("time_s");
+    for (uint32_t c = 0; c < hdr->num_cols; c++) {
+        printf(",%04X", hdr->cols[c].did);
+    }
+    printf("\n");
+    uint64_t n = 0;
+    for (uint32_t i = lo; i < num_segs; i++) {
+        uint8_t *seg = base + hdr->header_size + (size_t)i * hdr->seg_size;
+        uint32_t rows = __atomic_load_n(&seg_header(seg)->rows, __ATOMIC_ACQUIRE);
+        const uint64_t *t = seg_times(seg);
+        // 段内时间戳二分
+        uint32_t r = 0, r_hi = rows;
+        while (r < r_hi) {
+            uint32_t mid = r + (r_hi - r) / 2;
+            if (t[mid] < from) {
+                r = mid + 1;
+            } else {
+                r_hi = mid;
+            }
+        }
+        for (; r < rows; r++) {
+            if (t[r] > to) {
+                goto done;
+            }
+            printf("%.6f", (double)(int64_t)(t[r] - hdr->start_ns) / 1e9);
+            for (uint32_t c = 0; c < hdr->num_cols; c++) {
+                print_value(seg_cell(hdr, seg, c, r), hdr->cols[c].len);
+            }
+            printf("\n");
+            n++;
+        }
+    }
+done:
+    fprintf(stderr, "[LOG] %u列，%u段，提取%llu行\n", hdr->num_cols, num_segs,
+            (unsigned long long)n);
+    munmap(base, st.st_size);
+    return 0;
+}
+
+static void usage(const char *prog) {
+    printf("用法: %s [-i ifname] [-a phys:resp] [-s session] [-l level] [-r rate] [-d seconds]\n"
+           "       [-P mode] [-N] [-v] -o file DID...\n"
+           "       %s -x file [-t from:to]\n", prog, prog);
+    printf("  -i  CAN接口 (默认vcan0)\n");
+    printf("  -a  请求ID:响应ID (默认7E0:7E8)\n");
+    printf("  -s  先切换到该诊断会话 (默认不切换)\n");
+    printf("  -l  安全访问级别 (默认不解锁)\n");
+    printf("  -r  每秒采样次数，0为尽可能快 (默认10)\n");
+    printf("  -d  记录时长（秒），0为直到Ctrl-C (默认0)\n");
+    printf("  -P  0x2A transmissionMode: 1慢 2中 3快 (默认3)\n");
+    printf("  -N  不尝试0x2A，只用0x22\n");
+    printf("  -v  输出探测与错误细节\n");
+    printf("  -o  输出文件\n");
+    printf("  -x  把记录文件按CSV输出到stdout\n");
+    printf("  -t  提取的时间范围，相对记录开始的秒数 (例如 10:20、:5、30:)\n");
+    printf("例: %s -r 100 -d 60 -o run.udslog FD00 FD01\n", prog);
+}
+
+int main(int argc, char **argv) {
+    const char *ifname = "vcan0";
+    const char *out_path = NULL, *extract_path = NULL;
+    uint32_t phys = 0x7E0, resp = 0x7E8;
+    int session = 0, level = 0, use_periodic = 1;
+    uint32_t rate_hz = 10;
+    uint8_t periodic_mode = 0x03;
+    double duration = 0, from_s = 0, to_s = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "i:a:s:l:r:d:P:Nvo:x:t:h")) != -1) {
+        switch (opt) {
+        case 'i': ifname = optarg; break;
+        case 'a':
+            if (uds_tool_parse_ids(optarg, &phys, &resp) < 0) {
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 's': session = strtoul(optarg, NULL, 16); break;
+        case 'l': level = strtoul(optarg, NULL, 16); break;
+        case 'r': rate_hz = strtoul(optarg, NULL, 0); break;
+        case 'd': duration = atof(optarg); break;
+        case 'P': periodic_mode = strtoul(optarg, NULL, 16); break;
+        case 'N': use_periodic = 0; break;
+        case 'v': uds_tool_verbose = 1; break;
+        case 'o': out_path = optarg; break;
+        case 'x': extract_path = optarg; break;
+        case 't': {
+            char *colon = strchr(optarg, ':');
+            if (!colon) {
+                usage(argv[0]);
+                return 1;
+            }
+            from_s = atof(optarg);
+            to_s = colon[1] ? atof(colon + 1) : 0;
+            break;
+        }
+        default: usage(argv[0]); return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (extract_path) {
+        return extract(extract_path, from_s, to_s) < 0 ? 1 : 0;
+    }
+    sampler_t *s = &g_sampler;
+    s->num_cols = argc - optind;
+    if (!out_path || s->num_cols == 0 || s->num_cols > LOG_MAX_DIDS ||
+        periodic_mode < 1 || periodic_mode > 3 || (level && !(level & 1))) {
+        usage(argv[0]);
+        return 1;
+    }
+    for (uint32_t c = 0; c < s->num_cols; c++) {
+        s->dids[c] = strtoul(argv[optind + c], NULL, 16);
+    }
+
+    if (uds_tool_init(ifname, phys, resp, "log") < 0) {
+        return 1;
+    }
+    if ((session && uds_tool_change_session(session) < 0) || (level && uds_tool_unlock(level) < 0)) {
+        return 1;
+    }
+    return record(s, out_path, rate_hz, duration, use_periodic, periodic_mode) < 0 ? 1 : 0;
+}
@@ -0,0 +1,369 @@
+// 微基准：ISO-TP编解码与UDS解析原语的单次开销（cycles/op、ns/op），用于优化前后A/B对比
+// 直接包含iso14229.c以访问其中的static函数；ISO-TP的CAN收发走内存，不经过套接字
+//   ./uds_microbench [-c cpu] [-n 迭代次数] [-r 轮数] [-f 名称子串] [-o file]
+// 每项先预热，再跑 -r 轮、每轮 -n 次，取最快一轮（最少受中断和调度干扰）
+// cycles为TSC计数（恒定频率的参考周期，不随睿频变化），非x86平台输出0
+#define _GNU_SOURCE
+#define UDS_TP_ISOTP_C
+#include "iso14229.c"
+
+#include <getopt.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include "uds_rt.h"
+#include "uds_server.h"
+
+#define MB_TX_ID 0x7E8
+#define MB_DEFAULT_ITERS 200000
+#define MB_DEFAULT_ROUNDS 5
+#define MB_WARMUP_ITERS 10000
+#define MB_MAX_DIDS 32
+#define MB_DID_LEN 4
+
+// ============== 内存传输 ==============
+// isotp-c的用户函数：发送只记录最后一帧；时钟保持不动，STmin为0时不影响分段发送，也不会触发N_Bs/N_Cr超时
+static uint8_t g_last_frame[8];
+static uint32_t g_frames_sent;
+static uint32_t g_clock_us;
+
+int isotp_user_send_can(const uint32_t arbitration_id, const uint8_t *data, const uint8_t size,
+                        void *arg) {
+    (void)arbitration_id;
+    (void)arg;
+    memcpy(g_last_frame, data, size);
+    g_frames_sent++;
+    return ISOTP_RET_OK;
+}
+
+uint32_t isotp_user_get_us(void) { return g_clock_us; }
+
+void isotp_user_debug(const char *message, ...) { (void)message; }
+
+// ============== 计时 ==============
+static inline uint64_t mb_cycles(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+static inline uint64_t mb_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// 防止结果被编译器当作无用计算删除
+static volatile uint32_t g_sink;
+
+// 每个被测项：setup一次（可为NULL），然后op被连续调用n次
+typedef struct {
+    const char *name;
+    void (*setup)(void);
+    void (*op)(uint32_t i);
+} mb_case_t;
+
+// ============== ISO-TP接收 ==============
+static IsoTpLink g_link;
+static uint8_t g_link_tx[UDS_ISOTP_MTU];
+static uint8_t g_link_rx[UDS_ISOTP_MTU];
+
+static void link_setup(void) {
+    isotp_init_link(&g_link, MB_TX_ID, g_link_tx, sizeof(g_link_tx), g_link_rx,
+                    sizeof(g_link_rx));
+}
+
+static void op_rx_sf(uint32_t i) {
+    uint8_t f[8] = {0x07, 0x22, 0xF1, 0x90, 0x00, 0x00, 0x00, (uint8_t)i};
+    isotp_on_can_message(&g_link, f, sizeof(f));
+    g_sink += g_link.receive_size;
+}
+
+// 首帧：含解析、状态切换和流控帧发送
+static void op_rx_ff(uint32_t i) {
+    uint8_t f[8] = {0x1F, 0xFF, 0x36, 0x01, 0x00, 0x00, 0x00, (uint8_t)i};
+    isotp_on_can_message(&g_link, f, sizeof(f));
+    g_sink += g_link.receive_size;
+}
+
+// 连续帧：4095字节报文循环接收，收满后在计时内重发首帧（约每585帧一次）
+static void op_rx_cf(uint32_t i) {
+    if (g_link.receive_status != ISOTP_RECEIVE_STATUS_INPROGRESS) {
+        uint8_t ff[8] = {0x1F, 0xFF, 0x36, 0x01, 0x00, 0x00, 0x00, 0x00};
+        isotp_on_can_message(&g_link, ff, sizeof(ff));
+    }
+    uint8_t f[8] = {0x20 | ((g_link.receive_sn) & 0x0F), 1, 2, 3, 4, 5, 6, (uint8_t)i};
+    isotp_on_can_message(&g_link, f, sizeof(f));
+    g_sink += g_link.receive_offset;
+}
+
+// ============== ISO-TP发送 ==============
+static uint8_t g_tx_payload[UDS_ISOTP_MTU];
+
+static void op_tx_sf(uint32_t i) {
+    g_tx_payload[1] = (uint8_t)i;
+    isotp_send_with_id(&g_link, MB_TX_ID, g_tx_payload, 7);
+    g_sink += g_last_frame[0];
+}
+
+// 整条报文的分段发送：首帧 + 流控(BS=0, STmin=0) + 逐次isotp_poll发出全部连续帧
+static void tx_message(uint16_t size) {
+    static const uint8_t fc[3] = {0x30, 0x00, 0x00};
+    isotp_send_with_id(&g_link, MB_TX_ID, g_tx_payload, size);
+    isotp_on_can_message(&g_link, fc, sizeof(fc));
+    while (g_link.send_status == ISOTP_SEND_STATUS_INPROGRESS) {
+        isotp_poll(&g_link);
+    }
+    g_sink += g_frames_sent;
+}
+
+static void op_tx_64(uint32_t i) {
+    (void)i;
+    tx_message(64);
+}
+
+static void op_tx_4095(uint32_t i) {
+    (void)i;
+    tx_message(UDS_ISOTP_MTU);
+}
+
+// ============== UDS服务器侧解析 ==============
+static UDSServer_t g_srv;
+static uint8_t g_srv_recv[UDS_ISOTP_MTU];
+static uint8_t g_srv_send[UDS_ISOTP_MTU];
+static const uint8_t g_did_data[MB_DID_LEN] = {0xDE, 0xAD, 0xBE, 0xEF};
+
+static int mb_srv_fn(UDSServer_t *srv, UDSEvent_t ev, void *arg) {
+    if (ev != UDS_EVT_ReadDataByIdent) {
+        return UDS_NRC_ServiceNotSupported;
+    }
+    UDSRDBIArgs_t *r = (UDSRDBIArgs_t *)arg;
+    return r->copy(srv, g_did_data, sizeof(g_did_data));
+}
+
+static void srv_setup(void) {
+    memset(&g_srv, 0, sizeof(g_srv));
+    g_srv.fn = mb_srv_fn;
+    g_srv.r.recv_buf = g_srv_recv;
+    g_srv.r.send_buf = g_srv_send;
+    g_srv.r.send_buf_size = sizeof(g_srv_send);
+}
+
+// 23 44 <addr32> <size32>
+static void decode_setup(void) {
+    static const uint8_t req[] = {0x23, 0x44, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00};
+    srv_setup();
+    memcpy(g_srv_recv, req, sizeof(req));
+    g_srv.r.recv_len = sizeof(req);
+}
+
+static void op_decode(uint32_t i) {
+    void *addr;
+    size_t size;
+    g_srv_recv[5] = (uint8_t)i;
+    decodeAddressAndLength(&g_srv.r, &g_srv_recv[1], &addr, &size);
+    g_sink += (uint32_t)(uintptr_t)addr + (uint32_t)size;
+}
+
+static void op_safe_copy(uint32_t i) {
+    (void)i;
+    g_srv.r.send_len = 3;
+    safe_copy(&g_srv, g_did_data, sizeof(g_did_data));
+    g_sink += g_srv.r.send_len;
+}
+
+static void rdbi_setup(int n) {
+    srv_setup();
+    g_srv_recv[0] = kSID_READ_DATA_BY_IDENTIFIER;
+    for (int k = 0; k < n; k++) {
+        g_srv_recv[1 + 2 * k] = 0xF1;
+        g_srv_recv[2 + 2 * k] = (uint8_t)k;
+    }
+    g_srv.r.recv_len = 1 + 2 * n;
+}
+
+static void rdbi_setup_1(void) { rdbi_setup(1); }
+static void rdbi_setup_8(void) { rdbi_setup(8); }
+static void rdbi_setup_32(void) { rdbi_setup(32); }
+
+static void op_rdbi(uint32_t i) {
+    (void)i;
+    _0x22_ReadDataByIdentifier(&g_srv, &g_srv.r);
+    g_sink += g_srv.r.send_len;
+}
+
+// ============== UDS客户端侧解析 ==============
+static UDSClient_t g_client;
+static uint8_t g_client_recv[UDS_ISOTP_MTU];
+static UDSRDBIVar_t g_vars[MB_MAX_DIDS];
+static uint8_t g_var_data[MB_MAX_DIDS][MB_DID_LEN];
+static int g_nvars;
+
+static void unpack_setup(int n) {
+    memset(&g_client, 0, sizeof(g_client));
+    g_client.recv_buf = g_client_recv;
+    g_client.recv_buf_size = sizeof(g_client_recv);
+    g_client_recv[0] = UDS_RESPONSE_SID_OF(kSID_READ_DATA_BY_IDENTIFIER);
+    uint16_t off = UDS_0X22_RESP_BASE_LEN;
+    for (int k = 0; k < n; k++) {
+        g_client_recv[off++] = 0xF1;
+        g_client_recv[off++] = (uint8_t)k;
+        memcpy(&g_client_recv[off], g_did_data, MB_DID_LEN);
+        off += MB_DID_LEN;
+        g_vars[k].did = 0xF100 | k;
+        g_vars[k].len = MB_DID_LEN;
+        g_vars[k].data = g_var_data[k];
+        g_vars[k].UnpackFn = memmove;
+    }
+    g_client.recv_size = off;
+    g_nvars = n;
+}
+
+static void unpack_setup_1(void) { unpack_setup(1); }
+static void unpack_setup_8(void) { unpack_setup(8); }
+static void unpack_setup_32(void) { unpack_setup(32); }
+
+static void op_unpack(uint32_t i) {
+    (void)i;
+    g_sink += UDSUnpackRDBIResponse(&g_client, g_vars, g_nvars);
+}
+
+// ============== 0x27密钥算法 ==============
+static void op_calc_key(uint32_t i) { g_sink += calc_key(i * 2654435761u); }
+static void op_calc_key3(uint32_t i) { g_sink += calc_key_level3(i * 2654435761u); }
+static void op_calc_key5(uint32_t i) { g_sink += calc_key_level5(i * 2654435761u); }
+
+static const mb_case_t g_cases[] = {
+    {"isotp_rx_sf", link_setup, op_rx_sf},
+    {"isotp_rx_ff", link_setup, op_rx_ff},
+    {"isotp_rx_cf", link_setup, op_rx_cf},
+    {"isotp_tx_sf", link_setup, op_tx_sf},
+    {"isotp_tx_64", link_setup, op_tx_64},
+    {"isotp_tx_4095", link_setup, op_tx_4095},
+    {"decode_addr_len", decode_setup, op_decode},
+    {"safe_copy", srv_setup, op_safe_copy},
+    {"rdbi_1", rdbi_setup_1, op_rdbi},
+    {"rdbi_8", rdbi_setup_8, op_rdbi},
+    {"rdbi_32", rdbi_setup_32, op_rdbi},
+    {"unpack_rdbi_1", unpack_setup_1, op_unpack},
+    {"unpack_rdbi_8", unpack_setup_8, op_unpack},
+    {"unpack_rdbi_32", unpack_setup_32, op_unpack},
+    {"calc_key", NULL, op_calc_key},
+    {"calc_key_level3", NULL, op_calc_key3},
+    {"calc_key_level5", NULL, op_calc_key5},
+};
+
+typedef struct {
+    double ns_per_op;
+    double cycles_per_op;
+} mb_result_t;
+
+static mb_result_t run_case(const mb_case_t *c, uint32_t iters, int rounds) {
+    mb_result_t best = {0, 0};
+    if (c->setup) {
+        c->setup();
+    }
+    for (uint32_t i = 0; i < MB_WARMUP_ITERS; i++) {
+        c->op(i);
+    }
+    for (int r = 0; r < rounds; r++) {
+        uint64_t t0 = mb_ns();
+        uint64_t c0 = mb_cycles();
+        for (uint32_t i = 0; i < iters; i++) {
+            c->op(i);
+        }
+        uint64_t c1 = mb_cycles();
+        uint64_t t1 = mb_ns();
+        double ns = (double)(t1 - t0) / iters;
+        if (r == 0 || ns < best.ns_per_op) {
+            best.ns_per_op = ns;
+            best.cycles_per_op = (double)(c1 - c0) / iters;
+        }
+    }
+    return best;
+}
+
+static void usage(const char *prog) {
+    printf("用法: %s [-c cpu] [-n iters] [-r rounds] [-f filter] [-o file]\n", prog);
+    printf("  -c cpu     绑定到指定CPU（默认0，-1不绑定）\n");
+    printf("  -n iters   每轮迭代次数（默认%d）\n", MB_DEFAULT_ITERS);
+    printf("  -r rounds  轮数，取最快一轮（默认%d）\n", MB_DEFAULT_ROUNDS);
+    printf("  -f filter  只运行名称包含该子串的项\n");
+    printf("  -o file    另外把结果以JSON写入文件，便于对比两次运行\n");
+}
+
+int main(int argc, char **argv) {
+    uds_rt_config_t rt = {.realtime = 0, .cpu = 0, .priority = 0, .busy_poll = 0};
+    uint32_t iters = MB_DEFAULT_ITERS;
+    int rounds = MB_DEFAULT_ROUNDS;
+    const char *filter = NULL;
+    const char *out_path = NULL;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "c:n:r:f:o:h")) != -1) {
+        switch (opt) {
+        case 'c':
+            rt.cpu = atoi(optarg);
+            break;
+        case 'n':
+            iters = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        case 'r':
+            rounds = atoi(optarg);
+            break;
+        case 'f':
+            filter = optarg;
+            break;
+        case 'o':
+            out_path = optarg;
+            break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (iters == 0 || rounds <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (rt.cpu >= 0) {
+        uds_rt_apply(&rt);
+    }
+
+    FILE *out = NULL;
+    if (out_path) {
+        out = fopen(out_path, "w");
+        if (!out) {
+            perror(out_path);
+            return 1;
+        }
+        fprintf(out, "{\"cpu\":%d,\"iters\":%u,\"rounds\":%d,\"results\":[", rt.cpu, iters,
+                rounds);
+    }
+    printf("%-18s %12s %12s\n", "name", "ns/op", "cycles/op");
+    int first = 1;
+    for (size_t k = 0; k < sizeof(g_cases) / sizeof(g_cases[0]); k++) {
+        const mb_case_t *c = &g_cases[k];
+        if (filter && !strstr(c->name, filter)) {
+            continue;
+        }
+        mb_result_t res = run_case(c, iters, rounds);
+        printf("%-18s %12.2f %12.1f\n", c->name, res.ns_per_op, res.cycles_per_op);
+        fflush(stdout);
+        if (out) {
+            fprintf(out, "%s{\"name\":\"%s\",\"ns_per_op\":%.2f,\"cycles_per_op\":%.1f}",
+                    first ? "" : ",", c->name, res.ns_per_op, res.cycles_per_op);
+        }
+        first = 0;
+    }
+    if (out) {
+        fprintf(out, "]}\n");
+        fclose(out);
+    }
+    return 0;
+}
@@ -0,0 +1,146 @@
+#include "uds_perf.h"
+#include <errno.h>
+#include <linux/perf_event.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+typedef struct {
+    const char *name;
+    uint32_t type;
+    uint64_t config;
+} perf_event_spec_t;
+
+#define HW_CACHE_READ_MISS(cache) \
+    ((cache) | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+
+// 硬件事件排在前面，可用时由硬件事件担任组长
+static const perf_event_spec_t g_events[UDS_PERF_COUNT] = {
+    [UDS_PERF_CYCLES] = { "cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+    [UDS_PERF_INSTRUCTIONS] = { "instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+    [UDS_PERF_L1D_MISSES] = { "l1d_misses", PERF_TYPE_HW_CACHE, HW_CACHE_READ_MISS(PERF_COUNT_HW_CACHE_L1D) },
+    [UDS_PERF_LLC_MISSES] = { "llc_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+    [UDS_PERF_BRANCH_MISSES] = { "branch_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+    [UDS_PERF_TASK_CLOCK] = { "task_clock_ns", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK },
+    [UDS_PERF_CTX_SWITCHES] = { "context_switches", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES },
+    [UDS_PERF_PAGE_FAULTS] = { "page_faults", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS },
+};
+
+const char *uds_perf_name(int event) {
+    return event >= 0 && event < UDS_PERF_COUNT ? g_events[event].name : "?";
+}
+
+static int perf_event_open(struct perf_event_attr *attr, pid_t tid, int group_fd) {
+    return (int)syscall(SYS_perf_event_open, attr, tid, -1, group_fd, PERF_FLAG_FD_CLOEXEC);
+}
+
+static int open_event(const perf_event_spec_t *spec, pid_t tid, int group_fd) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = spec->type;
+    attr.config = spec->config;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+                       PERF_FORMAT_TOTAL_TIME_RUNNING;
+    // 内核态也计入（收发CAN帧的系统调用属于热路径），perf_event_paranoid不允许时只计用户态
+    int fd = perf_event_open(&attr, tid, group_fd);
+    if (fd < 0 && (errno == EACCES || errno == EPERM)) {
+        attr.exclude_kernel = 1;
+        fd = perf_event_open(&attr, tid, group_fd);
+    }
+    return fd;
+}
+
+int uds_perf_open(uds_perf_t *p, pid_t tid, clockid_t cpu_clock) {
+    memset(p, 0, sizeof(*p));
+    p->leader = -1;
+    int available = 0;
+    for (int e = 0; e < UDS_PERF_COUNT; e++) {
+        p->fd[e] = open_event(&g_events[e], tid, p->leader);
+        if (p->fd[e] < 0) {
+            continue;
+        }
+        if (p->leader < 0) {
+            p->leader = p->fd[e];
+        }
+        p->slot[e] = p->n++;
+        available++;
+    }
+    if (p->leader < 0) {
+        fprintf(stderr, "[LOG] perf_event_open不可用(%s)，仅以线程CPU时钟计时\n", strerror(errno));
+        p->use_clock = 1;
+        p->clock = cpu_clock;
+        return 1;
+    }
+    if (!uds_perf_has_hardware(p)) {
+        fprintf(stderr, "[LOG] 硬件性能计数器不可用，仅使用软件计数器\n");
+    }
+    return available;
+}
+
+void uds_perf_close(uds_perf_t *p) {
+    for (int e = 0; e < UDS_PERF_COUNT; e++) {
+        if (p->fd[e] >= 0) {
+            close(p->fd[e]);
+        }
+        p->fd[e] = -1;
+    }
+    p->leader = -1;
+}
+
+int uds_perf_available(const uds_perf_t *p, int event) {
+    if (p->use_clock) {
+        return event == UDS_PERF_TASK_CLOCK;
+    }
+    return p->fd[event] >= 0;
+}
+
+int uds_perf_has_hardware(const uds_perf_t *p) {
+    for (int e = 0; e < UDS_PERF_COUNT; e++) {
+        if (g_events[e].type != PERF_TYPE_SOFTWARE && uds_perf_available(p, e)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int uds_perf_read(const uds_perf_t *p, uds_perf_sample_t *s) {
+    memset(s, 0, sizeof(*s));
+    if (p->use_clock) {
+        struct timespec ts;
+        if (clock_gettime(p->clock, &ts) < 0) {
+            return -1;
+        }
+        s->v[UDS_PERF_TASK_CLOCK] = (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+        return 0;
+    }
+    // PERF_FORMAT_GROUP: nr, time_enabled, time_running, values[nr]
+    uint64_t buf[3 + UDS_PERF_COUNT];
+    ssize_t n = read(p->leader, buf, sizeof(buf));
+    if (n < (ssize_t)(3 * sizeof(uint64_t)) || buf[0] != (uint64_t)p->n) {
+        return -1;
+    }
+    uint64_t enabled = buf[1];
+    uint64_t running = buf[2];
+    for (int e = 0; e < UDS_PERF_COUNT; e++) {
+        if (p->fd[e] < 0) {
+            continue;
+        }
+        uint64_t v = buf[3 + p->slot[e]];
+        // 计数器被多路复用时按运行时间比例外推
+        if (running && running < enabled) {
+            v = (uint64_t)((double)v * enabled / running);
+        }
+        s->v[e] = v;
+    }
+    return 0;
+}
+
+void uds_perf_accumulate(uds_perf_sample_t *acc, const uds_perf_sample_t *a,
+                         const uds_perf_sample_t *b) {
+    for (int e = 0; e < UDS_PERF_COUNT; e++) {
+        acc->v[e] += b->v[e] - a->v[e];
+    }
+}
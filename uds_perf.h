@@ -0,0 +1,55 @@
+#ifndef UDS_PERF_H
+#define UDS_PERF_H
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <time.h>
+
+// perf_event_open计数器组：按线程计数，基准测试在每批请求前后各读一次取差值
+// 容器内通常没有硬件PMU（ENOENT/EOPNOTSUPP）或被seccomp禁止，此时只保留能打开的软件事件；
+// perf_event_open完全不可用时，task_clock改由线程CPU时钟提供
+enum {
+    UDS_PERF_CYCLES,
+    UDS_PERF_INSTRUCTIONS,
+    UDS_PERF_L1D_MISSES,
+    UDS_PERF_LLC_MISSES,
+    UDS_PERF_BRANCH_MISSES,
+    UDS_PERF_TASK_CLOCK, // 纳秒
+    UDS_PERF_CTX_SWITCHES,
+    UDS_PERF_PAGE_FAULTS,
+    UDS_PERF_COUNT,
+};
+
+typedef struct {
+    uint64_t v[UDS_PERF_COUNT];
+} uds_perf_sample_t;
+
+typedef struct {
+    int leader;              // 组长fd，-1表示没有任何perf事件
+    int fd[UDS_PERF_COUNT];  // -1表示该事件不可用
+    int slot[UDS_PERF_COUNT]; // 在组读出结果中的下标
+    int n;                   // 组内事件数
+    int use_clock;           // 以clock代替task_clock
+    clockid_t clock;
+} uds_perf_t;
+
+// 事件名，用作JSON字段名
+const char *uds_perf_name(int event);
+
+// 为线程tid（0为调用线程）打开计数器组；cpu_clock为该线程的CPU时钟（pthread_getcpuclockid），
+// 仅在perf_event_open不可用时使用。返回可用事件数，降级情况打印到stderr
+int uds_perf_open(uds_perf_t *p, pid_t tid, clockid_t cpu_clock);
+void uds_perf_close(uds_perf_t *p);
+
+int uds_perf_available(const uds_perf_t *p, int event);
+// 是否有硬件事件（否则只有软件计数）
+int uds_perf_has_hardware(const uds_perf_t *p);
+
+// 读取当前累计值（按多路复用比例缩放），失败返回-1
+int uds_perf_read(const uds_perf_t *p, uds_perf_sample_t *s);
+
+// acc += b - a
+void uds_perf_accumulate(uds_perf_sample_t *acc, const uds_perf_sample_t *a,
+                         const uds_perf_sample_t *b);
+
+#endif
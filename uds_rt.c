@@ -0,0 +1,117 @@
+#define _GNU_SOURCE
+#include "uds_rt.h"
+#include <errno.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+static uint32_t g_lat_ns[UDS_LAT_SAMPLES]; // 环形缓冲，保留最近的样本
+static uint64_t g_lat_count = 0;
+
+static void prefault_stack(void) {
+    volatile uint8_t stack[UDS_RT_STACK_PREFAULT];
+    long page = sysconf(_SC_PAGESIZE);
+    for (size_t i = 0; i < sizeof(stack); i += page) {
+        stack[i] = 0;
+    }
+}
+
+void uds_rt_prefault(void *buf, size_t len) {
+    long page = sysconf(_SC_PAGESIZE);
+    volatile uint8_t *p = buf;
+    for (size_t i = 0; i < len; i += page) {
+        p[i] = p[i];
+    }
+}
+
+int uds_rt_apply(const uds_rt_config_t *cfg) {
+    int failures = 0;
+
+    if (cfg->cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cfg->cpu, &set);
+        if (sched_setaffinity(0, sizeof(set), &set) < 0) {
+            printf("[LOG] 绑定CPU%d失败: %s\n", cfg->cpu, strerror(errno));
+            failures++;
+        } else {
+            printf("[LOG] 已绑定到CPU%d\n", cfg->cpu);
+        }
+    }
+
+    if (cfg->realtime) {
+        struct sched_param sp = { .sched_priority = cfg->priority };
+        if (sched_setscheduler(0, SCHED_FIFO, &sp) < 0) {
+            printf("[LOG] 设置SCHED_FIFO(%d)失败: %s（需要CAP_SYS_NICE）\n", cfg->priority,
+                   strerror(errno));
+            failures++;
+        } else {
+            printf("[LOG] 调度策略: SCHED_FIFO, 优先级%d\n", cfg->priority);
+        }
+        if (mlockall(MCL_CURRENT | MCL_FUTURE) < 0) {
+            printf("[LOG] mlockall失败: %s（需要CAP_IPC_LOCK或足够的RLIMIT_MEMLOCK）\n",
+                   strerror(errno));
+            failures++;
+        } else {
+            printf("[LOG] 已锁定进程内存\n");
+        }
+        prefault_stack();
+        uds_rt_prefault(g_lat_ns, sizeof(g_lat_ns));
+    }
+
+    return failures;
+}
+
+// SCHED_FIFO下忙轮询永不让出CPU，只有一个CPU时会把系统其余部分饿死
+int uds_rt_busy_poll_allowed(const uds_rt_config_t *cfg) {
+    if (!cfg->busy_poll) {
+        return 0;
+    }
+    if (cfg->realtime && sysconf(_SC_NPROCESSORS_ONLN) < 2) {
+        printf("[LOG] 只有一个CPU，实时模式下不启用忙轮询\n");
+        return 0;
+    }
+    printf("[LOG] 忙轮询模式: 事件循环不再睡眠\n");
+    return 1;
+}
+
+uint64_t uds_rt_realtime_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void uds_lat_record(uint64_t ns) {
+    g_lat_ns[g_lat_count % UDS_LAT_SAMPLES] = ns > UINT32_MAX ? UINT32_MAX : (uint32_t)ns;
+    g_lat_count++;
+}
+
+static int cmp_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static double percentile_us(const uint32_t *sorted, size_t n, double q) {
+    size_t idx = (size_t)(q * (n - 1) + 0.5);
+    return sorted[idx] / 1000.0;
+}
+
+// 报告在原地排序样本，只在退出时调用
+void uds_lat_report(FILE *out) {
+    size_t n = g_lat_count < UDS_LAT_SAMPLES ? g_lat_count : UDS_LAT_SAMPLES;
+    fprintf(out, "=== 响应延迟统计（请求最后一帧到达 -> 响应首帧发出）===\n");
+    if (n == 0) {
+        fprintf(out, "无样本\n");
+        return;
+    }
+    qsort(g_lat_ns, n, sizeof(g_lat_ns[0]), cmp_u32);
+    fprintf(out, "样本数: %llu (统计最近%zu个)\n", (unsigned long long)g_lat_count, n);
+    fprintf(out, "min %.1fus  p50 %.1fus  p90 %.1fus  p99 %.1fus  p99.9 %.1fus  max %.1fus\n",
+            g_lat_ns[0] / 1000.0, percentile_us(g_lat_ns, n, 0.50),
+            percentile_us(g_lat_ns, n, 0.90), percentile_us(g_lat_ns, n, 0.99),
+            percentile_us(g_lat_ns, n, 0.999), g_lat_ns[n - 1] / 1000.0);
+    fflush(out);
+}
@@ -0,0 +1,36 @@
+#ifndef UDS_RT_H
+#define UDS_RT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// 实时运行配置（命令行 -r/-c/-p/-b）
+typedef struct {
+    int realtime;  // SCHED_FIFO + mlockall + 预触页
+    int cpu;       // 绑定的CPU，-1表示不绑定
+    int priority;  // SCHED_FIFO优先级
+    int busy_poll; // 事件循环不睡眠，poll超时恒为0
+} uds_rt_config_t;
+
+#define UDS_RT_DEFAULT_PRIORITY 80
+#define UDS_RT_STACK_PREFAULT (256 * 1024)
+
+// 按配置设置CPU亲和性、调度策略并锁定内存；返回失败的步骤数（权限不足时继续以普通方式运行）
+int uds_rt_apply(const uds_rt_config_t *cfg);
+
+// 是否启用忙轮询；实时模式下只有一个CPU时拒绝
+int uds_rt_busy_poll_allowed(const uds_rt_config_t *cfg);
+
+// 逐页写入，确保缓冲区在请求路径上不会触发缺页
+void uds_rt_prefault(void *buf, size_t len);
+
+// 单调时钟之外的墙上时钟纳秒数，与内核SO_TIMESTAMPNS时间戳同一时基
+uint64_t uds_rt_realtime_ns(void);
+
+// 响应延迟采样：请求最后一帧到达内核 -> 响应首帧写出
+#define UDS_LAT_SAMPLES 65536
+void uds_lat_record(uint64_t ns);
+void uds_lat_report(FILE *out);
+
+#endif
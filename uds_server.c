@@ -11,27 +11,125 @@
 #include <net/if.h>
 #include <sys/ioctl.h>
 #include "iso14229.h"
+#include "uds_timer.h"
+#include "uds_arena.h"
+#include "uds_rt.h"
+#include "uds_stats.h"
+#include "uds_shm.h"
+#include "uds_server.h"
+#include "uds_ecu.h"
 #include <time.h>
-#include <sys/select.h>
+#include <poll.h>
+#include <fcntl.h>
 #include <signal.h>
+#include <sys/un.h>
+#include <sys/auxv.h>
+#include <link.h>
 
-#define PUBLIC_FLAG "UDSCTF{VINYICHEN00112233}"
-#define SECURE_FLAG "UDSCTF{27_securityX0r_C1C2}"
-#define ADVANCED_FLAG "UDSCTF{D1D2_Advanced_Flag}"
-#define BOOT_FLAG "UDSCTF{Reset_ThE_UDS_Server}"
-#define MEMORY_FLAG "UDSCTF{ReadMemory_T0_Find_Flag}"
-#define UDS_PHYS_ID 0x7E0
+#define UDS_PHYS_ID 0x7E0 // 默认物理寻址请求ID，-a可修改
+#define UDS_FUNC_ID 0x7DF // 功能寻址（广播）请求ID
 #define UDS_RESP_ID 0x7E8
 
+// 时间参数（毫秒）
+#define P2_SERVER_MS 50         // 与0x10响应中的P2一致
+#define P2_STAR_SERVER_MS 5000  // 与0x10响应中的P2*一致
+#define S3_SERVER_MS 10000      // 非默认会话保持时间
+#define N_AS_MS 1000            // 单帧写入总线的超时
+#define N_BS_MS 1000            // 等待流控帧的超时
+#define N_CR_MS 1000            // 等待下一个连续帧的超时
+#define RESET_DELAY_MS 3000     // 复位响应发出后到重启的延时
+
+#define UDS_MAX_RESP_LEN (2 + 0x1000) // 0x23最大响应
+#define ISOTP_FF_DL_MAX 4095          // 12位首帧长度上限，超过时使用32位长度的首帧
+#define UDS_ARENA_SIZE (16 * 1024)    // 重组缓冲 + 响应缓冲 + 处理函数临时空间
+#define SHM_PUBLISH_MS 100            // 共享内存指标段最短发布间隔
+
+// 运行日志；-q或实时模式下关闭，避免printf进入请求处理的延迟
+static int g_log_enabled = 1;
+#define LOG(...) do { if (g_log_enabled) printf("[LOG] " __VA_ARGS__); } while (0)
+
+static void log_hex(const uint8_t *data, int len) {
+    if (!g_log_enabled) {
+        return;
+    }
+    for (int i = 0; i < len; ++i) printf("%02X ", data[i]);
+    printf("\n");
+}
+
 // 全局ELF文件数据缓冲区
 static uint8_t *g_elf_data = NULL;
 static size_t g_elf_size = 0;
 
 static uint32_t g_seed = 0;
 static int security_unlocked = 0;
-static uint8_t current_session = 0x01; // 默认会话
+static uint8_t current_session = 0x01; // 当前会话，uds_server_init()置为ECU模型的默认会话
 static uint8_t security_level = 0; // 当前安全访问级别
-static time_t last_tester_present_time = 0; // 记录上次TesterPresent时间
+
+static int g_sock = -1;
+static uint32_t g_phys_id = UDS_PHYS_ID;
+static uint32_t g_resp_id = UDS_RESP_ID;
+static uds_timer_wheel_t g_timers;
+static uds_timer_t s3_timer;      // S3：非默认会话保持
+static uds_timer_t p2_timer;      // P2：请求到响应开始
+static uds_timer_t reset_timer;   // 复位响应发出后延时重启
+static uds_timer_t n_cr_timer;    // 接收：等待连续帧
+static uds_timer_t n_bs_timer;    // 发送：等待流控帧
+static uds_timer_t tx_timer;      // 发送：STmin间隔/ENOBUFS重试
+static uds_timer_t shm_timer;     // 共享内存指标段发布
+static uint64_t g_request_time = 0; // 当前请求接收完成的时刻
+static int g_reset_pending = 0;
+static uds_arena_t g_arena; // 请求处理路径上的全部内存，每个请求结束后复位
+static uds_rt_config_t g_rt = { .cpu = -1, .priority = UDS_RT_DEFAULT_PRIORITY };
+static uint64_t g_frame_rx_ns = 0;   // 当前帧到达内核的时刻（SO_TIMESTAMPNS）
+static uint64_t g_request_rx_ns = 0; // 当前请求最后一帧到达的时刻
+static int g_latency_pending = 0;    // 响应首帧发出时记录一次延迟
+static volatile sig_atomic_t g_stop = 0;
+static volatile sig_atomic_t g_dump_stats = 0; // SIGUSR1：输出请求处理统计
+static int g_stats_sock = -1;                   // -s：本地统计查询套接字
+static char g_stats_buf[32 * 1024];             // 统计文本，输出时不使用堆
+static uint64_t g_start_ms = 0;
+static uds_shm_t *g_shm = NULL; // -m：共享内存指标段
+
+// 自诊断计数器（0xFDxx DID）：只在事件循环线程中更新和读取，读取时构造的快照天然一致
+static struct {
+    uint32_t frames_rx;      // 收到的全部CAN帧
+    uint32_t frames_tx;      // 写出的帧（含FC）
+    uint32_t frames_dropped; // 被丢弃的诊断帧（格式错误、忙、等待复位、SN错误等）
+    uint32_t rx_multi;       // 完成的多帧接收
+    uint32_t tx_multi;       // 完成的多帧发送
+    uint32_t requests;       // 进入服务分发的请求
+    uint32_t bytes_rx;       // 请求UDS数据字节数
+    uint32_t bytes_tx;       // 发送完成的响应UDS数据字节数
+} g_perf;
+
+// 上一次读取0xFD01时的快照，用于计算速率
+static struct {
+    uint64_t ms;
+    uint32_t frames_rx, frames_tx, bytes_rx, bytes_tx;
+} g_perf_rate_mark;
+
+// ISO-TP多帧接收状态
+static struct {
+    uint8_t *data; // 非NULL表示正在接收
+    uint16_t total;
+    uint16_t received;
+    uint8_t sn;
+} g_rx;
+
+// ISO-TP发送状态
+static struct {
+    int active;
+    int wait_fc;
+    uint8_t data[UDS_MAX_RESP_LEN];
+    size_t len;
+    size_t sent;            // 已装入帧的数据字节数
+    uint8_t sn;
+    uint8_t bs;             // FC中的块大小，0表示不分块
+    uint8_t block_left;
+    uint32_t stmin_ms;
+    uint64_t as_deadline;   // 当前帧的N_As截止时刻
+    struct can_frame frame; // 下一个待发送的帧
+} g_tx;
 
 // 信号处理函数
 void segfault_handler(int sig) {
@@ -43,62 +141,17 @@ uint32_t generate_seed() {
     return (uint32_t)rand();
 }
 
-uint32_t calc_key(uint32_t seed) {
-    return seed ^ 0xdeadbeef;
-}
-
-uint32_t calc_key_level3(uint32_t seed) {
-    // 更复杂的级别3密钥算法
-    uint32_t key = seed;
-    
-    // 步骤1: 循环左移
-    key = (key << 7) | (key >> 25);
-    
-    // 步骤2: 异或操作
-    key ^= 0xCAFEBABE;
-    
-    // 步骤3: 加法运算
-    key += 0x12345678;
-    
-    // 步骤4: 位运算
-    key = (key & 0xFFFF0000) | ((key & 0x0000FFFF) ^ 0xABCD);
-    
-    // 步骤5: 最终异或
-    key ^= 0xDEADBEEF;
-    
-    return key;
-}
-
-uint32_t calc_key_level5(uint32_t seed) {
-    // 级别5密钥算法 - 更复杂
-    uint32_t key = seed;
-    
-    // 步骤1: 多重异或
-    key ^= 0x12345678;
-    key ^= 0x87654321;
-    
-    // 步骤2: 循环右移
-    key = (key >> 13) | (key << 19);
-    
-    // 步骤3: 位运算
-    key = (key & 0xFF00FF00) | ((key & 0x00FF00FF) ^ 0x55555555);
-    
-    // 步骤4: 加法运算
-    key += 0xDEADBEEF;
-    
-    // 步骤5: 最终异或
-    key ^= 0xCAFEBABE;
-    
-    return key;
-}
-
 // 发送启动flag
 void send_boot_flag(int s) {
-    printf("[LOG] 发送启动flag: %s\n", BOOT_FLAG);
+    const char *msg = uds_ecu_boot_message;
+    if (!msg) {
+        return;
+    }
+    LOG("发送启动flag: %s\n", msg);
     
     // 直接发送启动flag，不等待流控帧
     struct can_frame txf;
-    txf.can_id = UDS_RESP_ID;
+    txf.can_id = g_resp_id;
     
     // 构造UDS响应格式：0x62 + DID + flag数据
     uint8_t uds_header[3];
@@ -106,13 +159,13 @@ void send_boot_flag(int s) {
     uds_header[1] = 0x00; // 虚拟DID高字节
     uds_header[2] = 0x00; // 虚拟DID低字节
     
-    size_t total_len = 3 + strlen(BOOT_FLAG);
+    size_t total_len = 3 + strlen(msg);
     
     if (total_len <= 7) {
         // 单帧发送
         txf.data[0] = total_len; // ISO-TP长度字段
         memcpy(&txf.data[1], uds_header, 3);
-        memcpy(&txf.data[4], BOOT_FLAG, strlen(BOOT_FLAG));
+        memcpy(&txf.data[4], msg, strlen(msg));
         txf.can_dlc = 1 + total_len;
     } else {
         // 多帧发送（简化版，不等待FC帧）
@@ -120,18 +173,18 @@ void send_boot_flag(int s) {
         txf.data[0] = 0x10 | ((total_len >> 8) & 0x0F);
         txf.data[1] = total_len & 0xFF;
         memcpy(&txf.data[2], uds_header, 3);
-        memcpy(&txf.data[5], BOOT_FLAG, 3); // 只复制前3字节
+        memcpy(&txf.data[5], msg, 3); // 只复制前3字节
         txf.can_dlc = 8;
         write(s, &txf, sizeof(struct can_frame));
         
         // 连续帧发送剩余数据
         size_t sent = 3;
         uint8_t sn = 1;
-        while (sent < strlen(BOOT_FLAG)) {
+        while (sent < strlen(msg)) {
             txf.data[0] = 0x20 | (sn & 0x0F);
-            size_t remain = strlen(BOOT_FLAG) - sent;
+            size_t remain = strlen(msg) - sent;
             size_t chunk = remain > 7 ? 7 : remain;
-            memcpy(&txf.data[1], BOOT_FLAG + sent, chunk);
+            memcpy(&txf.data[1], msg + sent, chunk);
             txf.can_dlc = 1 + chunk;
             write(s, &txf, sizeof(struct can_frame));
             sent += chunk;
@@ -139,263 +192,506 @@ void send_boot_flag(int s) {
             usleep(1000 * 10); // 10ms间隔
         }
         
-        printf("[LOG] 启动flag已发送到CAN总线 (ID: 0x%03X)\n", txf.can_id);
+        LOG("启动flag已发送到CAN总线 (ID: 0x%03X)\n", txf.can_id);
         sleep(1);
         return;
     }
     
     // 单帧发送
     write(s, &txf, sizeof(struct can_frame));
-    printf("[LOG] 启动flag已发送到CAN总线 (ID: 0x%03X)\n", txf.can_id);
+    LOG("启动flag已发送到CAN总线 (ID: 0x%03X)\n", txf.can_id);
     
     // 等待一秒确保消息发送完成
     sleep(1);
 }
 
-// ISO-TP多帧发送（原始数据，无DID）
-void send_isotp_response_raw(int s, const uint8_t *data, size_t data_len) {
-    struct can_frame txf;
-    txf.can_id = UDS_RESP_ID;
-    
-    if (data_len <= 7) {
-        // 单帧发送
-        txf.data[0] = data_len; // 单帧长度字段
-        memcpy(&txf.data[1], data, data_len);
-        txf.can_dlc = 1 + data_len;
-        printf("[LOG] [ISOTP] 单帧发送: ");
-        for (int i = 0; i < txf.can_dlc; ++i) printf("%02X ", txf.data[i]);
-        printf("\n");
-        write(s, &txf, sizeof(struct can_frame));
+// 请求开始响应：取消P2定时器，同步处理超时也记录一次
+static void p2_response_started(void) {
+    if (!uds_timer_pending(&p2_timer)) {
         return;
     }
-    
-    // 多帧发送
-    // 1. 发送首帧
-    txf.data[0] = 0x10 | ((data_len >> 8) & 0x0F);
-    txf.data[1] = data_len & 0xFF;
-    size_t first_frame_data = 6;
-    memcpy(&txf.data[2], data, first_frame_data);
-    txf.can_dlc = 8;
-    printf("[LOG] [ISOTP] 首帧发送: ");
-    for (int i = 0; i < txf.can_dlc; ++i) printf("%02X ", txf.data[i]);
-    printf("\n");
-    write(s, &txf, sizeof(struct can_frame));
-    
-    // 2. 等待FC帧
-    if (!wait_fc_frame(s, 1000)) {
-        printf("[LOG] [ISOTP] 未收到FC帧，终止多帧发送\n");
+    uds_timer_stop(&g_timers, &p2_timer);
+    uint64_t elapsed = uds_now_ms() - g_request_time;
+    if (elapsed > P2_SERVER_MS) {
+        LOG("P2超时: 响应在请求后%llums才开始 (P2=%dms)\n",
+               (unsigned long long)elapsed, P2_SERVER_MS);
+    }
+}
+
+static void p2_timeout(uds_timer_t *t, void *arg) {
+    LOG("P2超时: 请求已超过%dms仍未开始响应\n", P2_SERVER_MS);
+}
+
+static void s3_timeout(uds_timer_t *t, void *arg) {
+    LOG("会话超时，自动回退到默认会话\n");
+    current_session = uds_ecu_sessions[0].id;
+    // 注意：安全访问状态在默认会话中仍然有效
+    // security_level 和 security_unlocked 保持不变
+}
+
+// S3：非默认会话下每个请求都重新计时
+static void s3_restart(void) {
+    if (current_session != uds_ecu_sessions[0].id) {
+        uds_timer_start(&g_timers, &s3_timer, S3_SERVER_MS);
+    } else {
+        uds_timer_stop(&g_timers, &s3_timer);
+    }
+}
+
+// 输出请求处理统计（SIGUSR1、退出和复位时）
+static void stats_print(void) {
+    size_t n = uds_stats_format(g_stats_buf, sizeof(g_stats_buf));
+    fwrite(g_stats_buf, 1, n, stdout);
+    fflush(stdout);
+}
+
+// 发布到共享内存指标段：只在有新数据后由定时器触发，空闲时不唤醒事件循环
+static void shm_publish(uds_timer_t *t, void *arg) {
+    if (!g_shm) {
         return;
     }
-    
-    // 3. 发送连续帧
-    size_t sent = first_frame_data;
-    uint8_t sn = 1;
-    while (sent < data_len) {
-        txf.data[0] = 0x20 | (sn & 0x0F);
-        size_t remain = data_len - sent;
-        size_t chunk = remain > 7 ? 7 : remain;
-        memcpy(&txf.data[1], data + sent, chunk);
-        txf.can_dlc = 1 + chunk;
-        printf("[LOG] [ISOTP] 连续帧SN=%d发送: ", sn);
-        for (int i = 0; i < txf.can_dlc; ++i) printf("%02X ", txf.data[i]);
-        printf("\n");
-        write(s, &txf, sizeof(struct can_frame));
-        sent += chunk;
-        sn = (sn + 1) & 0x0F;
-        usleep(1000 * 10);
-    }
-}
-
-// ISO-TP多帧发送（严格流控）
-int wait_fc_frame(int s, int timeout_ms) {
-    struct can_frame rx;
-    fd_set readfds;
-    struct timeval tv;
-    FD_ZERO(&readfds);
-    FD_SET(s, &readfds);
-    tv.tv_sec = timeout_ms / 1000;
-    tv.tv_usec = (timeout_ms % 1000) * 1000;
-    int ret = select(s + 1, &readfds, NULL, NULL, &tv);
-    if (ret > 0 && FD_ISSET(s, &readfds)) {
-        int nbytes = read(s, &rx, sizeof(struct can_frame));
-        if (nbytes > 0 && rx.can_id == UDS_PHYS_ID && rx.data[0] == 0x30) {
-            printf("[LOG] [ISOTP] 收到流控帧(FC): ");
-            for (int i = 0; i < rx.can_dlc; ++i) printf("%02X ", rx.data[i]);
-            printf("\n");
-            return 1;
-        } else {
-            printf("[LOG] [ISOTP] 收到非FC帧或can_id不符，忽略\n");
+    uds_shm_traffic_t *tr = &g_shm->traffic;
+    uds_shm_write_begin(&tr->seq);
+    tr->frames_rx = g_perf.frames_rx;
+    tr->frames_tx = g_perf.frames_tx;
+    tr->frames_dropped = g_perf.frames_dropped;
+    tr->rx_multi = g_perf.rx_multi;
+    tr->tx_multi = g_perf.tx_multi;
+    tr->requests = g_perf.requests;
+    tr->bytes_rx = g_perf.bytes_rx;
+    tr->bytes_tx = g_perf.bytes_tx;
+    tr->arena_high_water = g_arena.high_water;
+    tr->uptime_ms = uds_now_ms() - g_start_ms;
+    tr->publish_count++;
+    uds_shm_write_end(&tr->seq);
+    uds_shm_publish_stats(g_shm);
+}
+
+static void shm_mark_dirty(void) {
+    if (g_shm && !uds_timer_pending(&shm_timer)) {
+        uds_timer_start(&g_timers, &shm_timer, SHM_PUBLISH_MS);
+    }
+}
+
+static void reset_timeout(uds_timer_t *t, void *arg) {
+    LOG("正在重启UDS服务器...\n");
+    uds_lat_report(stdout);
+    stats_print();
+    exit(0); // 退出程序，Docker容器会自动重启
+}
+
+// FC中的STmin：0x00-0x7F为毫秒，0xF1-0xF9为100-900微秒（按时间轮精度取1ms），其余保留值按0x7F处理
+static uint32_t isotp_stmin_ms(uint8_t stmin) {
+    if (stmin <= 0x7F) {
+        return stmin;
+    }
+    if (stmin >= 0xF1 && stmin <= 0xF9) {
+        return 1;
+    }
+    return 0x7F;
+}
+
+static void isotp_tx_abort(void) {
+    if (g_tx.active) {
+        uds_stats_tx_aborted();
+        shm_mark_dirty();
+    }
+    g_tx.active = 0;
+    g_tx.wait_fc = 0;
+    uds_timer_stop(&g_timers, &n_bs_timer);
+    uds_timer_stop(&g_timers, &tx_timer);
+}
+
+static void isotp_tx_log(const struct can_frame *f) {
+    switch (f->data[0] >> 4) {
+    case 0x0:
+        LOG("[ISOTP] 单帧发送: ");
+        break;
+    case 0x1:
+        LOG("[ISOTP] 首帧发送: ");
+        break;
+    default:
+        LOG("[ISOTP] 连续帧SN=%d发送: ", f->data[0] & 0x0F);
+        break;
+    }
+    log_hex(f->data, f->can_dlc);
+}
+
+// 装入下一个连续帧
+static void isotp_tx_prepare_cf(void) {
+    struct can_frame *f = &g_tx.frame;
+    size_t remain = g_tx.len - g_tx.sent;
+    size_t chunk = remain > 7 ? 7 : remain;
+    f->data[0] = 0x20 | (g_tx.sn & 0x0F);
+    memcpy(&f->data[1], g_tx.data + g_tx.sent, chunk);
+    f->can_dlc = 1 + chunk;
+    g_tx.sent += chunk;
+    g_tx.sn = (g_tx.sn + 1) & 0x0F;
+    g_tx.as_deadline = uds_now_ms() + N_AS_MS;
+}
+
+// 写出g_tx.frame：成功返回1；发送队列满时在N_As内1ms后重试，返回0；失败终止发送，返回-1
+static int isotp_tx_write(void) {
+    if (write(g_sock, &g_tx.frame, sizeof(struct can_frame)) == sizeof(struct can_frame)) {
+        g_perf.frames_tx++;
+        UDS_TRACE2(frame_tx, g_tx.frame.data[0] >> 4, g_tx.sent);
+        if ((g_tx.frame.data[0] >> 4) <= 0x1) { // 单帧或首帧
+            uint64_t now_ns = uds_rt_realtime_ns();
+            if (g_latency_pending) {
+                uds_lat_record(now_ns - g_request_rx_ns);
+                g_latency_pending = 0;
+            }
+            int rcrrp = g_tx.len == 3 && g_tx.data[0] == 0x7F && g_tx.data[2] == 0x78;
+            uds_stats_first_frame(now_ns, rcrrp);
         }
-    } else {
-        printf("[LOG] [ISOTP] 等待FC帧超时\n");
+        isotp_tx_log(&g_tx.frame);
+        return 1;
     }
-    return 0;
+    if ((errno == ENOBUFS || errno == EAGAIN || errno == EINTR) && uds_now_ms() < g_tx.as_deadline) {
+        uds_timer_start(&g_timers, &tx_timer, 1);
+        return 0;
+    }
+    LOG("[ISOTP] 帧发送失败(N_As): %s，终止发送\n", strerror(errno));
+    isotp_tx_abort();
+    return -1;
 }
 
-// ISO-TP多帧发送
-void send_isotp_response(int s, uint8_t sid, uint8_t *did, const char *data, size_t data_len) {
-    struct can_frame txf;
-    txf.can_id = UDS_RESP_ID;
-    uint8_t uds_header[3];
-    uds_header[0] = sid;
-    uds_header[1] = did[0];
-    uds_header[2] = did[1];
-    size_t uds_header_len = 3;
-    size_t total_len = uds_header_len + data_len;
-    if (total_len <= 7) {
-        txf.data[0] = 0x02 + data_len;
-        memcpy(&txf.data[1], uds_header, uds_header_len);
-        memcpy(&txf.data[1 + uds_header_len], data, data_len);
-        txf.can_dlc = 1 + uds_header_len + data_len;
-        printf("[LOG] [ISOTP] 单帧发送: ");
-        for (int i = 0; i < txf.can_dlc; ++i) printf("%02X ", txf.data[i]);
-        printf("\n");
-        write(s, &txf, sizeof(struct can_frame));
+// 尽可能多地发送帧，遇到等待FC、STmin间隔或发送队列满时交给定时器继续
+static void isotp_tx_pump(void) {
+    while (g_tx.active && !g_tx.wait_fc) {
+        if (isotp_tx_write() <= 0) {
+            return;
+        }
+        if (g_tx.sent >= g_tx.len) {
+            uds_stats_last_frame(uds_rt_realtime_ns());
+            g_perf.bytes_tx += g_tx.len;
+            UDS_TRACE2(response_done, g_tx.data[0], g_tx.len);
+            shm_mark_dirty();
+            if (g_tx.len > 7) {
+                g_perf.tx_multi++;
+                LOG("[ISOTP] 多帧发送完成 (%zu字节)\n", g_tx.len);
+            }
+            g_tx.active = 0;
+            return;
+        }
+        // 首帧之后、以及每个块结束后都要等待流控帧
+        if ((g_tx.frame.data[0] >> 4) == 0x1 || (g_tx.bs && --g_tx.block_left == 0)) {
+            g_tx.wait_fc = 1;
+            uds_timer_start(&g_timers, &n_bs_timer, N_BS_MS);
+            return;
+        }
+        isotp_tx_prepare_cf();
+        if (g_tx.stmin_ms) {
+            uds_timer_start(&g_timers, &tx_timer, g_tx.stmin_ms);
+            return;
+        }
+    }
+}
+
+static void tx_timer_expired(uds_timer_t *t, void *arg) {
+    isotp_tx_pump();
+}
+
+static void n_bs_timeout(uds_timer_t *t, void *arg) {
+    LOG("[ISOTP] 等待FC帧超时(N_Bs)，终止多帧发送\n");
+    isotp_tx_abort();
+}
+
+// 处理收到的流控帧
+static void isotp_on_flow_control(const struct can_frame *frame) {
+    if (!g_tx.active || !g_tx.wait_fc) {
+        LOG("收到流控帧，忽略\n");
         return;
     }
-    // 多帧
-    // 1. 发送首帧
-    txf.data[0] = 0x10 | ((total_len >> 8) & 0x0F);
-    txf.data[1] = total_len & 0xFF;
-    size_t first_frame_data = 6;
-    memcpy(&txf.data[2], uds_header, uds_header_len);
-    size_t copy1 = first_frame_data - uds_header_len;
-    memcpy(&txf.data[2 + uds_header_len], data, copy1);
-    txf.can_dlc = 8;
-    printf("[LOG] [ISOTP] 首帧发送: ");
-    for (int i = 0; i < txf.can_dlc; ++i) printf("%02X ", txf.data[i]);
-    printf("\n");
-    write(s, &txf, sizeof(struct can_frame));
-    // 2. 等待FC帧
-    if (!wait_fc_frame(s, 1000)) {
-        printf("[LOG] [ISOTP] 未收到FC帧，终止多帧发送\n");
+    LOG("[ISOTP] 收到流控帧(FC): ");
+    log_hex(frame->data, frame->can_dlc);
+    if (frame->can_dlc < 3) {
+        LOG("[ISOTP] 流控帧长度无效，终止多帧发送\n");
+        isotp_tx_abort();
         return;
     }
-    // 3. 发送连续帧
-    size_t sent = copy1;
-    uint8_t sn = 1;
-    while (sent < data_len) {
-        txf.data[0] = 0x20 | (sn & 0x0F);
-        size_t remain = data_len - sent;
-        size_t chunk = remain > 7 ? 7 : remain;
-        memcpy(&txf.data[1], data + sent, chunk);
-        txf.can_dlc = 1 + chunk;
-        printf("[LOG] [ISOTP] 连续帧SN=%d发送: ", sn);
-        for (int i = 0; i < txf.can_dlc; ++i) printf("%02X ", txf.data[i]);
-        printf("\n");
-        write(s, &txf, sizeof(struct can_frame));
-        sent += chunk;
-        sn = (sn + 1) & 0x0F;
-        usleep(1000 * 10);
+    switch (frame->data[0] & 0x0F) {
+    case 0x0: // ContinueToSend
+        uds_timer_stop(&g_timers, &n_bs_timer);
+        g_tx.bs = frame->data[1];
+        g_tx.block_left = g_tx.bs;
+        g_tx.stmin_ms = isotp_stmin_ms(frame->data[2]);
+        g_tx.wait_fc = 0;
+        isotp_tx_prepare_cf();
+        isotp_tx_pump();
+        break;
+    case 0x1: // Wait
+        LOG("[ISOTP] 流控帧要求等待\n");
+        uds_timer_start(&g_timers, &n_bs_timer, N_BS_MS);
+        break;
+    case 0x2: // Overflow
+        LOG("[ISOTP] 对方缓冲区溢出，终止多帧发送\n");
+        isotp_tx_abort();
+        break;
+    default:
+        LOG("[ISOTP] 无效的流控状态: 0x%X，终止多帧发送\n", frame->data[0] & 0x0F);
+        isotp_tx_abort();
+        break;
+    }
+}
+
+// ISO-TP发送（原始数据，无DID）：单帧立即发出，多帧由FC和定时器驱动
+void send_isotp_response_raw(const uint8_t *data, size_t data_len) {
+    if (data_len > sizeof(g_tx.data)) {
+        LOG("[ISOTP] 响应过长(%zu字节)，丢弃\n", data_len);
+        return;
+    }
+    p2_response_started();
+    isotp_tx_abort();
+
+    struct can_frame *f = &g_tx.frame;
+    memcpy(g_tx.data, data, data_len);
+    g_tx.len = data_len;
+    g_tx.bs = 0;
+    g_tx.stmin_ms = 0;
+    f->can_id = g_resp_id;
+    if (data_len <= 7) {
+        f->data[0] = data_len; // 单帧长度字段
+        memcpy(&f->data[1], data, data_len);
+        f->can_dlc = 1 + data_len;
+        g_tx.sent = data_len;
+    } else if (data_len <= ISOTP_FF_DL_MAX) {
+        f->data[0] = 0x10 | ((data_len >> 8) & 0x0F);
+        f->data[1] = data_len & 0xFF;
+        memcpy(&f->data[2], data, 6);
+        f->can_dlc = 8;
+        g_tx.sent = 6;
+        g_tx.sn = 1;
+    } else {
+        // 超过4095字节：12位长度置0，后跟32位长度（ISO 15765-2:2016）
+        f->data[0] = 0x10;
+        f->data[1] = 0x00;
+        f->data[2] = (data_len >> 24) & 0xFF;
+        f->data[3] = (data_len >> 16) & 0xFF;
+        f->data[4] = (data_len >> 8) & 0xFF;
+        f->data[5] = data_len & 0xFF;
+        memcpy(&f->data[6], data, 2);
+        f->can_dlc = 8;
+        g_tx.sent = 2;
+        g_tx.sn = 1;
+    }
+    g_tx.as_deadline = uds_now_ms() + N_AS_MS;
+    g_tx.active = 1;
+    isotp_tx_pump();
+}
+
+// ISO-TP发送（SID + DID + 数据）
+void send_isotp_response(uint8_t sid, uint8_t *did, const char *data, size_t data_len) {
+    uint8_t *buf = uds_arena_alloc(&g_arena, 3 + data_len);
+    if (!buf) {
+        LOG("[ISOTP] arena空间不足，丢弃响应(%zu字节)\n", 3 + data_len);
+        return;
     }
+    buf[0] = sid;
+    buf[1] = did[0];
+    buf[2] = did[1];
+    memcpy(&buf[3], data, data_len);
+    send_isotp_response_raw(buf, 3 + data_len);
+}
+
+static uint8_t *put_u32(uint8_t *p, uint32_t v) {
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+    return p + 4;
 }
 
+static uint32_t ns_to_us32(uint64_t ns) {
+    uint64_t us = ns / 1000;
+    return us > UINT32_MAX ? UINT32_MAX : (uint32_t)us;
+}
+
+// 0xFDxx自诊断DID：62 FD xx 后跟固定布局，首字节为布局版本，其余字段均为大端uint32
+//   FD00 流量:   ver uptime_ms frames_rx frames_tx frames_dropped rx_multi tx_multi
+//                tx_aborted requests bytes_rx bytes_tx
+//   FD01 速率:   ver interval_ms frames_rx/s frames_tx/s bytes_rx/s bytes_tx/s
+//                （相对上一次读取FD01，首次读取相对启动时刻）
+//   FD02 耗时:   ver p2_overrun p2star_overrun nrc78，然后handler/first/last三个阶段各
+//                count p50 p90 p99 p99.9 max（微秒，自请求最后一帧到达起计时）
+//   FD03 资源:   ver arena_size arena_used arena_high_water rx_pending tx_pending tx_wait_fc
+//                timers_pending，然后时间轮每级已占用槽数（4个uint8）
+// 快照在事件循环内一次构造完成，读取期间计数器不会变化
+#define SELF_DIAG_LAYOUT_VERSION 1
+static int handle_self_diag_did(uint16_t did, uint8_t *resp, int *resp_len) {
+    const uds_stats_entry_t *tot = uds_stats_total();
+    uint64_t now = uds_now_ms();
+    uint8_t *p = resp + 3;
+
+    resp[0] = 0x62;
+    resp[1] = did >> 8;
+    resp[2] = did & 0xFF;
+    *p++ = SELF_DIAG_LAYOUT_VERSION;
+    switch (did) {
+    case 0xFD00:
+        p = put_u32(p, now - g_start_ms);
+        p = put_u32(p, g_perf.frames_rx);
+        p = put_u32(p, g_perf.frames_tx);
+        p = put_u32(p, g_perf.frames_dropped);
+        p = put_u32(p, g_perf.rx_multi);
+        p = put_u32(p, g_perf.tx_multi);
+        p = put_u32(p, tot->tx_aborted);
+        p = put_u32(p, g_perf.requests);
+        p = put_u32(p, g_perf.bytes_rx);
+        p = put_u32(p, g_perf.bytes_tx);
+        break;
+    case 0xFD01: {
+        uint64_t since = g_perf_rate_mark.ms ? g_perf_rate_mark.ms : g_start_ms;
+        uint64_t ms = now > since ? now - since : 1;
+        p = put_u32(p, ms);
+        p = put_u32(p, (uint64_t)(g_perf.frames_rx - g_perf_rate_mark.frames_rx) * 1000 / ms);
+        p = put_u32(p, (uint64_t)(g_perf.frames_tx - g_perf_rate_mark.frames_tx) * 1000 / ms);
+        p = put_u32(p, (uint64_t)(g_perf.bytes_rx - g_perf_rate_mark.bytes_rx) * 1000 / ms);
+        p = put_u32(p, (uint64_t)(g_perf.bytes_tx - g_perf_rate_mark.bytes_tx) * 1000 / ms);
+        g_perf_rate_mark.ms = now;
+        g_perf_rate_mark.frames_rx = g_perf.frames_rx;
+        g_perf_rate_mark.frames_tx = g_perf.frames_tx;
+        g_perf_rate_mark.bytes_rx = g_perf.bytes_rx;
+        g_perf_rate_mark.bytes_tx = g_perf.bytes_tx;
+        break;
+    }
+    case 0xFD02:
+        p = put_u32(p, tot->p2_overrun);
+        p = put_u32(p, tot->p2star_overrun);
+        p = put_u32(p, tot->rcrrp);
+        for (int i = 0; i < UDS_STAGE_COUNT; i++) {
+            const uds_hist_t *h = &tot->stage[i];
+            p = put_u32(p, h->count);
+            p = put_u32(p, ns_to_us32(uds_hist_percentile(h, 0.50)));
+            p = put_u32(p, ns_to_us32(uds_hist_percentile(h, 0.90)));
+            p = put_u32(p, ns_to_us32(uds_hist_percentile(h, 0.99)));
+            p = put_u32(p, ns_to_us32(uds_hist_percentile(h, 0.999)));
+            p = put_u32(p, ns_to_us32(h->max));
+        }
+        break;
+    case 0xFD03:
+        p = put_u32(p, g_arena.size);
+        p = put_u32(p, g_arena.used);
+        p = put_u32(p, g_arena.high_water);
+        p = put_u32(p, g_rx.data ? g_rx.total - g_rx.received : 0);
+        p = put_u32(p, g_tx.active ? g_tx.len - g_tx.sent : 0);
+        p = put_u32(p, g_tx.wait_fc);
+        p = put_u32(p, g_timers.pending);
+        for (int i = 0; i < UDS_TIMER_LEVELS; i++) {
+            *p++ = __builtin_popcountll(g_timers.occupied[i]);
+        }
+        break;
+    default:
+        LOG("未知自诊断DID: 0x%04X\n", did);
+        resp[0] = 0x7F;
+        resp[1] = 0x22;
+        resp[2] = 0x31; // RequestOutOfRange
+        *resp_len = 3;
+        return 0;
+    }
+    *resp_len = p - resp;
+    LOG("返回自诊断DID 0x%04X (%d字节)\n", did, *resp_len);
+    return 0;
+}
+
+// 0x22返回2时待发送的固定DID响应
+static const uds_ecu_did_t *g_static_did;
+
 // 处理0x22服务
 int handle_read_data_by_identifier(uint8_t *req, int req_len, uint8_t *resp, int *resp_len) {
     if (req_len < 3) {
-        printf("[LOG] 0x22请求长度不足: %d\n", req_len);
+        LOG("0x22请求长度不足: %d\n", req_len);
         return -1;
     }
     uint16_t did = (req[1] << 8) | req[2];
-    printf("[LOG] 0x22服务, DID=0x%04X, 安全状态: %s, 安全级别: %d\n", 
+    LOG("0x22服务, DID=0x%04X, 安全状态: %s, 安全级别: %d\n", 
            did, security_unlocked ? "已解锁" : "未解锁", security_level);
     
-    if (did == 0xF190) { // 公开flag - 无需安全访问
-        printf("[LOG] 返回公开flag: %s\n", PUBLIC_FLAG);
-        // 多帧发送
-        return 2; // 特殊返回值，主循环处理
-    } else if (did == 0xC1C2) { // 安全flag - 需要安全访问
-        if (!security_unlocked) {
-            printf("[LOG] 尝试访问安全DID但未解锁安全访问\n");
-            resp[0] = 0x7F;
-            resp[1] = 0x22;
-            resp[2] = 0x33; // SecurityAccessDenied
-            *resp_len = 3;
-            return 0;
-        }
-        printf("[LOG] 返回安全flag: %s\n", SECURE_FLAG);
-        // 多帧发送
-        return 3; // 特殊返回值，主循环处理
-    } else if (did == 0xD1D2) { // 高级flag - 需要级别3安全访问
-        if (security_level < 3) {
-            printf("[LOG] 尝试访问高级DID但安全级别不足 (当前: %d, 需要: 3)\n", security_level);
-            resp[0] = 0x7F;
-            resp[1] = 0x22;
-            resp[2] = 0x33; // SecurityAccessDenied
-            *resp_len = 3;
-            return 0;
-        }
-        printf("[LOG] 返回高级flag: %s\n", ADVANCED_FLAG);
-        // 多帧发送
-        return 4; // 特殊返回值，主循环处理
+    const uds_ecu_did_t *d = uds_ecu_did(did);
+    if (!d) {
+        LOG("未知DID: 0x%04X\n", did);
+        resp[0] = 0x7F;
+        resp[1] = 0x22;
+        resp[2] = 0x31; // RequestOutOfRange
+        *resp_len = 3;
+        return 0;
     }
-    printf("[LOG] 未知DID: 0x%04X\n", did);
-    return -1;
+    int si = uds_ecu_session(current_session);
+    if (si < 0 || !(d->session_mask & (1u << si))) {
+        LOG("DID 0x%04X 在当前会话0x%02X下不可读\n", did, current_session);
+        resp[0] = 0x7F;
+        resp[1] = 0x22;
+        resp[2] = 0x31; // RequestOutOfRange
+        *resp_len = 3;
+        return 0;
+    }
+    if (security_level < d->min_level) {
+        LOG("尝试访问DID 0x%04X但安全级别不足 (当前: %d, 需要: %d)\n",
+            did, security_level, d->min_level);
+        resp[0] = 0x7F;
+        resp[1] = 0x22;
+        resp[2] = 0x33; // SecurityAccessDenied
+        *resp_len = 3;
+        return 0;
+    }
+    if (d->kind == UDS_ECU_DID_SELF_DIAG) {
+        return handle_self_diag_did(did, resp, resp_len);
+    }
+    // 固定内容的响应已由uds_ecugen序列化好，主循环直接多帧发送
+    LOG("返回DID 0x%04X (%d字节)\n", did, d->resp_len);
+    g_static_did = d;
+    return 2; // 特殊返回值，主循环处理
 }
 
 // 处理0x10服务 - DiagnosticSessionControl
 int handle_diagnostic_session_control(uint8_t *req, int req_len, uint8_t *resp, int *resp_len) {
     if (req_len < 2) {
-        printf("[LOG] 0x10请求长度不足: %d\n", req_len);
+        LOG("0x10请求长度不足: %d\n", req_len);
         return -1;
     }
     uint8_t session_type = req[1];
-    printf("[LOG] 0x10服务, 会话类型=0x%02X\n", session_type);
-    
-    if (session_type == 0x01) { // 默认会话
-        current_session = 0x01;
-        // 注意：安全访问状态在会话切换时保持不变
-        // 只有ECU重启才会重置安全状态
-        printf("[LOG] 切换到默认会话，安全状态保持不变\n");
-        last_tester_present_time = 0; // 默认会话不需要维持
-        resp[0] = 0x50; // 肯定响应
-        resp[1] = 0x01; // 会话类型
-        resp[2] = 0x00; // p2_server_max (50ms)
-        resp[3] = 0x32; // p2_server_max (50ms)
-        *resp_len = 4;
-        return 0;
-    } else if (session_type == 0x02) { // 编程会话
-        current_session = 0x02;
-        printf("[LOG] 切换到编程会话\n");
-        last_tester_present_time = time(NULL); // 进入非默认会话，初始化计时
-        resp[0] = 0x50; // 肯定响应
-        resp[1] = 0x02; // 会话类型
-        resp[2] = 0x00; // p2_server_max (50ms)
-        resp[3] = 0x32; // p2_server_max (50ms)
-        *resp_len = 4;
-        return 0;
-    } else {
-        printf("[LOG] 不支持的会话类型: 0x%02X\n", session_type);
+    LOG("0x10服务, 会话类型=0x%02X\n", session_type);
+    
+    int si = uds_ecu_session(session_type);
+    if (si < 0) {
+        LOG("不支持的会话类型: 0x%02X\n", session_type);
         resp[0] = 0x7F;
         resp[1] = 0x10;
         resp[2] = 0x12; // SubFunctionNotSupported
         *resp_len = 3;
         return 0;
     }
+    // 注意：安全访问状态在会话切换时保持不变
+    // 只有ECU重启才会重置安全状态
+    current_session = session_type;
+    LOG("切换到会话0x%02X，安全状态保持不变\n", session_type);
+    memcpy(resp, uds_ecu_sessions[si].resp, sizeof(uds_ecu_sessions[si].resp)); // 50 id P2 P2*
+    *resp_len = sizeof(uds_ecu_sessions[si].resp);
+    return 0;
 }
 
 // 处理0x11服务 - ECUReset
 int handle_ecu_reset(uint8_t *req, int req_len, uint8_t *resp, int *resp_len) {
     if (req_len < 2) {
-        printf("[LOG] 0x11请求长度不足: %d\n", req_len);
+        LOG("0x11请求长度不足: %d\n", req_len);
         return -1;
     }
     uint8_t reset_type = req[1];
-    printf("[LOG] 0x11服务, 复位类型=0x%02X\n", reset_type);
+    LOG("0x11服务, 复位类型=0x%02X\n", reset_type);
     
     if (reset_type == 0x01) { // HardReset
-        printf("[LOG] 收到硬复位请求，准备重启程序...\n");
+        LOG("收到硬复位请求，准备重启程序...\n");
         resp[0] = 0x51; // 肯定响应
         resp[1] = 0x01; // 复位类型
         *resp_len = 2;
         
-        // 发送响应后重启
-        printf("[LOG] 发送复位响应，3秒后重启...\n");
-        sleep(3);
-        printf("[LOG] 正在重启UDS服务器...\n");
-        exit(0); // 退出程序，Docker容器会自动重启
+        // 先发送响应，RESET_DELAY_MS后由定时器重启，期间不再处理新请求
+        LOG("发送复位响应，3秒后重启...\n");
+        g_reset_pending = 1;
+        uds_timer_start(&g_timers, &reset_timer, RESET_DELAY_MS);
+        return 0;
     } else {
-        printf("[LOG] 不支持的复位类型: 0x%02X\n", reset_type);
+        LOG("不支持的复位类型: 0x%02X\n", reset_type);
         resp[0] = 0x7F;
         resp[1] = 0x11;
         resp[2] = 0x12; // SubFunctionNotSupported
@@ -407,19 +703,30 @@ int handle_ecu_reset(uint8_t *req, int req_len, uint8_t *resp, int *resp_len) {
 // 处理0x27服务
 int handle_security_access(uint8_t *req, int req_len, uint8_t *resp, int *resp_len) {
     if (req_len < 2) {
-        printf("[LOG] 0x27请求长度不足: %d\n", req_len);
+        LOG("0x27请求长度不足: %d\n", req_len);
         return -1;
     }
     uint8_t subfunc = req[1];
     uint8_t level = subfunc & 0xFE; // 获取安全级别 (清除奇偶位)
     uint8_t is_request = subfunc & 0x01; // 判断是请求还是响应
     
-    printf("[LOG] 0x27服务, subfunc=0x%02X, 级别=%d, 类型=%s\n", 
+    LOG("0x27服务, subfunc=0x%02X, 级别=%d, 类型=%s\n", 
            subfunc, level, is_request ? "请求seed" : "提交key");
     
+    const uds_ecu_security_t *sec = uds_ecu_security(is_request ? subfunc : subfunc - 1); // 按请求seed的奇数子功能查找
+    if (!sec) {
+        LOG("不支持的安全访问subfunction: 0x%02X\n", subfunc);
+        resp[0] = 0x7F;
+        resp[1] = 0x27;
+        resp[2] = 0x12; // SubFunctionNotSupported
+        *resp_len = 3;
+        return 0;
+    }
+    
     // 检查会话要求
-    if ((subfunc == 0x03 || subfunc == 0x04) && current_session != 0x02) { // 级别3需要编程会话
-        printf("[LOG] 级别3安全访问需要编程会话\n");
+    int si = uds_ecu_session(current_session);
+    if (si < 0 || !(sec->session_mask & (1u << si))) {
+        LOG("级别%d安全访问在当前会话0x%02X下不可用\n", sec->level, current_session);
         resp[0] = 0x7F;
         resp[1] = 0x27;
         resp[2] = 0x7E; // SubFunctionNotSupportedInActiveSession
@@ -428,133 +735,86 @@ int handle_security_access(uint8_t *req, int req_len, uint8_t *resp, int *resp_l
     }
     
     if (is_request) { // 请求seed
-        if (subfunc == 0x01) { // 级别1请求seed
-            g_seed = generate_seed();
-            printf("[LOG] 级别1生成seed: 0x%08X\n", g_seed);
-            resp[0] = 0x67;
-            resp[1] = 0x01;
-            resp[2] = (g_seed >> 24) & 0xFF;
-            resp[3] = (g_seed >> 16) & 0xFF;
-            resp[4] = (g_seed >> 8) & 0xFF;
-            resp[5] = g_seed & 0xFF;
-            *resp_len = 6;
-            return 0;
-        } else if (subfunc == 0x03) { // 级别3请求seed
-            g_seed = generate_seed();
-            printf("[LOG] 级别3生成seed: 0x%08X\n", g_seed);
-            resp[0] = 0x67;
-            resp[1] = 0x03; // 级别3请求seed
-            resp[2] = (g_seed >> 24) & 0xFF;
-            resp[3] = (g_seed >> 16) & 0xFF;
-            resp[4] = (g_seed >> 8) & 0xFF;
-            resp[5] = g_seed & 0xFF;
-            *resp_len = 6;
-            return 0;
-        } else if (subfunc == 0x05) { // 级别5请求seed
-            g_seed = generate_seed();
-            printf("[LOG] 级别5生成seed: 0x%08X\n", g_seed);
-            resp[0] = 0x67;
-            resp[1] = 0x05; // 级别5请求seed
-            resp[2] = (g_seed >> 24) & 0xFF;
-            resp[3] = (g_seed >> 16) & 0xFF;
-            resp[4] = (g_seed >> 8) & 0xFF;
-            resp[5] = g_seed & 0xFF;
-            *resp_len = 6;
-            return 0;
-        } else {
-            printf("[LOG] 不支持的安全访问subfunction: 0x%02X\n", subfunc);
-            resp[0] = 0x7F;
-            resp[1] = 0x27;
-            resp[2] = 0x12; // SubFunctionNotSupported
-            *resp_len = 3;
-            return 0;
+        g_seed = generate_seed();
+        LOG("级别%d生成seed: 0x%08X\n", sec->level, g_seed);
+        resp[0] = 0x67;
+        resp[1] = subfunc;
+        resp[2] = (g_seed >> 24) & 0xFF;
+        resp[3] = (g_seed >> 16) & 0xFF;
+        resp[4] = (g_seed >> 8) & 0xFF;
+        resp[5] = g_seed & 0xFF;
+        *resp_len = 6;
+        return 0;
+    }
+    
+    // 提交key
+    if (req_len < 6) {
+        LOG("key长度不足\n");
+        return -1;
+    }
+    
+    uint32_t key = (req[2] << 24) | (req[3] << 16) | (req[4] << 8) | req[5];
+    uint32_t expected_key = sec->key(g_seed);
+    LOG("级别%d收到key: 0x%08X, 当前seed: 0x%08X, 正确key: 0x%08X\n", 
+           sec->level, key, g_seed, expected_key);
+    if (key != expected_key) {
+        LOG("级别%d安全访问key错误\n", sec->level);
+        resp[0] = 0x7F;
+        resp[1] = 0x27;
+        resp[2] = 0x35; // invalid key
+        *resp_len = 3;
+        return 0;
+    }
+    security_level = sec->level;
+    security_unlocked = 1;
+    LOG("级别%d安全访问解锁成功\n", sec->level);
+    resp[0] = 0x67;
+    resp[1] = subfunc;
+    *resp_len = 2;
+    return 0;
+}
+
+// 从当前进程映射的程序映像读取，只复制落在可读PT_LOAD段内的字节，其余补零，
+// 避免远程请求访问段之间或映像之外的未映射地址。返回实际复制的字节数
+static uint32_t read_live_image(uint32_t address, uint8_t *dst, uint32_t size) {
+    const ElfW(Phdr) *phdr = (const ElfW(Phdr) *)getauxval(AT_PHDR);
+    size_t phnum = getauxval(AT_PHNUM);
+    uintptr_t bias = 0;
+    uint64_t lo = address, hi = (uint64_t)address + size;
+    uint32_t copied = 0;
+
+    memset(dst, 0, size);
+    if (phdr == NULL) {
+        return 0;
+    }
+    for (size_t i = 0; i < phnum; i++) {
+        if (phdr[i].p_type == PT_PHDR) {
+            bias = (uintptr_t)phdr - phdr[i].p_vaddr;
         }
-    } else { // 提交key
-        if (req_len < 6) {
-            printf("[LOG] key长度不足\n");
-            return -1;
+    }
+    for (size_t i = 0; i < phnum; i++) {
+        if (phdr[i].p_type != PT_LOAD || !(phdr[i].p_flags & PF_R)) {
+            continue;
         }
-        
-        uint32_t key = (req[2] << 24) | (req[3] << 16) | (req[4] << 8) | req[5];
-        
-        if (subfunc == 0x02) { // 级别1发送key
-            uint32_t expected_key = calc_key(g_seed);
-            printf("[LOG] 级别1收到key: 0x%08X, 当前seed: 0x%08X, 正确key: 0x%08X\n", 
-                   key, g_seed, expected_key);
-            if (key == expected_key) {
-                security_level = 1;
-                security_unlocked = 1;
-                printf("[LOG] 级别1安全访问解锁成功\n");
-                resp[0] = 0x67;
-                resp[1] = 0x02;
-                *resp_len = 2;
-                return 0;
-            } else {
-                printf("[LOG] 级别1安全访问key错误\n");
-                resp[0] = 0x7F;
-                resp[1] = 0x27;
-                resp[2] = 0x35; // invalid key
-                *resp_len = 3;
-                return 0;
-            }
-        } else if (subfunc == 0x04) { // 级别3发送key
-            uint32_t expected_key = calc_key_level3(g_seed);
-            printf("[LOG] 级别3收到key: 0x%08X, 当前seed: 0x%08X, 正确key: 0x%08X\n", 
-                   key, g_seed, expected_key);
-            if (key == expected_key) {
-                security_level = 3;
-                security_unlocked = 1;
-                printf("[LOG] 级别3安全访问解锁成功\n");
-                resp[0] = 0x67;
-                resp[1] = 0x04;
-                *resp_len = 2;
-                return 0;
-            } else {
-                printf("[LOG] 级别3安全访问key错误\n");
-                resp[0] = 0x7F;
-                resp[1] = 0x27;
-                resp[2] = 0x35; // invalid key
-                *resp_len = 3;
-                return 0;
-            }
-        } else if (subfunc == 0x06) { // 级别5发送key
-            uint32_t expected_key = calc_key_level5(g_seed);
-            printf("[LOG] 级别5收到key: 0x%08X, 当前seed: 0x%08X, 正确key: 0x%08X\n", 
-                   key, g_seed, expected_key);
-            if (key == expected_key) {
-                security_level = 5;
-                security_unlocked = 1;
-                printf("[LOG] 级别5安全访问解锁成功\n");
-                resp[0] = 0x67;
-                resp[1] = 0x06;
-                *resp_len = 2;
-                return 0;
-            } else {
-                printf("[LOG] 级别5安全访问key错误\n");
-                resp[0] = 0x7F;
-                resp[1] = 0x27;
-                resp[2] = 0x35; // invalid key
-                *resp_len = 3;
-                return 0;
-            }
-        } else {
-            printf("[LOG] 不支持的安全访问subfunction: 0x%02X\n", subfunc);
-            resp[0] = 0x7F;
-            resp[1] = 0x27;
-            resp[2] = 0x12; // SubFunctionNotSupported
-            *resp_len = 3;
-            return 0;
+        uint64_t seg_lo = bias + phdr[i].p_vaddr;
+        uint64_t seg_hi = seg_lo + phdr[i].p_memsz;
+        uint64_t from = lo > seg_lo ? lo : seg_lo;
+        uint64_t to = hi < seg_hi ? hi : seg_hi;
+        if (from < to) {
+            memcpy(dst + (from - lo), (const uint8_t *)(uintptr_t)from, to - from);
+            copied += (uint32_t)(to - from);
         }
     }
+    return copied;
 }
 
 // 处理0x23服务 - ReadMemoryByAddress
 int handle_read_memory_by_address(uint8_t *req, int req_len, uint8_t *resp, int *resp_len) {
-    printf("[LOG] ===== 0x23 ReadMemoryByAddress 服务开始 =====\n");
+    LOG("===== 0x23 ReadMemoryByAddress 服务开始 =====\n");
     
     // 1. 基本参数验证
     if (req_len < 5) {
-        printf("[LOG] 错误: 请求长度不足 (%d < 5)\n", req_len);
+        LOG("错误: 请求长度不足 (%d < 5)\n", req_len);
         resp[0] = 0x7F;
         resp[1] = 0x23;
         resp[2] = 0x13; // IncorrectMessageLengthOrInvalidFormat
@@ -562,9 +822,9 @@ int handle_read_memory_by_address(uint8_t *req, int req_len, uint8_t *resp, int
         return 0;
     }
     
-    // 2. 安全访问检查
-    if (security_level < 5) {
-        printf("[LOG] 错误: 安全级别不足 (当前: %d, 需要: 5)\n", security_level);
+    // 2. 安全访问检查：先按所有区域中最低的级别拦截，区域自身的级别在解析地址后检查
+    if (security_level < uds_ecu_mem_min_level) {
+        LOG("错误: 安全级别不足 (当前: %d, 需要: %d)\n", security_level, uds_ecu_mem_min_level);
         resp[0] = 0x7F;
         resp[1] = 0x23;
         resp[2] = 0x33; // SecurityAccessDenied
@@ -572,23 +832,23 @@ int handle_read_memory_by_address(uint8_t *req, int req_len, uint8_t *resp, int
         return 0;
     }
     
-    printf("[LOG] 安全访问检查通过 (级别: %d)\n", security_level);
+    LOG("安全访问检查通过 (级别: %d)\n", security_level);
     
     // 3. 解析格式标识符
     uint8_t format_identifier = req[1];  // 格式标识符
     
-    printf("[LOG] 格式标识符: 0x%02X\n", format_identifier);
+    LOG("格式标识符: 0x%02X\n", format_identifier);
     
     // 4. 解析地址和大小字段长度
     uint8_t size_len = (format_identifier >> 4) & 0x0F;  // 大小字段长度（高4位）
     uint8_t addr_len = format_identifier & 0x0F;         // 地址字段长度（低4位）
     
-    printf("[LOG] 字段长度: 地址=%d字节, 大小=%d字节\n", addr_len, size_len);
+    LOG("字段长度: 地址=%d字节, 大小=%d字节\n", addr_len, size_len);
     
     // 5. 验证请求长度
     int expected_len = 2 + addr_len + size_len;  // 2字节头部 + 地址 + 大小
     if (req_len < expected_len) {
-        printf("[LOG] 错误: 请求长度不匹配 (实际: %d, 期望: %d)\n", req_len, expected_len);
+        LOG("错误: 请求长度不匹配 (实际: %d, 期望: %d)\n", req_len, expected_len);
         resp[0] = 0x7F;
         resp[1] = 0x23;
         resp[2] = 0x13; // IncorrectMessageLengthOrInvalidFormat
@@ -602,7 +862,7 @@ int handle_read_memory_by_address(uint8_t *req, int req_len, uint8_t *resp, int
         address = (address << 8) | req[2 + i];
     }
     
-    printf("[LOG] 解析地址: 0x%08X\n", address);
+    LOG("解析地址: 0x%08X\n", address);
     
     // 7. 解析读取大小
     uint32_t size = 0;
@@ -610,155 +870,638 @@ int handle_read_memory_by_address(uint8_t *req, int req_len, uint8_t *resp, int
         size = (size << 8) | req[2 + addr_len + i];
     }
     
-    printf("[LOG] 读取参数: 地址=0x%08X, 大小=%d字节\n", address, size);
+    LOG("读取参数: 地址=0x%08X, 大小=%d字节\n", address, size);
     
     // 8. 地址范围检查
-    if (address < 0x40000000 || address > 0x4FFFFFFF) {
-        printf("[LOG] 错误: 地址超出安全范围 (0x40000000-0x4FFFFFFF)\n");
+    const uds_ecu_region_t *region = uds_ecu_region(address);
+    if (!region) {
+        LOG("错误: 地址0x%08X不在任何内存区域内\n", address);
         resp[0] = 0x7F;
         resp[1] = 0x23;
         resp[2] = 0x22; // ConditionsNotCorrect
         *resp_len = 3;
         return 0;
     }
+    if (security_level < region->min_level) {
+        LOG("错误: 安全级别不足 (当前: %d, 需要: %d)\n", security_level, region->min_level);
+        resp[0] = 0x7F;
+        resp[1] = 0x23;
+        resp[2] = 0x33; // SecurityAccessDenied
+        *resp_len = 3;
+        return 0;
+    }
     
     // 9. 大小限制检查
-    if (size > 0x1000) { // 最大4KB
-        printf("[LOG] 错误: 读取大小超出限制 (%d > 4096)\n", size);
+    if (size > region->max_read) {
+        LOG("错误: 读取大小超出限制 (%d > %d)\n", size, region->max_read);
         resp[0] = 0x7F;
         resp[1] = 0x23;
         resp[2] = 0x22; // ConditionsNotCorrect
         *resp_len = 3;
         return 0;
     }
-    
-    // 10. 程序内存范围检查
-    if (address < 0x40000000 || address > 0x7FFFFFFF) {
-        printf("[LOG] 错误: 地址超出程序内存范围\n");
+    if (size > 0 && (uint64_t)address + size - 1 > region->end) {
+        LOG("错误: 读取范围0x%08X+%d超出区域末尾0x%08X\n", address, size, region->end);
         resp[0] = 0x7F;
         resp[1] = 0x23;
-        resp[2] = 0x22; // ConditionsNotCorrect
+        resp[2] = 0x31; // RequestOutOfRange
         *resp_len = 3;
         return 0;
     }
     
-    printf("[LOG] 所有检查通过，开始读取内存...\n");
+    LOG("所有检查通过 (区域 0x%08X-0x%08X)，开始读取内存...\n", region->start, region->end);
     
-    // 11. 执行内存读取
-    uint8_t *memory_ptr = (uint8_t *)address;
-    
-    // 12. 构造响应头
+    // 10. 构造响应头
     resp[0] = 0x63; // ReadMemoryByAddress响应
     resp[1] = format_identifier; // 返回相同的格式标识符
     
-    // 13. 复制内存数据
+    // 11. 复制内存数据，严格按照size返回
     uint8_t *data_ptr = &resp[2];
-    // 修改：严格按照size返回数据，最大不超过4KB（0x1000）
-    uint32_t copy_size = size; // 按请求的size返回
-    if (copy_size > 0x1000) copy_size = 0x1000; // 冗余保护，实际前面已检查
-
-    // 安全地复制内存数据 - 添加更严格的检查
+    uint32_t copy_size = size;
     if (copy_size > 0) {
-        // 检查地址是否在有效的程序内存范围内
-        if (address < 0x40000000 || address > 0x7FFFFFFF) {
-            printf("[LOG] 错误: 地址超出有效范围，拒绝访问\n");
-            resp[0] = 0x7F;
-            resp[1] = 0x23;
-            resp[2] = 0x22; // ConditionsNotCorrect
-            *resp_len = 3;
-            return 0;
-        }
-        
         // 检查地址是否对齐（可选，但有助于避免某些问题）
         if (address % 4 != 0) {
-            printf("[LOG] 警告: 地址未对齐 (0x%08X %% 4 = %d)\n", address, address % 4);
+            LOG("警告: 地址未对齐 (0x%08X %% 4 = %d)\n", address, address % 4);
         }
         
-        // 尝试安全地读取内存
-        printf("[LOG] 尝试读取内存地址: 0x%08X\n", address);
-        
-        // 特殊处理：当访问0x40000000时，返回ELF文件数据而不是真正读取内存
-        if (address >= 0x40000000 && g_elf_data != NULL) {
-            uint32_t elf_offset = address - 0x40000000;
-            if (elf_offset < g_elf_size) {
-                // 从ELF数据中复制
-                uint32_t available_size = g_elf_size - elf_offset;
-                uint32_t actual_copy_size = (copy_size < available_size) ? copy_size : available_size;
-                
-                printf("[LOG] 从ELF文件数据返回: 偏移=0x%08X, 大小=%d字节\n", elf_offset, actual_copy_size);
+        if (region->source == UDS_ECU_REGION_ELF && g_elf_data != NULL) {
+            // 返回ELF文件数据而不是真正读取内存，超出文件部分补零
+            uint32_t elf_offset = address - region->base;
+            uint32_t available_size = elf_offset < g_elf_size ? g_elf_size - elf_offset : 0;
+            uint32_t actual_copy_size = (copy_size < available_size) ? copy_size : available_size;
+            
+            LOG("从ELF文件数据返回: 偏移=0x%08X, 大小=%d字节\n", elf_offset, actual_copy_size);
+            if (actual_copy_size > 0) {
                 memcpy(data_ptr, g_elf_data + elf_offset, actual_copy_size);
-                
-                // 如果请求的大小超过了ELF文件大小，用零填充剩余部分
-                if (copy_size > actual_copy_size) {
-                    printf("[LOG] 用零填充剩余 %d 字节\n", copy_size - actual_copy_size);
-                    memset(data_ptr + actual_copy_size, 0, copy_size - actual_copy_size);
-                }
-            } else {
-                // 超出ELF文件范围，返回零数据
-                printf("[LOG] 地址超出ELF文件范围，返回零数据\n");
-                memset(data_ptr, 0, copy_size);
+            }
+            if (copy_size > actual_copy_size) {
+                LOG("用零填充剩余 %d 字节\n", copy_size - actual_copy_size);
+                memset(data_ptr + actual_copy_size, 0, copy_size - actual_copy_size);
             }
         } else {
-            // 对于其他地址，尝试读取内存，如果失败则返回零数据
-            uint8_t *memory_ptr = (uint8_t *)address;
-            if (address < 0x40000000 || address > 0x7FFFFFFF) {
-                printf("[LOG] 地址无效，返回零数据\n");
-                memset(data_ptr, 0, copy_size);
-            } else {
-                memcpy(data_ptr, memory_ptr, copy_size);
+            // UDS_ECU_REGION_MEMORY，或ELF文件没有加载（不在自身目录启动）时退回读取映射的程序映像
+            LOG("尝试读取内存地址: 0x%08X\n", address);
+            uint32_t live_size = read_live_image(address, data_ptr, copy_size);
+            if (copy_size > live_size) {
+                LOG("映像之外的 %d 字节用零填充\n", copy_size - live_size);
             }
         }
     }
     
-    // 14. 输出调试信息
-    printf("[LOG] 内存读取成功: 复制了%d字节\n", copy_size);
-    printf("[LOG] 内存数据 (前16字节): ");
-    for (int i = 0; i < 16 && i < copy_size; i++) {
-        printf("%02X ", data_ptr[i]);
-    }
-    printf("\n");
+    // 12. 输出调试信息
+    LOG("内存读取成功: 复制了%d字节\n", copy_size);
+    LOG("内存数据 (前16字节): ");
+    log_hex(data_ptr, copy_size < 16 ? copy_size : 16);
     
-    // 15. 检查是否包含flag
+    // 13. 检查是否包含flag
     char *data_str = (char *)data_ptr;
     if (strstr(data_str, "UDSCTF{") != NULL) {
-        printf("[LOG] *** 发现flag字符串! ***\n");
+        LOG("*** 发现flag字符串! ***\n");
     }
     
-    // 16. 设置响应长度
+    // 14. 设置响应长度
     *resp_len = 2 + copy_size;
     
-    printf("[LOG] ===== 0x23 ReadMemoryByAddress 服务完成 =====\n");
+    LOG("===== 0x23 ReadMemoryByAddress 服务完成 =====\n");
     return 0;
 }
 
 int handle_tester_present(uint8_t *req, int req_len, uint8_t *resp, int *resp_len) {
-    last_tester_present_time = time(NULL);
-    printf("[LOG] 收到TesterPresent，更新时间戳\n");
+    if (req_len < 2) {
+        LOG("0x3E请求长度不足: %d\n", req_len);
+        return -1;
+    }
+    if (req[1] != 0x00) { // 仅支持zeroSubFunction
+        LOG("不支持的TesterPresent subfunction: 0x%02X\n", req[1]);
+        resp[0] = 0x7F;
+        resp[1] = 0x3E;
+        resp[2] = 0x12; // SubFunctionNotSupported
+        *resp_len = 3;
+        return 0;
+    }
+    LOG("收到TesterPresent，保持当前会话\n");
     resp[0] = 0x7E;
     resp[1] = 0x00;
     *resp_len = 2;
     return 0;
 }
 
-int main() {
+// 带子功能的服务，子功能字节bit7为suppressPosRspMsgIndicationBit
+int service_has_subfunction(uint8_t sid) {
+    switch (sid) {
+    case 0x10: case 0x11: case 0x27: case 0x28: case 0x31: case 0x3E: case 0x85:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+// 按ISO 14229-1 7.5.5判断是否抑制响应（与iso14229.c中evaluateServiceResponse()规则一致）
+int should_suppress_response(int functional, int suppress_pos_rsp, const uint8_t *resp, int resp_len) {
+    if (resp_len >= 3 && resp[0] == 0x7F) {
+        if (!functional) {
+            return 0; // 物理寻址的否定响应总是发送
+        }
+        switch (resp[2]) {
+        case 0x11: // ServiceNotSupported
+        case 0x12: // SubFunctionNotSupported
+        case 0x31: // RequestOutOfRange
+        case 0x7E: // SubFunctionNotSupportedInActiveSession
+        case 0x7F: // ServiceNotSupportedInActiveSession
+            return 1;
+        default:
+            return 0;
+        }
+    }
+    return suppress_pos_rsp; // 肯定响应由抑制位决定
+}
+
+// process_request中有处理函数的服务，其余SID以NRC 0x11拒绝
+static int service_supported(uint8_t sid) {
+    switch (sid) {
+    case 0x10: case 0x11: case 0x22: case 0x23: case 0x27: case 0x3E:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+// 统计用的DID：0x22取第一个DID，未知DID计入同一SID的other条目，其余服务不区分
+static uint32_t request_did(const uint8_t *req, int len) {
+    if (req[0] == 0x22 && len >= 3) {
+        uint16_t did = (req[1] << 8) | req[2];
+        // 只给ECU模型中存在的DID单独建条目，扫描到的未知DID合并统计
+        return uds_ecu_did(did) ? did : UDS_STATS_OTHER_DID;
+    }
+    return UDS_STATS_NO_DID;
+}
+
+// 处理一个完整的UDS请求
+void process_request(uint8_t *uds_data, int uds_data_len, int functional) {
+    uint8_t *resp = uds_arena_alloc(&g_arena, UDS_MAX_RESP_LEN);
+    int resp_len = 0;
+    int handled = 0;
+    uint8_t sid = uds_data[0];
+    
+    if (!resp) {
+        LOG("arena空间不足，丢弃请求\n");
+        return;
+    }
+    
+    g_request_time = uds_now_ms();
+    g_perf.requests++;
+    g_perf.bytes_rx += uds_data_len;
+    g_request_rx_ns = g_frame_rx_ns;
+    g_latency_pending = 1;
+    uds_timer_start(&g_timers, &p2_timer, P2_SERVER_MS);
+    uds_stats_begin(service_supported(sid) ? sid : UDS_STATS_UNSUPPORTED_SID,
+                    request_did(uds_data, uds_data_len), g_request_rx_ns);
+    
+    // 取出suppressPosRspMsgIndicationBit，处理函数只看子功能值
+    int suppress_pos_rsp = 0;
+    if (service_has_subfunction(sid) && uds_data_len >= 2) {
+        suppress_pos_rsp = (uds_data[1] & 0x80) != 0;
+        uds_data[1] &= 0x7F;
+    }
+    
+    // handle_*的入口/出口探针：bpftrace可按sid过滤出单个服务
+    UDS_TRACE2(handler_entry, sid, uds_data_len);
+    if (uds_data[0] == 0x10) {
+        handled = handle_diagnostic_session_control(uds_data, uds_data_len, resp, &resp_len);
+    } else if (uds_data[0] == 0x11) {
+        handled = handle_ecu_reset(uds_data, uds_data_len, resp, &resp_len);
+    } else if (uds_data[0] == 0x22) {
+        handled = handle_read_data_by_identifier(uds_data, uds_data_len, resp, &resp_len);
+        uds_stats_handler_done(uds_rt_realtime_ns());
+        if (handled == 2) {
+            send_isotp_response_raw(g_static_did->resp, g_static_did->resp_len);
+        }
+    } else if (uds_data[0] == 0x23) {
+        handled = handle_read_memory_by_address(uds_data, uds_data_len, resp, &resp_len);
+    } else if (uds_data[0] == 0x27) {
+        handled = handle_security_access(uds_data, uds_data_len, resp, &resp_len);
+    } else if (uds_data[0] == 0x3E) {
+        handled = handle_tester_present(uds_data, uds_data_len, resp, &resp_len);
+    } else {
+        LOG("未实现的服务号: 0x%02X\n", uds_data[0]);
+        resp[0] = 0x7F;
+        resp[1] = sid;
+        resp[2] = 0x11; // ServiceNotSupported
+        resp_len = 3;
+    }
+    
+    uds_stats_handler_done(uds_rt_realtime_ns());
+    UDS_TRACE3(handler_exit, sid, handled, resp_len);
+    
+    if (handled < 0) {
+        resp[0] = 0x7F;
+        resp[1] = sid;
+        resp[2] = 0x13; // IncorrectMessageLengthOrInvalidFormat
+        resp_len = 3;
+        handled = 0;
+    }
+    
+    if (handled == 0 && resp_len > 0) {
+        if (should_suppress_response(functional, suppress_pos_rsp, resp, resp_len)) {
+            LOG("抑制响应 (SID=0x%02X, %s寻址)\n", sid, functional ? "功能" : "物理");
+            uds_timer_stop(&g_timers, &p2_timer);
+            g_latency_pending = 0;
+            uds_stats_end();
+        } else {
+            if (resp_len > 7) {
+                LOG("响应长度超过单帧限制(%d字节)，使用多帧发送\n", resp_len);
+            }
+            send_isotp_response_raw(resp, resp_len);
+        }
+    } else if (handled == 0) {
+        LOG("未处理/错误的请求\n");
+        uds_timer_stop(&g_timers, &p2_timer);
+        g_latency_pending = 0;
+        uds_stats_end();
+    }
+    
+    shm_mark_dirty();
+    
+    s3_restart();
+}
+
+static void isotp_rx_abort(void) {
+    g_rx.data = NULL;
+    uds_arena_reset(&g_arena);
+    uds_timer_stop(&g_timers, &n_cr_timer);
+}
+
+static void n_cr_timeout(uds_timer_t *t, void *arg) {
+    LOG("等待连续帧超时(N_Cr)，多帧接收失败 (已接收%d/%d字节)\n",
+           g_rx.received, g_rx.total);
+    isotp_rx_abort();
+}
+
+// 处理收到的一帧CAN数据
+void handle_can_frame(struct can_frame *frame) {
+    LOG("收到CAN帧: can_id=0x%03X, dlc=%d, data=", frame->can_id, frame->can_dlc);
+    log_hex(frame->data, frame->can_dlc);
+    g_perf.frames_rx++;
+    UDS_TRACE2(frame_rx, frame->can_id, frame->data[0] >> 4);
+    int functional = 0;
+    if (frame->can_id == UDS_FUNC_ID) {
+        functional = 1;
+    } else if (frame->can_id != g_phys_id) {
+        LOG("非UDS诊断请求帧，忽略\n");
+        return;
+    }
+    
+    // 解析ISO-TP长度字段
+    uint8_t frame_type = (frame->data[0] >> 4) & 0x0F;
+    uint8_t data_length = frame->data[0] & 0x0F;
+    
+    LOG("ISO-TP帧类型: 0x%X, 数据长度: %d, 寻址方式: %s\n", frame_type, data_length,
+           functional ? "功能" : "物理");
+    
+    // 功能寻址只允许单帧请求
+    if (functional && frame_type != 0x0) {
+        LOG("功能寻址仅支持单帧，忽略\n");
+        g_perf.frames_dropped++;
+        return;
+    }
+    
+    if (frame_type == 0x3) { // 流控帧
+        isotp_on_flow_control(frame);
+        return;
+    }
+    
+    if (g_reset_pending) {
+        LOG("正在等待复位，忽略请求\n");
+        g_perf.frames_dropped++;
+        return;
+    }
+    if (g_tx.active && frame_type != 0x2) {
+        // 抑制响应的TesterPresent不需要发送，只刷新S3，不经过process_request以免打断正在进行的发送和统计
+        if (frame_type == 0x0 && data_length == 2 && frame->can_dlc >= 3 &&
+            frame->data[1] == 0x3E && frame->data[2] == 0x80) {
+            LOG("响应发送中收到TesterPresent(3E 80)，刷新S3\n");
+            s3_restart();
+            return;
+        }
+        LOG("上一个响应尚未发送完成，忽略请求\n");
+        g_perf.frames_dropped++;
+        return;
+    }
+    
+    if (frame_type == 0x0) { // 单帧
+        if (data_length > 0 && data_length <= 7 && data_length < frame->can_dlc) {
+            if (g_rx.data) {
+                LOG("单帧打断未完成的多帧接收\n");
+                isotp_rx_abort();
+            }
+            LOG("单帧UDS数据: ");
+            log_hex(&frame->data[1], data_length);
+            process_request(&frame->data[1], data_length, functional);
+            uds_arena_reset(&g_arena);
+        } else {
+            LOG("单帧数据长度无效: %d\n", data_length);
+            g_perf.frames_dropped++;
+        }
+    } else if (frame_type == 0x1) { // 首帧
+        LOG("收到首帧，开始多帧处理\n");
+        
+        // 解析首帧长度
+        uint16_t total_length = ((frame->data[0] & 0x0F) << 8) | frame->data[1];
+        LOG("多帧总长度: %d字节\n", total_length);
+        if (total_length <= 7 || frame->can_dlc < 8) {
+            LOG("首帧长度无效，忽略\n");
+            g_perf.frames_dropped++;
+            return;
+        }
+        if (g_rx.data) {
+            LOG("新首帧打断未完成的多帧接收\n");
+            isotp_rx_abort();
+        }
+        
+        // 从arena分配重组缓冲区
+        g_rx.data = uds_arena_alloc(&g_arena, total_length);
+        if (!g_rx.data) {
+            LOG("arena空间不足，无法接收%d字节\n", total_length);
+            g_perf.frames_dropped++;
+            return;
+        }
+        
+        // 复制首帧数据
+        int first_frame_data_len = 6; // 首帧数据长度
+        memcpy(g_rx.data, &frame->data[2], first_frame_data_len);
+        g_rx.total = total_length;
+        g_rx.received = first_frame_data_len;
+        g_rx.sn = 1;
+        
+        // 发送流控帧
+        struct can_frame fc_frame;
+        fc_frame.can_id = g_resp_id;
+        fc_frame.data[0] = 0x30; // 流控帧
+        fc_frame.data[1] = 0x00; // 块大小
+        fc_frame.data[2] = 0x00; // STmin
+        fc_frame.can_dlc = 3;
+        if (write(g_sock, &fc_frame, sizeof(struct can_frame)) == sizeof(struct can_frame)) {
+            g_perf.frames_tx++;
+        }
+        LOG("发送流控帧\n");
+        uds_timer_start(&g_timers, &n_cr_timer, N_CR_MS);
+    } else if (frame_type == 0x2) { // 连续帧
+        if (!g_rx.data) {
+            LOG("收到连续帧，但未在首帧处理中\n");
+            g_perf.frames_dropped++;
+            return;
+        }
+        uint8_t received_sn = frame->data[0] & 0x0F;
+        if (received_sn != g_rx.sn) {
+            LOG("连续帧序号错误 (收到%d, 期望%d)，多帧接收失败\n", received_sn, g_rx.sn);
+            g_perf.frames_dropped++;
+            isotp_rx_abort();
+            return;
+        }
+        int cf_data_len = frame->can_dlc - 1;
+        int copy_len = (g_rx.total - g_rx.received < cf_data_len) ?
+                      (g_rx.total - g_rx.received) : cf_data_len;
+        memcpy(g_rx.data + g_rx.received, &frame->data[1], copy_len);
+        g_rx.received += copy_len;
+        g_rx.sn = (g_rx.sn + 1) & 0x0F;
+        LOG("收到连续帧SN=%d, 已接收%d/%d字节\n", received_sn, g_rx.received, g_rx.total);
+        
+        if (g_rx.received < g_rx.total) {
+            uds_timer_start(&g_timers, &n_cr_timer, N_CR_MS);
+            return;
+        }
+        uds_timer_stop(&g_timers, &n_cr_timer);
+        uint8_t *uds_data = g_rx.data;
+        int uds_data_len = g_rx.total;
+        g_rx.data = NULL;
+        g_perf.rx_multi++;
+        LOG("多帧接收完成，UDS数据: ");
+        log_hex(uds_data, uds_data_len);
+        process_request(uds_data, uds_data_len, 0);
+        uds_arena_reset(&g_arena);
+    } else {
+        LOG("未知帧类型: 0x%X\n", frame_type);
+    }
+}
+
+// 读取一帧并取内核接收时间戳；内核未提供时间戳时取当前时间
+static int can_recv(int s, struct can_frame *frame, uint64_t *rx_ns) {
+    char ctrl[CMSG_SPACE(sizeof(struct timespec))];
+    struct iovec iov = { .iov_base = frame, .iov_len = sizeof(*frame) };
+    struct msghdr msg = {
+        .msg_iov = &iov,
+        .msg_iovlen = 1,
+        .msg_control = ctrl,
+        .msg_controllen = sizeof(ctrl),
+    };
+    if (recvmsg(s, &msg, 0) != sizeof(*frame)) {
+        return 0;
+    }
+    *rx_ns = 0;
+    for (struct cmsghdr *c = CMSG_FIRSTHDR(&msg); c; c = CMSG_NXTHDR(&msg, c)) {
+        if (c->cmsg_level == SOL_SOCKET && c->cmsg_type == SCM_TIMESTAMPNS) {
+            struct timespec ts;
+            memcpy(&ts, CMSG_DATA(c), sizeof(ts));
+            *rx_ns = (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+        }
+    }
+    if (!*rx_ns) {
+        *rx_ns = uds_rt_realtime_ns();
+    }
+    return 1;
+}
+
+static void stats_socket_serve(int lfd) {
+    int fd;
+    while ((fd = accept(lfd, NULL, NULL)) >= 0) {
+        size_t n = uds_stats_format(g_stats_buf, sizeof(g_stats_buf));
+        size_t off = 0;
+        while (off < n) {
+            ssize_t w = send(fd, g_stats_buf + off, n - off, MSG_NOSIGNAL);
+            if (w <= 0) {
+                break;
+            }
+            off += w;
+        }
+        close(fd);
+    }
+}
+
+int uds_server_init(int sock) {
+    if (uds_arena_init(&g_arena, UDS_ARENA_SIZE) < 0) {
+        return -1;
+    }
+    LOG("请求处理arena: %d bytes\n", UDS_ARENA_SIZE);
+
+    g_sock = sock;
+    current_session = uds_ecu_sessions[0].id;
+    fcntl(sock, F_SETFL, fcntl(sock, F_GETFL) | O_NONBLOCK);
+    int on = 1;
+    setsockopt(sock, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on)); // 用内核接收时间计算响应延迟
+    uds_stats_init(P2_SERVER_MS, P2_STAR_SERVER_MS);
+    g_start_ms = uds_now_ms();
+    uds_timer_wheel_init(&g_timers, uds_now_ms());
+    uds_timer_init(&s3_timer, s3_timeout, NULL);
+    uds_timer_init(&p2_timer, p2_timeout, NULL);
+    uds_timer_init(&reset_timer, reset_timeout, NULL);
+    uds_timer_init(&n_cr_timer, n_cr_timeout, NULL);
+    uds_timer_init(&n_bs_timer, n_bs_timeout, NULL);
+    uds_timer_init(&tx_timer, tx_timer_expired, NULL);
+    uds_timer_init(&shm_timer, shm_publish, NULL);
+    return 0;
+}
+
+// 事件循环：等待CAN帧或最近的定时器到期
+void uds_server_run(void) {
+    struct can_frame frame;
+
+    while (!g_stop) {
+        struct pollfd pfd[2] = {
+            { .fd = g_sock, .events = POLLIN },
+            { .fd = g_stats_sock, .events = POLLIN }, // fd为-1时poll忽略该项
+        };
+        int timeout = g_rt.busy_poll ? 0 : uds_timer_next_timeout(&g_timers, uds_now_ms());
+        if (poll(pfd, 2, timeout) > 0) {
+            if (pfd[0].revents & POLLIN) {
+                while (can_recv(g_sock, &frame, &g_frame_rx_ns)) {
+                    handle_can_frame(&frame);
+                }
+            }
+            if (pfd[1].revents & POLLIN) {
+                stats_socket_serve(g_stats_sock);
+            }
+        }
+        uds_timer_run(&g_timers, uds_now_ms());
+        if (g_dump_stats) {
+            g_dump_stats = 0;
+            stats_print();
+        }
+    }
+}
+
+void uds_server_stop(void) {
+    g_stop = 1;
+}
+
+void uds_server_set_logging(int enabled) {
+    g_log_enabled = enabled;
+}
+
+void uds_server_set_can_ids(uint32_t phys_id, uint32_t resp_id) {
+    g_phys_id = phys_id;
+    g_resp_id = resp_id;
+}
+
+#ifndef UDS_SERVER_NO_MAIN
+static void stop_handler(int sig) {
+    g_stop = 1;
+}
+
+static void dump_handler(int sig) {
+    g_dump_stats = 1;
+}
+
+// 本地统计查询套接字：每个连接写出一次当前统计后关闭，例如 nc -U <path>
+static int stats_socket_open(const char *path) {
+    struct sockaddr_un sun = { .sun_family = AF_UNIX };
+    if (strlen(path) >= sizeof(sun.sun_path)) {
+        printf("[LOG] 统计套接字路径过长: %s\n", path);
+        return -1;
+    }
+    strcpy(sun.sun_path, path);
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        perror("socket(AF_UNIX)");
+        return -1;
+    }
+    unlink(path);
+    if (bind(fd, (struct sockaddr *)&sun, sizeof(sun)) < 0 || listen(fd, 4) < 0) {
+        perror("bind/listen(统计套接字)");
+        close(fd);
+        return -1;
+    }
+    printf("[LOG] 统计查询套接字: %s\n", path);
+    return fd;
+}
+
+static void usage(const char *prog) {
+    printf("用法: %s [-r] [-c cpu] [-p prio] [-b] [-q] [-s path] [-m name] [-a phys:resp]\n", prog);
+    printf("  -r       实时模式: SCHED_FIFO + mlockall + 预触页（同时关闭逐帧日志）\n");
+    printf("  -c cpu   绑定到指定CPU\n");
+    printf("  -p prio  SCHED_FIFO优先级 (默认%d)\n", UDS_RT_DEFAULT_PRIORITY);
+    printf("  -b       忙轮询CAN套接字，不在poll()中睡眠\n");
+    printf("  -q       关闭逐帧日志\n");
+    printf("  -s path  在path上监听本地(AF_UNIX)统计查询套接字\n");
+    printf("  -m name  把计数器和直方图发布到共享内存 /dev/shm/name（布局见uds_shm.h）\n");
+    printf("  -a phys:resp  物理请求ID与响应ID (默认0x%03X:0x%03X)，同一总线上运行多个实例时使用\n",
+           UDS_PHYS_ID, UDS_RESP_ID);
+    printf("退出(SIGINT/SIGTERM)或复位时输出响应延迟统计；SIGUSR1随时输出按SID/DID的请求处理统计\n");
+}
+
+int main(int argc, char **argv) {
     int s;
     struct sockaddr_can addr;
     struct ifreq ifr;
-    struct can_frame frame;
+    int opt;
+    const char *stats_path = NULL;
+    const char *shm_name = NULL;
     srand(time(NULL));
     
+    while ((opt = getopt(argc, argv, "rc:p:bqs:m:a:h")) != -1) {
+        switch (opt) {
+        case 'r':
+            g_rt.realtime = 1;
+            g_log_enabled = 0;
+            break;
+        case 'c':
+            g_rt.cpu = atoi(optarg);
+            break;
+        case 'p':
+            g_rt.priority = atoi(optarg);
+            break;
+        case 'b':
+            g_rt.busy_poll = 1;
+            break;
+        case 'q':
+            g_log_enabled = 0;
+            break;
+        case 's':
+            stats_path = optarg;
+            break;
+        case 'm':
+            shm_name = optarg;
+            break;
+        case 'a': {
+            char *end;
+            uint32_t phys = strtoul(optarg, &end, 16);
+            if (*end != ':') {
+                usage(argv[0]);
+                return 1;
+            }
+            uds_server_set_can_ids(phys, strtoul(end + 1, NULL, 16));
+            break;
+        }
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    
     // 设置信号处理
     signal(SIGSEGV, segfault_handler);
     signal(SIGBUS, segfault_handler);
+    struct sigaction sa = { .sa_handler = stop_handler }; // 不设SA_RESTART，poll()被打断后检查g_stop
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    struct sigaction sa_dump = { .sa_handler = dump_handler };
+    sigaction(SIGUSR1, &sa_dump, NULL);
     
     // 显示程序内存布局信息
     printf("=== UDS服务器内存布局 ===\n");
     printf("程序基址: 0x%08X\n", (unsigned int)main);
-    printf("PUBLIC_FLAG地址: 0x%08X\n", (unsigned int)PUBLIC_FLAG);
-    printf("SECURE_FLAG地址: 0x%08X\n", (unsigned int)SECURE_FLAG);
-    printf("ADVANCED_FLAG地址: 0x%08X\n", (unsigned int)ADVANCED_FLAG);
-    printf("BOOT_FLAG地址: 0x%08X\n", (unsigned int)BOOT_FLAG);
-    printf("MEMORY_FLAG地址: 0x%08X\n", (unsigned int)MEMORY_FLAG);
+    for (int i = 0; i < uds_ecu_num_strings; i++) {
+        printf("%s地址: 0x%08X\n", uds_ecu_strings[i].name, (unsigned int)(uintptr_t)uds_ecu_strings[i].value);
+    }
     printf("========================\n\n");
 
     if ((s = socket(PF_CAN, SOCK_RAW, CAN_RAW)) < 0) {
@@ -788,201 +1531,49 @@ int main() {
         if (g_elf_data) {
             fread(g_elf_data, 1, g_elf_size, elf_file);
             fclose(elf_file);
-            printf("[LOG] 成功读取ELF文件 'uds_server' (大小: %zu bytes)\n", g_elf_size);
+            LOG("成功读取ELF文件 'uds_server' (大小: %zu bytes)\n", g_elf_size);
         } else {
             perror("malloc");
             fclose(elf_file);
             return 1;
         }
     } else {
+        // 不在自身目录启动时读不到ELF文件，0x23改为直接读映射的程序映像
         perror("fopen");
+        LOG("未能读取ELF文件 'uds_server'，0x23将直接读取内存\n");
+    }
+
+    if (uds_server_init(s) < 0) {
+        perror("malloc");
         return 1;
     }
+    if (uds_rt_apply(&g_rt) > 0) {
+        printf("[LOG] 部分实时设置未生效，继续以普通方式运行\n");
+    }
+    g_rt.busy_poll = uds_rt_busy_poll_allowed(&g_rt);
+    if (g_rt.realtime) {
+        uds_rt_prefault(g_arena.base, g_arena.size);
+    }
+    if (stats_path) {
+        g_stats_sock = stats_socket_open(stats_path);
+    }
+    if (shm_name) {
+        g_shm = uds_shm_open(shm_name);
+    }
+    uds_alloc_seal(); // 此后请求处理路径不再使用堆
 
-    while (1) {
-        // 会话超时检查
-        if (current_session != 0x01 && last_tester_present_time > 0) {
-            time_t now = time(NULL);
-            if (now - last_tester_present_time > 10) {
-                printf("[LOG] 会话超时，自动回退到默认会话\n");
-                current_session = 0x01;
-                // 注意：安全访问状态在默认会话中仍然有效
-                // security_level 和 security_unlocked 保持不变
-                last_tester_present_time = 0;
-            }
-        }
-        int nbytes = read(s, &frame, sizeof(struct can_frame));
-        if (nbytes < 0) continue;
-        printf("[LOG] 收到CAN帧: can_id=0x%03X, dlc=%d, data=", frame.can_id, frame.can_dlc);
-        for (int i = 0; i < frame.can_dlc; ++i) printf("%02X ", frame.data[i]);
-        printf("\n");
-        if (frame.can_id != UDS_PHYS_ID) {
-            printf("[LOG] 非UDS物理寻址帧，忽略\n");
-            continue;
-        }
-        
-        // 解析ISO-TP长度字段
-        uint8_t frame_type = (frame.data[0] >> 4) & 0x0F;
-        uint8_t data_length = frame.data[0] & 0x0F;
-        uint8_t *uds_data = NULL;
-        int uds_data_len = 0;
-        
-        printf("[LOG] ISO-TP帧类型: 0x%X, 数据长度: %d\n", frame_type, data_length);
-        
-        if (frame_type == 0x0) { // 单帧
-            if (data_length > 0 && data_length <= 7) {
-                uds_data = &frame.data[1];
-                uds_data_len = data_length;
-                printf("[LOG] 单帧UDS数据: ");
-                for (int i = 0; i < uds_data_len; ++i) printf("%02X ", uds_data[i]);
-                printf("\n");
-            } else {
-                printf("[LOG] 单帧数据长度无效: %d\n", data_length);
-                continue;
-            }
-        } else if (frame_type == 0x1) { // 首帧
-            printf("[LOG] 收到首帧，开始多帧处理\n");
-            
-            // 解析首帧长度
-            uint16_t total_length = ((frame.data[0] & 0x0F) << 8) | frame.data[1];
-            printf("[LOG] 多帧总长度: %d字节\n", total_length);
-            
-            // 分配缓冲区
-            uint8_t *multi_frame_data = malloc(total_length);
-            if (!multi_frame_data) {
-                printf("[LOG] 内存分配失败\n");
-                continue;
-            }
-            
-            // 复制首帧数据
-            int first_frame_data_len = 6; // 首帧数据长度
-            memcpy(multi_frame_data, &frame.data[2], first_frame_data_len);
-            
-            // 发送流控帧
-            struct can_frame fc_frame;
-            fc_frame.can_id = UDS_PHYS_ID;
-            fc_frame.data[0] = 0x30; // 流控帧
-            fc_frame.data[1] = 0x00; // 块大小
-            fc_frame.data[2] = 0x00; // STmin
-            fc_frame.can_dlc = 3;
-            write(s, &fc_frame, sizeof(struct can_frame));
-            printf("[LOG] 发送流控帧\n");
-            
-            // 接收连续帧
-            int received_len = first_frame_data_len;
-            uint8_t sn = 1;
-            
-            while (received_len < total_length) {
-                int nbytes = read(s, &frame, sizeof(struct can_frame));
-                if (nbytes < 0) break;
-                
-                if (frame.can_id == UDS_PHYS_ID) {
-                    uint8_t cf_frame_type = (frame.data[0] >> 4) & 0x0F;
-                    if (cf_frame_type == 0x2) { // 连续帧
-                        uint8_t received_sn = frame.data[0] & 0x0F;
-                        if (received_sn == sn) {
-                            int cf_data_len = frame.can_dlc - 1;
-                            int copy_len = (total_length - received_len < cf_data_len) ? 
-                                          (total_length - received_len) : cf_data_len;
-                            
-                            memcpy(multi_frame_data + received_len, &frame.data[1], copy_len);
-                            received_len += copy_len;
-                            sn = (sn + 1) & 0x0F;
-                            
-                            printf("[LOG] 收到连续帧SN=%d, 已接收%d/%d字节\n", 
-                                   received_sn, received_len, total_length);
-                        }
-                    }
-                }
-            }
-            
-            if (received_len == total_length) {
-                uds_data = multi_frame_data;
-                uds_data_len = total_length;
-                printf("[LOG] 多帧接收完成，UDS数据: ");
-                for (int i = 0; i < uds_data_len; ++i) printf("%02X ", uds_data[i]);
-                printf("\n");
-            } else {
-                printf("[LOG] 多帧接收失败\n");
-                free(multi_frame_data);
-                continue;
-            }
-        } else if (frame_type == 0x2) { // 连续帧（单独收到）
-            printf("[LOG] 收到连续帧，但未在首帧处理中\n");
-            continue;
-        } else if (frame_type == 0x3) { // 流控帧
-            printf("[LOG] 收到流控帧，忽略\n");
-            continue;
-        } else {
-            printf("[LOG] 未知帧类型: 0x%X\n", frame_type);
-            continue;
-        }
-        
-        if (uds_data == NULL || uds_data_len == 0) {
-            printf("[LOG] 无有效UDS数据\n");
-            continue;
-        }
-        
-        uint8_t resp[64];
-        int resp_len = 0;
-        int handled = 0;
-        
-        if (uds_data[0] == 0x10) {
-            handled = handle_diagnostic_session_control(uds_data, uds_data_len, resp, &resp_len);
-        } else if (uds_data[0] == 0x11) {
-            handled = handle_ecu_reset(uds_data, uds_data_len, resp, &resp_len);
-        } else if (uds_data[0] == 0x22) {
-            handled = handle_read_data_by_identifier(uds_data, uds_data_len, resp, &resp_len);
-            if (handled == 2) {
-                uint8_t did[2] = {uds_data[1], uds_data[2]};
-                send_isotp_response(s, 0x62, did, PUBLIC_FLAG, strlen(PUBLIC_FLAG));
-                continue;
-            } else if (handled == 3) {
-                uint8_t did[2] = {uds_data[1], uds_data[2]};
-                send_isotp_response(s, 0x62, did, SECURE_FLAG, strlen(SECURE_FLAG));
-                continue;
-            } else if (handled == 4) {
-                uint8_t did[2] = {uds_data[1], uds_data[2]};
-                send_isotp_response(s, 0x62, did, ADVANCED_FLAG, strlen(ADVANCED_FLAG));
-                continue;
-            }
-        } else if (uds_data[0] == 0x23) {
-            handled = handle_read_memory_by_address(uds_data, uds_data_len, resp, &resp_len);
-        } else if (uds_data[0] == 0x27) {
-            handled = handle_security_access(uds_data, uds_data_len, resp, &resp_len);
-        } else if (uds_data[0] == 0x3E) {
-            handled = handle_tester_present(uds_data, uds_data_len, resp, &resp_len);
-        } else {
-            printf("[LOG] 未实现的服务号: 0x%02X\n", uds_data[0]);
-        }
-        
-        if (handled == 0 && resp_len > 0) {
-            // 检查响应长度，如果超过单帧限制，使用多帧发送
-            if (resp_len <= 7) {
-                // 单帧发送
-                struct can_frame txf;
-                txf.can_id = UDS_RESP_ID;
-                txf.data[0] = resp_len; // 单帧，长度字段
-                memcpy(&txf.data[1], resp, resp_len);
-                txf.can_dlc = 1 + resp_len;
-                printf("[LOG] 发送单帧响应: can_id=0x%03X, dlc=%d, data=", txf.can_id, txf.can_dlc);
-                for (int i = 0; i < txf.can_dlc; ++i) printf("%02X ", txf.data[i]);
-                printf("\n");
-                write(s, &txf, sizeof(struct can_frame));
-            } else {
-                // 多帧发送
-                printf("[LOG] 响应长度超过单帧限制(%d字节)，使用多帧发送\n", resp_len);
-                send_isotp_response_raw(s, resp, resp_len);
-            }
-        } else if (handled != 0) {
-            printf("[LOG] 未处理/错误的请求\n");
-        }
-        
-        // 释放多帧数据内存
-        if (frame_type == 0x1 && uds_data != NULL) {
-            free(uds_data);
-        }
+    uds_server_run();
+    uds_lat_report(stdout);
+    stats_print();
+    if (g_shm) {
+        shm_publish(&shm_timer, NULL);
+        uds_shm_close(g_shm, shm_name);
+    }
+    if (stats_path && g_stats_sock >= 0) {
+        close(g_stats_sock);
+        unlink(stats_path);
     }
     close(s);
     return 0;
-} 
\ No newline at end of file
+}
+#endif
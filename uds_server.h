@@ -0,0 +1,25 @@
+#ifndef UDS_SERVER_H
+#define UDS_SERVER_H
+
+#include <stdint.h>
+#include "uds_key.h" // 0x27各安全级别的key算法
+
+// 服务器事件循环的嵌入接口：uds_server.c以 -DUDS_SERVER_NO_MAIN 编译时不含main()，
+// 由基准测试等程序在进程内驱动。sock上每次读写一个struct can_frame（CAN_RAW或SOCK_SEQPACKET）
+
+// 初始化arena、统计和定时器并接管sock，失败返回-1
+int uds_server_init(int sock);
+
+// 运行事件循环，直到uds_server_stop()
+void uds_server_run(void);
+
+// 请求事件循环退出；从其他线程调用时需要让sock变为可读（例如关闭对端）以唤醒poll()
+void uds_server_stop(void);
+
+void uds_server_set_logging(int enabled);
+
+// 物理寻址请求ID与响应ID（默认0x7E0/0x7E8），同一总线上运行多个服务器实例时各用一对；
+// 功能寻址ID固定为0x7DF。需在uds_server_init()之前调用
+void uds_server_set_can_ids(uint32_t phys_id, uint32_t resp_id);
+
+#endif
@@ -0,0 +1,102 @@
+#include "uds_shm.h"
+#include "uds_rt.h"
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// 上次发布时各条目的变化标记，未变化的记录不重写，避免监控端无谓重试
+static uint64_t g_published[UDS_SHM_ENTRIES];
+
+static void shm_path(char *buf, size_t len, const char *name) {
+    snprintf(buf, len, "%s%s", name[0] == '/' ? "" : "/", name);
+}
+
+uds_shm_t *uds_shm_open(const char *name) {
+    char path[256];
+    shm_path(path, sizeof(path), name);
+    int fd = shm_open(path, O_CREAT | O_RDWR | O_TRUNC, 0644);
+    if (fd < 0) {
+        perror("shm_open");
+        return NULL;
+    }
+    if (ftruncate(fd, sizeof(uds_shm_t)) < 0) {
+        perror("ftruncate");
+        close(fd);
+        shm_unlink(path);
+        return NULL;
+    }
+    uds_shm_t *shm = mmap(NULL, sizeof(uds_shm_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (shm == MAP_FAILED) {
+        perror("mmap");
+        shm_unlink(path);
+        return NULL;
+    }
+    memset(shm, 0, sizeof(*shm)); // 同时预触全部页面
+    shm->version = UDS_SHM_VERSION;
+    shm->pid = getpid();
+    shm->header_size = offsetof(uds_shm_t, traffic);
+    shm->entry_size = sizeof(uds_shm_entry_t);
+    shm->n_entries = UDS_SHM_ENTRIES;
+    shm->start_realtime_ns = uds_rt_realtime_ns();
+    memset(g_published, 0, sizeof(g_published));
+    // magic最后写入：监控端看到magic即可认为头部完整
+    __atomic_store_n(&shm->magic, UDS_SHM_MAGIC, __ATOMIC_RELEASE);
+    printf("[LOG] 共享内存指标段: /dev/shm%s (%zu bytes)\n", path, sizeof(uds_shm_t));
+    return shm;
+}
+
+void uds_shm_close(uds_shm_t *shm, const char *name) {
+    char path[256];
+    shm_path(path, sizeof(path), name);
+    munmap(shm, sizeof(*shm));
+    shm_unlink(path);
+}
+
+static uint32_t ns_to_us(uint64_t ns) {
+    uint64_t us = ns / 1000;
+    return us > UINT32_MAX ? UINT32_MAX : (uint32_t)us;
+}
+
+static void publish_entry(uds_shm_entry_t *dst, const uds_stats_entry_t *src, uint32_t key) {
+    uds_shm_write_begin(&dst->seq);
+    dst->key = key;
+    dst->requests = src->requests;
+    dst->p2_overrun = src->p2_overrun;
+    dst->p2star_overrun = src->p2star_overrun;
+    dst->rcrrp = src->rcrrp;
+    dst->tx_aborted = src->tx_aborted;
+    for (int s = 0; s < UDS_STAGE_COUNT; s++) {
+        const uds_hist_t *h = &src->stage[s];
+        dst->p50_us[s] = ns_to_us(uds_hist_percentile(h, 0.50));
+        dst->p99_us[s] = ns_to_us(uds_hist_percentile(h, 0.99));
+        dst->p999_us[s] = ns_to_us(uds_hist_percentile(h, 0.999));
+        dst->max_us[s] = ns_to_us(h->max);
+    }
+    uds_shm_write_end(&dst->seq);
+}
+
+// 这些计数只增不减，和不变说明条目没有新数据
+static uint64_t change_mark(const uds_stats_entry_t *e) {
+    return e->requests + e->tx_aborted + e->rcrrp + e->stage[UDS_STAGE_FIRST_FRAME].count +
+           e->stage[UDS_STAGE_LAST_FRAME].count;
+}
+
+void uds_shm_publish_stats(uds_shm_t *shm) {
+    const uds_stats_entry_t *tot = uds_stats_total();
+    if (change_mark(tot) != g_published[0]) {
+        g_published[0] = change_mark(tot);
+        publish_entry(&shm->entries[0], tot, 0);
+    }
+    for (int i = 0; i < UDS_STATS_ENTRIES; i++) {
+        const uds_stats_entry_t *e = uds_stats_entry(i);
+        if (e->key == 0 || change_mark(e) == g_published[1 + i]) {
+            continue;
+        }
+        g_published[1 + i] = change_mark(e);
+        publish_entry(&shm->entries[1 + i], e, e->key);
+    }
+}
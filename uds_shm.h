@@ -0,0 +1,84 @@
+#ifndef UDS_SHM_H
+#define UDS_SHM_H
+
+#include <stdint.h>
+#include "uds_stats.h"
+
+// 共享内存指标段（-m name 时创建 /dev/shm/name）：同机的监控程序mmap只读映射后直接读取，
+// 服务器发布时只做内存写入，不产生系统调用，也不需要额外的套接字
+//
+// 每条记录独占整数个cache line，以seqlock保护。读取方法：
+//   do {
+//       s1 = __atomic_load_n(&rec->seq, __ATOMIC_ACQUIRE);
+//       if (s1 & 1) continue;              // 正在写入
+//       memcpy(&copy, rec, sizeof(copy));
+//       __atomic_thread_fence(__ATOMIC_ACQUIRE);
+//       s2 = __atomic_load_n(&rec->seq, __ATOMIC_RELAXED);
+//   } while (s1 != s2);
+#define UDS_SHM_MAGIC 0x4D534455 // "UDSM"（小端）
+#define UDS_SHM_VERSION 1
+#define UDS_SHM_CACHELINE 64
+#define UDS_SHM_ENTRIES (1 + UDS_STATS_ENTRIES) // [0]为汇总，其后与uds_stats条目一一对应
+
+// 流量计数，含义同0xFD00/0xFD03
+typedef struct {
+    _Alignas(UDS_SHM_CACHELINE) uint32_t seq;
+    uint32_t frames_rx;
+    uint32_t frames_tx;
+    uint32_t frames_dropped;
+    uint32_t rx_multi;
+    uint32_t tx_multi;
+    uint32_t requests;
+    uint32_t bytes_rx;
+    uint32_t bytes_tx;
+    uint32_t arena_high_water;
+    uint64_t uptime_ms;
+    uint64_t publish_count; // 发布次数，监控端可据此判断数据是否在更新
+} uds_shm_traffic_t;
+
+// 按SID/DID的请求统计，key为0表示空条目，编码同uds_stats（bit24起为条目类型，见UDS_STATS_KEY_*）
+typedef struct {
+    _Alignas(UDS_SHM_CACHELINE) uint32_t seq;
+    uint32_t key;
+    uint64_t requests;
+    uint64_t p2_overrun;
+    uint64_t p2star_overrun;
+    uint64_t rcrrp;
+    uint64_t tx_aborted;
+    uint32_t p50_us[UDS_STAGE_COUNT];
+    uint32_t p99_us[UDS_STAGE_COUNT];
+    uint32_t p999_us[UDS_STAGE_COUNT];
+    uint32_t max_us[UDS_STAGE_COUNT];
+} uds_shm_entry_t;
+
+typedef struct {
+    // 头部只在创建时写入一次
+    uint32_t magic;
+    uint32_t version;
+    uint32_t pid;
+    uint32_t header_size;  // offsetof(traffic)
+    uint32_t entry_size;   // sizeof(uds_shm_entry_t)
+    uint32_t n_entries;
+    uint64_t start_realtime_ns;
+    uds_shm_traffic_t traffic;
+    uds_shm_entry_t entries[UDS_SHM_ENTRIES];
+} uds_shm_t;
+
+// 创建并映射指标段，失败返回NULL（已打印原因）
+uds_shm_t *uds_shm_open(const char *name);
+void uds_shm_close(uds_shm_t *shm, const char *name);
+
+// seqlock写入：begin之后seq为奇数，end之后为偶数；只有一个写者（事件循环线程）
+static inline void uds_shm_write_begin(uint32_t *seq) {
+    __atomic_store_n(seq, *seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static inline void uds_shm_write_end(uint32_t *seq) {
+    __atomic_store_n(seq, *seq + 1, __ATOMIC_RELEASE);
+}
+
+// 把uds_stats的全部条目写入指标段，只重写自上次发布以来有变化的记录
+void uds_shm_publish_stats(uds_shm_t *shm);
+
+#endif
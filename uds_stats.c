@@ -0,0 +1,319 @@
+#include "uds_stats.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+static uds_stats_entry_t g_entries[UDS_STATS_ENTRIES];
+static uds_stats_entry_t g_total; // 全部请求汇总，key固定为0
+static unsigned g_entry_overflow = 0; // 条目表已满而未能单独统计的请求数
+static uint64_t g_p2_ns;
+static uint64_t g_p2star_ns;
+
+// 当前请求：最多同时计入SID和(SID, DID)两个条目，外加汇总
+static struct {
+    int active;
+    uds_stats_entry_t *e[3];
+    int n;
+    uint64_t rx_ns;
+    uint64_t budget_ref_ns; // P2/P2*计时起点：请求到达或上一个0x78发出
+    uint64_t budget_ns;
+    int handler_done;
+    int rcrrp_inflight;     // 正在发送的是0x78，其末帧不结束请求
+} g_cur;
+
+static unsigned hist_index(uint64_t v) {
+    if (v < UDS_HIST_SUB) {
+        return (unsigned)v;
+    }
+    if (v >> UDS_HIST_MAX_BITS) {
+        return UDS_HIST_BUCKETS - 1;
+    }
+    unsigned msb = 63 - __builtin_clzll(v);
+    unsigned shift = msb - UDS_HIST_SUB_BITS;
+    return shift * UDS_HIST_SUB + (unsigned)(v >> shift);
+}
+
+static uint64_t hist_upper(unsigned idx) {
+    if (idx < UDS_HIST_SUB) {
+        return idx;
+    }
+    unsigned shift = idx / UDS_HIST_SUB - 1;
+    uint64_t top = idx % UDS_HIST_SUB + UDS_HIST_SUB;
+    return ((top + 1) << shift) - 1;
+}
+
+void uds_hist_record(uds_hist_t *h, uint64_t value) {
+    h->buckets[hist_index(value)]++;
+    if (h->count == 0 || value < h->min) {
+        h->min = value;
+    }
+    if (value > h->max) {
+        h->max = value;
+    }
+    h->count++;
+}
+
+void uds_hist_merge(uds_hist_t *dst, const uds_hist_t *src) {
+    if (src->count == 0) {
+        return;
+    }
+    for (unsigned i = 0; i < UDS_HIST_BUCKETS; i++) {
+        dst->buckets[i] += src->buckets[i];
+    }
+    if (dst->count == 0 || src->min < dst->min) {
+        dst->min = src->min;
+    }
+    if (src->max > dst->max) {
+        dst->max = src->max;
+    }
+    dst->count += src->count;
+}
+
+uint64_t uds_hist_percentile(const uds_hist_t *h, double q) {
+    if (h->count == 0) {
+        return 0;
+    }
+    uint64_t rank = (uint64_t)(q * (h->count - 1) + 0.5) + 1;
+    uint64_t seen = 0;
+    for (unsigned i = 0; i < UDS_HIST_BUCKETS; i++) {
+        seen += h->buckets[i];
+        if (seen >= rank) {
+            uint64_t upper = hist_upper(i);
+            return upper > h->max ? h->max : upper;
+        }
+    }
+    return h->max;
+}
+
+void uds_stats_init(uint32_t p2_ms, uint32_t p2star_ms) {
+    memset(g_entries, 0, sizeof(g_entries));
+    memset(&g_total, 0, sizeof(g_total));
+    memset(&g_cur, 0, sizeof(g_cur));
+    g_entry_overflow = 0;
+    g_p2_ns = (uint64_t)p2_ms * 1000000;
+    g_p2star_ns = (uint64_t)p2star_ms * 1000000;
+}
+
+// 在[first, first + n)内线性探测查找/插入，key为0的条目视为空
+static uds_stats_entry_t *lookup(uint32_t key, unsigned first, unsigned n) {
+    unsigned start = (key ^ (key >> 16)) % n;
+    for (unsigned i = 0; i < n; i++) {
+        uds_stats_entry_t *e = &g_entries[first + (start + i) % n];
+        if (e->key == key) {
+            return e;
+        }
+        if (e->key == 0) {
+            e->key = key;
+            return e;
+        }
+    }
+    g_entry_overflow++;
+    return NULL;
+}
+
+void uds_stats_begin(int sid, uint32_t did, uint64_t rx_ns) {
+    memset(&g_cur, 0, sizeof(g_cur));
+    g_cur.active = 1;
+    g_cur.rx_ns = rx_ns;
+    g_cur.budget_ref_ns = rx_ns;
+    g_cur.budget_ns = g_p2_ns;
+    g_cur.e[g_cur.n++] = &g_total;
+    uds_stats_entry_t *e;
+    if (sid == UDS_STATS_UNSUPPORTED_SID) {
+        // SID扫描时每个不支持的SID都单独建条目会占满保留区，合并为一个
+        e = lookup(UDS_STATS_KEY_UNSUPPORTED, 0, UDS_STATS_SID_ENTRIES);
+        if (e) {
+            g_cur.e[g_cur.n++] = e;
+        }
+    } else {
+        uint32_t sid_bits = (uint32_t)(sid & 0xFF) << 16;
+        e = lookup(UDS_STATS_KEY_SID | sid_bits, 0, UDS_STATS_SID_ENTRIES);
+        if (e) {
+            g_cur.e[g_cur.n++] = e;
+        }
+        if (did == UDS_STATS_OTHER_DID) {
+            e = lookup(UDS_STATS_KEY_OTHER_DID | sid_bits, 0, UDS_STATS_SID_ENTRIES);
+        } else if (did != UDS_STATS_NO_DID) {
+            e = lookup(UDS_STATS_KEY_DID | sid_bits | (did & 0xFFFF), UDS_STATS_SID_ENTRIES,
+                       UDS_STATS_ENTRIES - UDS_STATS_SID_ENTRIES);
+        } else {
+            e = NULL;
+        }
+        if (e) {
+            g_cur.e[g_cur.n++] = e;
+        }
+    }
+    for (int i = 0; i < g_cur.n; i++) {
+        g_cur.e[i]->requests++;
+    }
+}
+
+static void record(int stage, uint64_t now_ns) {
+    uint64_t v = now_ns > g_cur.rx_ns ? now_ns - g_cur.rx_ns : 0;
+    for (int i = 0; i < g_cur.n; i++) {
+        uds_hist_record(&g_cur.e[i]->stage[stage], v);
+    }
+}
+
+void uds_stats_handler_done(uint64_t now_ns) {
+    if (!g_cur.active || g_cur.handler_done) {
+        return;
+    }
+    g_cur.handler_done = 1;
+    record(UDS_STAGE_HANDLER, now_ns);
+}
+
+void uds_stats_first_frame(uint64_t now_ns, int rcrrp) {
+    if (!g_cur.active) {
+        return;
+    }
+    if (now_ns - g_cur.budget_ref_ns > g_cur.budget_ns) {
+        for (int i = 0; i < g_cur.n; i++) {
+            if (g_cur.budget_ns == g_p2_ns) {
+                g_cur.e[i]->p2_overrun++;
+            } else {
+                g_cur.e[i]->p2star_overrun++;
+            }
+        }
+    }
+    g_cur.rcrrp_inflight = rcrrp;
+    if (rcrrp) {
+        // 0x78之后的最终响应以P2*为限，从本次0x78发出时重新计时
+        for (int i = 0; i < g_cur.n; i++) {
+            g_cur.e[i]->rcrrp++;
+        }
+        g_cur.budget_ref_ns = now_ns;
+        g_cur.budget_ns = g_p2star_ns;
+        return;
+    }
+    record(UDS_STAGE_FIRST_FRAME, now_ns);
+}
+
+void uds_stats_last_frame(uint64_t now_ns) {
+    if (!g_cur.active || g_cur.rcrrp_inflight) {
+        return;
+    }
+    record(UDS_STAGE_LAST_FRAME, now_ns);
+    g_cur.active = 0;
+}
+
+void uds_stats_tx_aborted(void) {
+    if (!g_cur.active) {
+        return;
+    }
+    for (int i = 0; i < g_cur.n; i++) {
+        g_cur.e[i]->tx_aborted++;
+    }
+    g_cur.active = 0;
+}
+
+void uds_stats_end(void) {
+    g_cur.active = 0;
+}
+
+const uds_stats_entry_t *uds_stats_total(void) {
+    return &g_total;
+}
+
+const uds_stats_entry_t *uds_stats_entry(int i) {
+    return &g_entries[i];
+}
+
+// snprintf的追加版本，缓冲区满时截断但保持计数正确
+static size_t append(char *buf, size_t len, size_t pos, const char *fmt, ...) {
+    if (pos >= len) {
+        return pos;
+    }
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(buf + pos, len - pos, fmt, ap);
+    va_end(ap);
+    if (n < 0) {
+        return pos;
+    }
+    return pos + n < len ? pos + n : len - 1;
+}
+
+static const char *stage_name[UDS_STAGE_COUNT] = { "handler", "first", "last" };
+
+static size_t format_entry(char *buf, size_t len, size_t pos, const uds_stats_entry_t *e,
+                           const char *name) {
+    pos = append(buf, len, pos,
+                 "%s requests=%llu p2_overrun=%llu p2star_overrun=%llu nrc78=%llu tx_aborted=%llu\n",
+                 name, (unsigned long long)e->requests, (unsigned long long)e->p2_overrun,
+                 (unsigned long long)e->p2star_overrun, (unsigned long long)e->rcrrp,
+                 (unsigned long long)e->tx_aborted);
+    for (int s = 0; s < UDS_STAGE_COUNT; s++) {
+        const uds_hist_t *h = &e->stage[s];
+        if (!h->count) {
+            continue;
+        }
+        pos = append(buf, len, pos,
+                     "  %-7s n=%llu min=%.1fus p50=%.1fus p90=%.1fus p99=%.1fus p99.9=%.1fus max=%.1fus\n",
+                     stage_name[s], (unsigned long long)h->count, h->min / 1000.0,
+                     uds_hist_percentile(h, 0.50) / 1000.0, uds_hist_percentile(h, 0.90) / 1000.0,
+                     uds_hist_percentile(h, 0.99) / 1000.0, uds_hist_percentile(h, 0.999) / 1000.0,
+                     h->max / 1000.0);
+    }
+    return pos;
+}
+
+// 输出顺序：SID在高位，同一SID内DID < 其他DID < SID汇总，不支持的SID排在所有SID之后
+static uint64_t sort_key(uint32_t key) {
+    uint64_t sid = (key >> 16) & 0xFF;
+    uint64_t rank = 0;
+    switch (UDS_STATS_KEY_TYPE(key)) {
+    case UDS_STATS_KEY_OTHER_DID: rank = 1; break;
+    case UDS_STATS_KEY_SID: rank = 2; break;
+    case UDS_STATS_KEY_UNSUPPORTED: sid = 0x100; break;
+    }
+    return (sid << 32) | (rank << 16) | (key & 0xFFFF);
+}
+
+size_t uds_stats_format(char *buf, size_t len) {
+    size_t pos = 0;
+    char name[32];
+
+    if (len == 0) {
+        return 0;
+    }
+    buf[0] = '\0';
+    pos = append(buf, len, pos, "=== 请求处理统计（自请求最后一帧到达起计时，P2=%llums P2*=%llums）===\n",
+                 (unsigned long long)(g_p2_ns / 1000000), (unsigned long long)(g_p2star_ns / 1000000));
+    pos = format_entry(buf, len, pos, &g_total, "total");
+    // 按SID排序输出：同一SID的DID条目排在一起，其后是其他DID和SID汇总条目，不支持的SID排在最后
+    uint64_t last = 0;
+    for (;;) {
+        const uds_stats_entry_t *next = NULL;
+        for (int i = 0; i < UDS_STATS_ENTRIES; i++) {
+            const uds_stats_entry_t *e = &g_entries[i];
+            if (e->key && sort_key(e->key) > last && (!next || sort_key(e->key) < sort_key(next->key))) {
+                next = e;
+            }
+        }
+        if (!next) {
+            break;
+        }
+        last = sort_key(next->key);
+        uint32_t sid = (next->key >> 16) & 0xFF;
+        switch (UDS_STATS_KEY_TYPE(next->key)) {
+        case UDS_STATS_KEY_SID:
+            snprintf(name, sizeof(name), "sid=0x%02X", sid);
+            break;
+        case UDS_STATS_KEY_OTHER_DID:
+            snprintf(name, sizeof(name), "sid=0x%02X did=other", sid);
+            break;
+        case UDS_STATS_KEY_UNSUPPORTED:
+            snprintf(name, sizeof(name), "sid=unsupported");
+            break;
+        default:
+            snprintf(name, sizeof(name), "sid=0x%02X did=0x%04X", sid, next->key & 0xFFFF);
+            break;
+        }
+        pos = format_entry(buf, len, pos, next, name);
+    }
+    if (g_entry_overflow) {
+        pos = append(buf, len, pos, "条目表已满，另有%u个请求只计入total\n", g_entry_overflow);
+    }
+    return pos;
+}
@@ -0,0 +1,81 @@
+#ifndef UDS_STATS_H
+#define UDS_STATS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// HDR风格直方图：对数分段 + 段内线性子桶，相对误差约1/16，记录O(1)、不分配内存
+// 纳秒取值，上限约2^40ns（18分钟），更大的值计入最后一个桶
+#define UDS_HIST_SUB_BITS 4
+#define UDS_HIST_SUB (1 << UDS_HIST_SUB_BITS)
+#define UDS_HIST_MAX_BITS 40
+#define UDS_HIST_BUCKETS ((UDS_HIST_MAX_BITS - UDS_HIST_SUB_BITS + 1) * UDS_HIST_SUB)
+
+typedef struct {
+    uint64_t count;
+    uint64_t min;
+    uint64_t max;
+    uint32_t buckets[UDS_HIST_BUCKETS];
+} uds_hist_t;
+
+void uds_hist_record(uds_hist_t *h, uint64_t value);
+// dst += src（例如合并各线程的直方图）
+void uds_hist_merge(uds_hist_t *dst, const uds_hist_t *src);
+// q取0..1，返回该分位所在桶的上界
+uint64_t uds_hist_percentile(const uds_hist_t *h, double q);
+
+// 每个请求的计时阶段，均从请求最后一帧到达内核算起
+enum {
+    UDS_STAGE_HANDLER,     // 处理函数返回
+    UDS_STAGE_FIRST_FRAME, // 最终响应首帧写出
+    UDS_STAGE_LAST_FRAME,  // 最终响应末帧写出
+    UDS_STAGE_COUNT,
+};
+
+// 按SID统计，0x22等带DID的请求另按(SID, DID)再统计一份
+// 条目不回收：前UDS_STATS_SID_ENTRIES个留给SID汇总、“其他DID”和“不支持的SID”条目，
+// SID/DID扫描占满其余条目也不影响按SID的统计
+#define UDS_STATS_ENTRIES 32
+#define UDS_STATS_SID_ENTRIES 12
+#define UDS_STATS_NO_DID 0xFFFFFFFFu
+#define UDS_STATS_OTHER_DID 0x10000u // 调用方未识别的DID，同一SID下合并为一个条目，避免扫描占满条目表
+#define UDS_STATS_UNSUPPORTED_SID (-1) // 以NRC 0x11拒绝的SID，全部合并为一个条目
+
+// key编码：bit24..31为条目类型，bit16..23为SID，bit0..15为DID；类型不占DID位，真实DID 0xFFFE/0xFFFF照常统计
+#define UDS_STATS_KEY_DID 0u                // (SID, DID)
+#define UDS_STATS_KEY_SID (1u << 24)         // SID汇总
+#define UDS_STATS_KEY_OTHER_DID (2u << 24)   // 同一SID下的其他DID
+#define UDS_STATS_KEY_UNSUPPORTED (3u << 24) // 不支持的SID，SID位为0
+#define UDS_STATS_KEY_TYPE(key) ((key) & 0xFF000000u)
+
+typedef struct {
+    uint32_t key;           // 类型 | (SID << 16) | DID，见UDS_STATS_KEY_*，未使用的条目为0
+    uint64_t requests;
+    uint64_t p2_overrun;    // 响应（或0x78）开始时已超过P2
+    uint64_t p2star_overrun; // 0x78之后的响应开始时已超过P2*
+    uint64_t rcrrp;         // 发出的0x78(RequestCorrectlyReceived-ResponsePending)次数
+    uint64_t tx_aborted;    // 多帧发送被N_Bs/流控终止
+    uds_hist_t stage[UDS_STAGE_COUNT];
+} uds_stats_entry_t;
+
+void uds_stats_init(uint32_t p2_ms, uint32_t p2star_ms);
+
+// 请求生命周期：begin -> handler_done -> first_frame (-> 0x78则重复) -> last_frame
+// 没有响应（抑制/丢弃）的请求在handler_done之后调用uds_stats_end
+// sid为UDS_STATS_UNSUPPORTED_SID时did被忽略
+void uds_stats_begin(int sid, uint32_t did, uint64_t rx_ns);
+void uds_stats_handler_done(uint64_t now_ns);
+void uds_stats_first_frame(uint64_t now_ns, int rcrrp);
+void uds_stats_last_frame(uint64_t now_ns);
+void uds_stats_tx_aborted(void);
+void uds_stats_end(void);
+
+// 全部请求的汇总条目
+const uds_stats_entry_t *uds_stats_total(void);
+// 第i个（0..UDS_STATS_ENTRIES-1）按SID/DID的条目，key为0表示未使用；条目位置分配后不再变化
+const uds_stats_entry_t *uds_stats_entry(int i);
+
+// 把全部统计格式化为文本，返回写入的字节数（不含结尾0）；不使用堆，可在事件循环中调用
+size_t uds_stats_format(char *buf, size_t len);
+
+#endif
@@ -0,0 +1,176 @@
+#include "uds_timer.h"
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+
+#define SLOT_MASK (UDS_TIMER_SLOTS - 1)
+#define LEVEL_SHIFT(level) ((level) * UDS_TIMER_SLOT_BITS)
+
+uint64_t uds_now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+void uds_timer_wheel_init(uds_timer_wheel_t *w, uint64_t now_ms) {
+    memset(w, 0, sizeof(*w));
+    w->now = now_ms;
+}
+
+void uds_timer_init(uds_timer_t *t, uds_timer_fn fn, void *arg) {
+    memset(t, 0, sizeof(*t));
+    t->fn = fn;
+    t->arg = arg;
+}
+
+static void list_add(uds_timer_t **head, uds_timer_t *t) {
+    t->next = *head;
+    if (*head) {
+        (*head)->pprev = &t->next;
+    }
+    *head = t;
+    t->pprev = head;
+}
+
+static void list_del(uds_timer_t *t) {
+    *t->pprev = t->next;
+    if (t->next) {
+        t->next->pprev = t->pprev;
+    }
+    t->next = NULL;
+    t->pprev = NULL;
+}
+
+// 按到期时间与当前时刻的差值选择级别：差值落在某级64个槽之内就放在该级
+static void place(uds_timer_wheel_t *w, uds_timer_t *t) {
+    uint64_t expires = t->expires > w->now ? t->expires : w->now + 1;
+    for (int level = 0; level < UDS_TIMER_LEVELS; level++) {
+        int shift = LEVEL_SHIFT(level);
+        if ((expires >> shift) - (w->now >> shift) < UDS_TIMER_SLOTS) {
+            int slot = (expires >> shift) & SLOT_MASK;
+            list_add(&w->slots[level][slot], t);
+            w->occupied[level] |= 1ULL << slot;
+            return;
+        }
+    }
+    // 超出时间轮范围（约4.6小时）：放在最高级最远的槽，级联时再重新放置
+    int top = UDS_TIMER_LEVELS - 1;
+    int slot = ((w->now >> LEVEL_SHIFT(top)) + SLOT_MASK) & SLOT_MASK;
+    list_add(&w->slots[top][slot], t);
+    w->occupied[top] |= 1ULL << slot;
+}
+
+// 把一个槽整体摘下，返回的链表头由调用者接管
+static uds_timer_t *detach_slot(uds_timer_wheel_t *w, int level, int slot) {
+    uds_timer_t *head = w->slots[level][slot];
+    w->slots[level][slot] = NULL;
+    w->occupied[level] &= ~(1ULL << slot);
+    return head;
+}
+
+// 下一个需要处理的时刻：第0级为定时器到期时间，更高级为槽的级联边界
+static uint64_t next_event(const uds_timer_wheel_t *w) {
+    uint64_t best = UINT64_MAX;
+    for (int level = 0; level < UDS_TIMER_LEVELS; level++) {
+        uint64_t bitmap = w->occupied[level];
+        if (!bitmap) {
+            continue;
+        }
+        int shift = LEVEL_SHIFT(level);
+        unsigned start = ((w->now >> shift) + 1) & SLOT_MASK;
+        uint64_t rotated = start ? (bitmap >> start) | (bitmap << (64 - start)) : bitmap;
+        uint64_t when = ((w->now >> shift) + 1 + __builtin_ctzll(rotated)) << shift;
+        if (when < best) {
+            best = when;
+        }
+    }
+    return best;
+}
+
+void uds_timer_start(uds_timer_wheel_t *w, uds_timer_t *t, uint32_t delay_ms) {
+    uds_timer_stop(w, t);
+    t->expires = uds_now_ms() + delay_ms;
+    place(w, t);
+    w->pending++;
+}
+
+void uds_timer_stop(uds_timer_wheel_t *w, uds_timer_t *t) {
+    if (!uds_timer_pending(t)) {
+        return;
+    }
+    uds_timer_t **head = t->pprev;
+    list_del(t);
+    w->pending--;
+    // 槽变空时清除占用位，否则next_event会在空槽上白白唤醒
+    for (int level = 0; level < UDS_TIMER_LEVELS; level++) {
+        uds_timer_t **first = &w->slots[level][0];
+        if (head >= first && head < first + UDS_TIMER_SLOTS && !*head) {
+            w->occupied[level] &= ~(1ULL << (head - first));
+            break;
+        }
+    }
+}
+
+unsigned uds_timer_run(uds_timer_wheel_t *w, uint64_t now_ms) {
+    unsigned fired = 0;
+
+    while (w->pending) {
+        uint64_t next = next_event(w);
+        if (next > now_ms) {
+            break;
+        }
+        w->now = next;
+
+        // 本地到期链表：回调里可以安全地启动/停止任意定时器
+        uds_timer_t *due = NULL;
+
+        // 从高到低级联落在当前边界上的槽
+        for (int level = UDS_TIMER_LEVELS - 1; level >= 1; level--) {
+            if (w->now & ((1ULL << LEVEL_SHIFT(level)) - 1)) {
+                continue;
+            }
+            uds_timer_t *t = detach_slot(w, level, (w->now >> LEVEL_SHIFT(level)) & SLOT_MASK);
+            while (t) {
+                uds_timer_t *n = t->next;
+                if (t->expires <= w->now) {
+                    list_add(&due, t);
+                } else {
+                    place(w, t);
+                }
+                t = n;
+            }
+        }
+
+        uds_timer_t *t = detach_slot(w, 0, w->now & SLOT_MASK);
+        while (t) {
+            uds_timer_t *n = t->next;
+            list_add(&due, t);
+            t = n;
+        }
+
+        while (due) {
+            t = due;
+            list_del(t);
+            w->pending--;
+            fired++;
+            t->fn(t, t->arg);
+        }
+    }
+
+    if (now_ms > w->now) {
+        w->now = now_ms;
+    }
+    return fired;
+}
+
+int uds_timer_next_timeout(const uds_timer_wheel_t *w, uint64_t now_ms) {
+    if (!w->pending) {
+        return -1;
+    }
+    uint64_t next = next_event(w);
+    if (next <= now_ms) {
+        return 0;
+    }
+    uint64_t diff = next - now_ms;
+    return diff > INT_MAX ? INT_MAX : (int)diff;
+}
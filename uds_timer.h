@@ -0,0 +1,48 @@
+#ifndef UDS_TIMER_H
+#define UDS_TIMER_H
+
+#include <stdint.h>
+
+// 分层时间轮：4级，每级64个槽，分辨率1ms
+// 插入/取消为O(1)，查询下一个到期时间只看每级的占用位图，与定时器数量无关
+#define UDS_TIMER_LEVELS 4
+#define UDS_TIMER_SLOT_BITS 6
+#define UDS_TIMER_SLOTS (1 << UDS_TIMER_SLOT_BITS)
+
+struct uds_timer;
+typedef void (*uds_timer_fn)(struct uds_timer *t, void *arg);
+
+typedef struct uds_timer {
+    struct uds_timer *next;
+    struct uds_timer **pprev; // 非NULL表示定时器已挂在时间轮上
+    uint64_t expires;         // 到期时间（单调时钟，毫秒）
+    uds_timer_fn fn;
+    void *arg;
+} uds_timer_t;
+
+typedef struct {
+    uint64_t now; // 时间轮已推进到的时刻（毫秒）
+    uint64_t occupied[UDS_TIMER_LEVELS]; // 每级槽占用位图
+    uds_timer_t *slots[UDS_TIMER_LEVELS][UDS_TIMER_SLOTS];
+    unsigned pending; // 挂起的定时器数量
+} uds_timer_wheel_t;
+
+// 单调时钟毫秒数
+uint64_t uds_now_ms(void);
+
+void uds_timer_wheel_init(uds_timer_wheel_t *w, uint64_t now_ms);
+void uds_timer_init(uds_timer_t *t, uds_timer_fn fn, void *arg);
+
+// (重新)启动定时器，delay_ms后到期；已挂起的定时器会先被取消
+void uds_timer_start(uds_timer_wheel_t *w, uds_timer_t *t, uint32_t delay_ms);
+void uds_timer_stop(uds_timer_wheel_t *w, uds_timer_t *t);
+
+static inline int uds_timer_pending(const uds_timer_t *t) { return t->pprev != 0; }
+
+// 推进时间轮到now_ms并执行所有到期回调，返回执行的回调个数
+unsigned uds_timer_run(uds_timer_wheel_t *w, uint64_t now_ms);
+
+// 距离下一次需要推进时间轮的毫秒数，可直接作为poll()超时；没有定时器时返回-1
+int uds_timer_next_timeout(const uds_timer_wheel_t *w, uint64_t now_ms);
+
+#endif
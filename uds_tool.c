@@ -0,0 +1,146 @@
+#include "uds_tool.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include "uds_key.h"
+
+UDSClient_t uds_tool_client;
+volatile sig_atomic_t uds_tool_stop = 0;
+int uds_tool_verbose = 0;
+uint64_t uds_tool_requests = 0;
+uint64_t uds_tool_retries = 0;
+
+static UDSTpISOTpC_t g_tp;
+static int g_result; // 0: 等待中，1: 收到肯定响应，-1: 出错
+static UDSErr_t g_err;
+
+static int client_fn(UDSClient_t *client, UDSEvent_t evt, void *ev_data) {
+    switch (evt) {
+    case UDS_EVT_ResponseReceived:
+        g_result = 1;
+        break;
+    case UDS_EVT_Err:
+        g_err = *(UDSErr_t *)ev_data;
+        g_result = -1;
+        break;
+    default:
+        break;
+    }
+    return UDS_OK;
+}
+
+static void stop_handler(int sig) {
+    uds_tool_stop = 1;
+}
+
+int uds_tool_init(const char *ifname, uint32_t phys, uint32_t resp, const char *tag) {
+    if (UDSTpISOTpCInit(&g_tp, ifname, resp, phys, resp, 0x7DF) != UDS_OK) {
+        return -1;
+    }
+    snprintf(g_tp.tag, sizeof(g_tp.tag), "%s", tag);
+    UDSClientInit(&uds_tool_client);
+    uds_tool_client.tp = &g_tp.hdl;
+    uds_tool_client.fn = client_fn;
+
+    struct sigaction sa = { .sa_handler = stop_handler };
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    return 0;
+}
+
+UDSErr_t uds_tool_request(const uint8_t *req, uint16_t len) {
+    for (int attempt = 0;; attempt++) {
+        g_result = 0;
+        uds_tool_requests++;
+        UDSErr_t err = UDSSendBytes(&uds_tool_client, req, len);
+        if (err != UDS_OK) {
+            return err;
+        }
+        while (!g_result) {
+            UDSClientWait(&uds_tool_client, 100);
+            UDSClientPoll(&uds_tool_client);
+        }
+        if (g_result > 0) {
+            return UDS_OK;
+        }
+        if (g_err != UDS_ERR_TIMEOUT || attempt >= UDS_TOOL_RETRIES || uds_tool_stop) {
+            return g_err;
+        }
+        uds_tool_retries++;
+        if (uds_tool_verbose) {
+            fprintf(stderr, "[LOG] 请求0x%02X超时，重试(%d/%d)\n", req[0], attempt + 1,
+                    UDS_TOOL_RETRIES);
+        }
+    }
+}
+
+void uds_tool_print_err(const char *what, UDSErr_t err) {
+    if (err < 0x100) {
+        fprintf(stderr, "%s失败: NRC 0x%02X\n", what, err);
+    } else {
+        fprintf(stderr, "%s失败: %s\n", what, UDSErrToStr(err));
+    }
+}
+
+int uds_tool_change_session(uint8_t session) {
+    uint8_t req[] = { 0x10, session };
+    UDSErr_t err = uds_tool_request(req, sizeof(req));
+    if (err != UDS_OK) {
+        uds_tool_print_err("切换会话", err);
+        return -1;
+    }
+    printf("[LOG] 已进入会话0x%02X\n", session);
+    return 0;
+}
+
+int uds_tool_unlock(uint8_t level) {
+    const UDSClient_t *c = &uds_tool_client;
+    uint8_t req[6] = { 0x27, level };
+    UDSErr_t err = uds_tool_request(req, 2);
+    if (err != UDS_OK) {
+        uds_tool_print_err("请求seed", err);
+        return -1;
+    }
+    if (c->recv_size < 6) {
+        fprintf(stderr, "seed响应过短: %u字节\n", (unsigned)c->recv_size);
+        return -1;
+    }
+    uint32_t seed = ((uint32_t)c->recv_buf[2] << 24) | (c->recv_buf[3] << 16) |
+                    (c->recv_buf[4] << 8) | c->recv_buf[5];
+    if (seed == 0) { // 已解锁
+        printf("[LOG] 安全级别0x%02X已解锁\n", level);
+        return 0;
+    }
+    uint32_t key;
+    if (uds_key_for_level(level, seed, &key) < 0) {
+        fprintf(stderr, "不支持的安全级别: 0x%02X\n", level);
+        return -1;
+    }
+    req[1] = level + 1;
+    req[2] = key >> 24;
+    req[3] = key >> 16;
+    req[4] = key >> 8;
+    req[5] = key;
+    err = uds_tool_request(req, sizeof(req));
+    if (err != UDS_OK) {
+        uds_tool_print_err("发送key", err);
+        return -1;
+    }
+    printf("[LOG] 安全级别0x%02X解锁成功 (seed=0x%08X key=0x%08X)\n", level, seed, key);
+    return 0;
+}
+
+int uds_tool_parse_ids(const char *s, uint32_t *phys, uint32_t *resp) {
+    char *end;
+    *phys = strtoul(s, &end, 16);
+    if (*end != ':') {
+        return -1;
+    }
+    *resp = strtoul(end + 1, &end, 16);
+    return *end ? -1 : 0;
+}
+
+uint64_t uds_tool_now_ns(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
@@ -0,0 +1,35 @@
+#ifndef UDS_TOOL_H
+#define UDS_TOOL_H
+
+#include <signal.h>
+#include <stdint.h>
+#include <time.h>
+#include "iso14229.h"
+
+// 客户端工具（uds_dump、uds_log）共用的同步请求、会话切换与安全访问解锁
+// 每个工具一个客户端：uds_tool_init()之后经uds_tool_client.recv_buf/recv_size读取最近一次响应
+
+#define UDS_TOOL_RETRIES 3 // 单个请求超时后的重试次数
+
+extern UDSClient_t uds_tool_client;
+extern volatile sig_atomic_t uds_tool_stop; // 收到SIGINT/SIGTERM后置1
+extern int uds_tool_verbose;                // 输出重试信息
+extern uint64_t uds_tool_requests;          // 发出的请求数（含重试）
+extern uint64_t uds_tool_retries;
+
+// 打开ISO-TP传输、初始化客户端并安装SIGINT/SIGTERM处理；tag用于传输层日志
+int uds_tool_init(const char *ifname, uint32_t phys, uint32_t resp, const char *tag);
+
+// 同步发送一个请求并等待响应；返回UDS_OK、NRC(<0x100)或UDS_ERR_*。超时自动重试
+UDSErr_t uds_tool_request(const uint8_t *req, uint16_t len);
+void uds_tool_print_err(const char *what, UDSErr_t err);
+
+int uds_tool_change_session(uint8_t session);
+// 按uds_key_for_level()计算key解锁；seed为0视为已解锁
+int uds_tool_unlock(uint8_t level);
+
+// 解析 -a 参数 "请求ID:响应ID"（十六进制）
+int uds_tool_parse_ids(const char *s, uint32_t *phys, uint32_t *resp);
+uint64_t uds_tool_now_ns(clockid_t clock);
+
+#endif